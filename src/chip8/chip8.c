@@ -17,10 +17,22 @@
  */
 
 #include <lib8/cpu.h>
+#include <lib8/rom.h>
+#include <lib8/analyze.h>
+#include <lib8/aot.h>
+#include <lib8/video.h>
+#include <lib8/share.h>
+#include <lib8/rollback.h>
+#include <lib8/triple.h>
+#include <lib8/scale.h>
+#include <lib8/trace.h>
+#include <lib8/input.h>
 #include "libsdl.h"
+#include "netplay.h"
 #include <config.h>
 
 #include <getopt.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -35,6 +47,74 @@ static int use_mute;
 /* Flag used by '--debug' */
 static int use_debug;
 
+/* Path given to '--analysis' */
+static const char* analysis_file;
+
+/* Path given to '--aot' */
+static const char* aot_file;
+
+/* Path given to '--dump-video' */
+static const char* video_file;
+
+/* Video being dumped, if any. */
+static struct video_t* video;
+
+/* Frames handed from the emulation thread to the display thread. */
+static struct triple_t* frames;
+
+/* Keys held down, polled by the display thread. */
+static word held_keys;
+
+/* Key changes queued by the display thread for the machine, if any. */
+static struct input_queue_t* input;
+
+/* Keys the machine will hold once the queued events are applied. */
+static word queued_keys;
+
+/* Cleared to stop emulating, by either thread. */
+static int running = 1;
+
+/* Statistics shown by the HUD. */
+static struct hud_t hud;
+
+/* Running totals of the emulation thread, read by the display thread. */
+static struct hud_sample_t totals;
+
+/* Name given to '--share' */
+static const char* share_name;
+
+/* Segment frames are shared in, if any. */
+static struct share_segment_t* share;
+
+/* Frames given to '--run-ahead' */
+static int run_ahead;
+
+/* Address given to '--netplay-host' or '--netplay-join' */
+static const char* netplay_address;
+static int netplay_hosting;
+
+/* Two player session, if any. */
+static struct netplay_t* net;
+static struct rollback_t* rb;
+
+/* Frames between keys sent even if they do not change. */
+#define NETPLAY_CONFIRM 4
+
+/* Filter given to '--filter' */
+static int filter = SCALE_NONE;
+
+/* Path given to '--trace-timeline' */
+static const char* trace_file;
+
+/* Timelines of the emulation and display threads, if tracing. */
+static struct trace_t* traces[2];
+
+/* Model given to '--timing' */
+static int timing = TIMING_FIXED;
+
+/* Profile given to '--quirks' */
+static int quirks = QUIRKS_DEFAULT;
+
 /* getopt parameter structure. */
 static struct option long_options[] = {
     { "help", no_argument, 0, 'h' },
@@ -42,6 +122,17 @@ static struct option long_options[] = {
     { "hex", no_argument, &use_hexloader, 1 },
     { "mute", no_argument, &use_mute, 1 },
     { "debug", no_argument, &use_debug, 1 },
+    { "analysis", required_argument, 0, 'a' },
+    { "aot", required_argument, 0, 'c' },
+    { "dump-video", required_argument, 0, 'd' },
+    { "quirks", required_argument, 0, 'q' },
+    { "share", required_argument, 0, 'm' },
+    { "run-ahead", required_argument, 0, 'r' },
+    { "netplay-host", required_argument, 0, 'n' },
+    { "netplay-join", required_argument, 0, 'j' },
+    { "filter", required_argument, 0, 'f' },
+    { "trace-timeline", required_argument, 0, 't' },
+    { "timing", required_argument, 0, 'T' },
     { 0, 0, 0, 0 }
 };
 
@@ -56,119 +147,305 @@ usage(const char* name)
     int pad = strnlen(name, 10) + 7; // 7 = "Usage: "
 
     printf("Usage: %s [-h | --help] [-v | --version]\n", name);
-    printf("%*c [--hex] [--mute] <file>\n", pad, ' ');
+    printf("%*c [--hex] [--mute] [--analysis <file>] [--aot <module>]\n",
+            pad, ' ');
+    printf("%*c [--dump-video <file>] [--quirks <profile>] [--share <name>]\n",
+            pad, ' ');
+    printf("%*c [--run-ahead <frames>] [--netplay-host <address>]\n",
+            pad, ' ');
+    printf("%*c [--netplay-join <address>] [--filter <name>]\n",
+            pad, ' ');
+    printf("%*c [--trace-timeline <file>] [--timing <model>] <file>\n",
+            pad, ' ');
 }
 
-static char
-hex_to_bin(char hex)
+/*
+ * Keys are polled by the display thread, which owns SDL input, and their
+ * changes reach the machine as events for the next instruction it runs.
+ * Changes that do not fit in the queue are sent on the next poll.
+ */
+static void
+queue_keys(word keys)
 {
-    if (hex >= '0' && hex <= '9')
-        return hex - '0';
-    hex &= 0xDF;
-    if (hex >= 'A' && hex <= 'F')
-        return 10 + (hex - 'A');
-    return -1;
+    struct input_event_t events[16];
+    int n = 0;
+    for (int key = 0; key < 16; key++) {
+        if (((keys ^ queued_keys) >> key) & 1) {
+            events[n].at = INPUT_NOW;
+            events[n].key = key;
+            events[n].down = (keys >> key) & 1;
+            n++;
+        }
+    }
+    int pushed = input_push(input, events, n);
+    for (int k = 0; k < pushed; k++) {
+        queued_keys ^= 1 << events[k].key;
+    }
+}
+
+/* Keys held by the local player, on the keyboard or by a consumer. */
+static word
+local_keys(void)
+{
+    word keys = 0;
+    for (int key = 0; key < 16; key++) {
+        keys |= (is_key_down(key) != 0) << key;
+    }
+    return share ? keys | share_keys(share) : keys;
 }
 
 /**
- * Load a hex file.
- *
- * @param file file path.
- * @param machine data structure to load the HEX into.
+ * Run a frame of a two player session: take the messages sent by the
+ * other player, run the frame with the local keys and send the keys and
+ * state hashes that the other player needs.
+ * @return 0 to go on, 1 when the session is over.
  */
 static int
-load_hex(const char* file, struct machine_t* machine)
+netplay_frame(struct machine_t* mac)
 {
-    FILE* fp = fopen(file, "rb");
-    if (fp == NULL) {
-        fprintf(stderr, "Cannot open ROM file.\n");
+    static word sent_keys;
+    static long sent_frame = -NETPLAY_CONFIRM;
+    static long check_frame = -1;
+    static uint64_t check_hash;
+
+    int type, got;
+    long frame;
+    uint64_t value;
+    while ((got = netplay_receive(net, &type, &frame, &value)) > 0) {
+        if (type == NETPLAY_KEYS && rollback_remote(rb, frame, value)) {
+            fprintf(stderr, "The other player is out of sync.\n");
+            return 1;
+        }
+        if (type == NETPLAY_HASH) {
+            check_frame = frame;
+            check_hash = value;
+        }
+    }
+    if (got < 0) {
+        fprintf(stderr, "The other player has left.\n");
         return 1;
     }
 
-    // Use the fseek/ftell/fseek trick to retrieve file size.
-    fseek(fp, 0, SEEK_END);
-    int length = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-
-    // Create a temporal buffer where to store the data.
-    char* hexfile = malloc(length);
-    if (hexfile == NULL) {
+    /* Wait for the other player if it is too far behind. */
+    word keys = __atomic_load_n(&held_keys, __ATOMIC_RELAXED);
+    frame = rollback_current(rb);
+    if (rollback_frame(rb, keys) < 0) {
+        return 0;
+    }
+    __atomic_fetch_add(&totals.instructions, 1000 / 60, __ATOMIC_RELAXED);
+    if (keys != sent_keys || frame - sent_frame >= NETPLAY_CONFIRM) {
+        if (netplay_send(net, NETPLAY_KEYS, frame, keys)) {
+            fprintf(stderr, "The other player has left.\n");
+            return 1;
+        }
+        sent_keys = keys;
+        sent_frame = frame;
+    }
+    uint64_t hash;
+    if (rollback_new_hash(rb, &frame, &hash)
+            && netplay_send(net, NETPLAY_HASH, frame, hash)) {
+        fprintf(stderr, "The other player has left.\n");
         return 1;
     }
-    fread(hexfile, length, 1, fp);
-    fclose(fp);
-
-    int mempos = 0x200;
-    if (length & 0x01) length--;
-    for (int i = 0; i < length; i += 2)
-    {
-        char hi = hex_to_bin(hexfile[i]);
-        char lo = hex_to_bin(hexfile[i + 1]);
-        if (hi == -1 || lo == -1) {
-            free(hexfile);
+    if (check_frame >= 0) {
+        int diff = rollback_check(rb, check_frame, check_hash);
+        if (diff > 0) {
+            fprintf(stderr, "Desync at frame %ld.\n", check_frame);
             return 1;
         }
-
-        machine->mem[mempos++] = hi << 4 | lo;
-        if (mempos > 0xFFF)
-            break;
+        if (diff == 0) {
+            check_frame = -1;
+        }
     }
 
-    free(hexfile);
+    /* Reruns are silent, so the speaker follows the machine. */
+    if (!use_mute) {
+        update_speaker(mac->st > 0);
+    }
     return 0;
 }
 
+static int
+load_data(char* file, struct machine_t* mac)
+{
+    if (use_hexloader == 0) {
+        return load_rom(mac, file);
+    } else {
+        return load_hex(mac, file);
+    }
+}
+
 /**
- * Load a ROM into a machine. This function will open a file and load its
- * contents into the memory from the provided machine data structure.
- * In compliance with the specification, ROM data will start at 0x200.
- *
- * @param file file path.
- * @param machine machine data structure to load the ROM into.
+ * Load the static analysis produced by chip8-analyze for the ROM that is
+ * currently in memory. An analysis made for another ROM is ignored.
  */
 static int
-load_rom(const char* file, struct machine_t* machine)
+load_analysis_for(const char* file, struct analysis_t* an,
+        struct machine_t* mac)
 {
-    FILE* fp = fopen(file, "rb");
-    if (fp == NULL) {
-        fprintf(stderr, "Cannot open ROM file.\n");
+    if (load_analysis(an, file)) {
+        fprintf(stderr, "Cannot read analysis %s.\n", file);
         return 1;
     }
-
-    // Use the fseek/ftell/fseek trick to retrieve file size.
-    fseek(fp, 0, SEEK_END);
-    int length = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-
-    // Check the length of the rom. Must be as much 3584 bytes long, which
-    // is 4096 - 512. Since first 512 bytes of memory are reserved, program
-    // code can only allocate up to 3584 bytes. Must check for bounds in
-    // order to avoid buffer overflows.
-    if (length > 3584) {
-        fprintf(stderr, "ROM too large.\n");
+    if (an->checksum != analysis_checksum(mac->mem)) {
+        fprintf(stderr, "Analysis %s does not match the ROM, ignored.\n", file);
+        free_analysis(an);
         return 1;
     }
-
-    // Everything is OK, read the ROM.
-    fread(machine->mem + 0x200, length, 1, fp);
-    fclose(fp);
+    mac->analysis = an;
     return 0;
 }
 
-static int
-load_data(char* file, struct machine_t* mac)
+/**
+ * Record a phase in a timeline, if tracing. The phase began at *mark and
+ * ends now, which becomes the mark of the next phase.
+ */
+static void
+phase(struct trace_t* trace, const char* name, uint64_t* mark)
 {
-    if (use_hexloader == 0) {
-        return load_rom(file, mac);
-    } else {
-        return load_hex(file, mac);
+    if (trace) {
+        uint64_t now = get_microseconds();
+        trace_event(trace, name, *mark, now);
+        *mark = now;
+    }
+}
+
+/**
+ * Sample the statistics of a frame about to be shown: what the emulation
+ * thread did since the previous frame shown and the frames skipped.
+ */
+static void
+sample_frame(struct hud_sample_t* sample, const struct frame_t* frame)
+{
+    static struct hud_sample_t seen;
+    static uint64_t last_shown;
+    static long last_number = -1;
+
+    uint64_t now = get_microseconds();
+    struct hud_sample_t now_totals;
+    now_totals.emulate_us = __atomic_load_n(&totals.emulate_us, __ATOMIC_RELAXED);
+    now_totals.idle_us = __atomic_load_n(&totals.idle_us, __ATOMIC_RELAXED);
+    now_totals.instructions = __atomic_load_n(&totals.instructions, __ATOMIC_RELAXED);
+    now_totals.late = __atomic_load_n(&totals.late, __ATOMIC_RELAXED);
+
+    sample->frame_us = last_shown ? now - last_shown : 0;
+    sample->emulate_us = now_totals.emulate_us - seen.emulate_us;
+    sample->idle_us = now_totals.idle_us - seen.idle_us;
+    sample->instructions = now_totals.instructions - seen.instructions;
+    sample->late = now_totals.late - seen.late;
+    sample->dropped = last_number >= 0 ? frame->number - last_number - 1 : 0;
+    seen = now_totals;
+    last_shown = now;
+    last_number = frame->number;
+}
+
+/**
+ * Emulation thread. Runs the machine in real time and publishes a frame
+ * every 1/60th of second. A display that is slow to present only skips
+ * frames and never holds the machine or its timers back.
+ */
+static void*
+emulate(void* data)
+{
+    struct machine_t* mac = data;
+    static struct machine_t ahead;
+
+    /* Frames run ahead are silent, interpreted and keep the keys held. */
+    ahead.analysis = mac->analysis;
+
+    int last_ticks = SDL_GetTicks();
+    int last_delta = 0, step_delta = 0, render_delta = 0;
+    struct trace_t* trace = traces[0];
+    while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        uint64_t start = get_microseconds(), mark = start;
+
+        /* Update timers. */
+        last_delta = SDL_GetTicks() - last_ticks;
+        last_ticks = SDL_GetTicks();
+        step_delta += last_delta;
+        render_delta += last_delta;
+
+        /* Opcode execution: estimated 1000 opcodes/second. */
+        if (rb == NULL && timing == TIMING_FIXED) {
+            run_machine(mac, step_delta);
+            phase(trace, "run_machine", &mark);
+            update_time(mac, last_delta);
+            phase(trace, "update_time", &mark);
+            __atomic_fetch_add(&totals.instructions, step_delta,
+                    __ATOMIC_RELAXED);
+        }
+        step_delta = 0;
+
+        /* Publish a frame every 1/60th of second; the second one is late. */
+        for (int late = 0; render_delta >= (1000 / 60); late = 1) {
+            if (late) {
+                __atomic_fetch_add(&totals.late, 1, __ATOMIC_RELAXED);
+            }
+            /* VIP timing runs the machine a whole frame at a time. */
+            if (rb == NULL && timing != TIMING_FIXED) {
+                int count = run_vip_frame(mac, timing == TIMING_VIP_VBLANK);
+                tick_timers(mac);
+                phase(trace, "run_vip_frame", &mark);
+                __atomic_fetch_add(&totals.instructions, count,
+                        __ATOMIC_RELAXED);
+            }
+            if (rb && netplay_frame(mac)) {
+                __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+                break;
+            }
+            if (rb) {
+                phase(trace, "netplay", &mark);
+            }
+            /*
+             * Show the frame the machine would reach a few frames from now
+             * with the keys held at the moment, to hide the frames that
+             * games take to react to input. The machine itself is not run.
+             */
+            if (run_ahead > 0) {
+                snapshot_machine(&ahead, mac);
+                if (timing == TIMING_FIXED) {
+                    run_frames(&ahead, run_ahead, 1000 / 60);
+                } else for (int k = 0; k < run_ahead; k++) {
+                    run_vip_frame(&ahead, timing == TIMING_VIP_VBLANK);
+                    tick_timers(&ahead);
+                }
+                triple_publish(frames, &ahead);
+            } else {
+                triple_publish(frames, mac);
+            }
+            phase(trace, "publish", &mark);
+            if (video && video_frame(video, mac)) {
+                fprintf(stderr, "Error writing video to %s.\n", video_file);
+                video_close(video);
+                video = NULL;
+            }
+            if (share) {
+                share_publish(share, mac);
+            }
+            phase(trace, "export", &mark);
+            render_delta -= (1000 / 60);
+        }
+
+        uint64_t emulated = get_microseconds();
+        __atomic_fetch_add(&totals.emulate_us, emulated - start,
+                __ATOMIC_RELAXED);
+        mark = emulated;
+
+        /* Hack to reduce CPU usage :D
+         * Maybe not best way but it works!! */
+        SDL_Delay(1);
+        __atomic_fetch_add(&totals.idle_us, get_microseconds() - emulated,
+                __ATOMIC_RELAXED);
+        phase(trace, "delay", &mark);
     }
+    return NULL;
 }
 
 int
 main(int argc, char** argv)
 {
     struct machine_t mac;
+    struct analysis_t analysis;
 
     /* Parse parameters */
     int indexptr, c;
@@ -181,6 +458,47 @@ main(int argc, char** argv)
                 printf("%s\n", PACKAGE_STRING);
                 exit(0);
                 break;
+            case 'a':
+                analysis_file = optarg;
+                break;
+            case 'c':
+                aot_file = optarg;
+                break;
+            case 'd':
+                video_file = optarg;
+                break;
+            case 'm':
+                share_name = optarg;
+                break;
+            case 'r':
+                run_ahead = strtol(optarg, NULL, 0);
+                break;
+            case 'f':
+                if ((filter = scale_by_name(optarg)) == -1) {
+                    fprintf(stderr, "Unknown filter %s.\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 't':
+                trace_file = optarg;
+                break;
+            case 'T':
+                if ((timing = timing_by_name(optarg)) == -1) {
+                    fprintf(stderr, "Unknown timing model %s.\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'n':
+            case 'j':
+                netplay_address = optarg;
+                netplay_hosting = c == 'n';
+                break;
+            case 'q':
+                if ((quirks = quirks_by_name(optarg)) == -1) {
+                    fprintf(stderr, "Unknown quirk profile %s.\n", optarg);
+                    exit(1);
+                }
+                break;
             case 0:
                 /* A long option is being processed, probably --hex. */
                 break;
@@ -205,55 +523,142 @@ main(int argc, char** argv)
         fprintf(stderr, "%s\n", SDL_GetError());
         return 1;
     }
+    set_filter(filter);
     if (!try_enable_sound()) {
         fprintf(stderr, "Couldn't enable sound.\n");
         use_mute = 1;
     }
 
     /* Init emulator. */
-    srand(time(NULL));
     if (use_debug) {
         set_debug_mode(1);
     }
     init_machine(&mac);
-    mac.keydown = &is_key_down;
+    set_quirks(&mac, quirks);
+    seed_machine(&mac, time(NULL));
+    if ((input = input_create(64)) == NULL) {
+        fprintf(stderr, "Cannot queue key events.\n");
+        destroy_context();
+        return 1;
+    }
+    mac.input = input;
     if (!use_mute) {
         mac.speaker = &update_speaker;
     }
-    load_data(argv[optind], &mac);
-
-
-    int last_ticks = SDL_GetTicks();
-    int last_delta = 0, step_delta = 0, render_delta = 0;
-    while (!is_close_requested()) {
-        /* Update timers. */
-        last_delta = SDL_GetTicks() - last_ticks;
-        last_ticks = SDL_GetTicks();
-        step_delta += last_delta;
-        render_delta += last_delta;
+    if (load_data(argv[optind], &mac)) {
+        destroy_context();
+        return 1;
+    }
+    if (analysis_file) {
+        load_analysis_for(analysis_file, &analysis, &mac);
+    }
+    if (aot_file && aot_load(&mac, aot_file)) {
+        fprintf(stderr, "Cannot use native module %s, interpreting.\n", aot_file);
+    }
+    if (video_file && (video = video_open(video_file, -1)) == NULL) {
+        fprintf(stderr, "Cannot write video to %s.\n", video_file);
+    }
+    if (share_name && (share = share_create(share_name)) == NULL) {
+        fprintf(stderr, "Cannot share frames in %s.\n", share_name);
+    }
 
-        /* Opcode execution: estimated 1000 opcodes/second. */
-        while (step_delta >= 1) {
-            step_machine(&mac);
-            step_delta--;
+    /*
+     * Two players run the same machine from the same seed. Keys go
+     * through the session instead of a poller, one frame at a time.
+     */
+    if (netplay_address) {
+        uint32_t seed = time(NULL);
+        if (netplay_hosting) {
+            printf("Waiting for the other player on %s...\n", netplay_address);
+            net = netplay_host(netplay_address, seed);
+        } else {
+            net = netplay_join(netplay_address, &seed);
         }
+        if (net == NULL || (rb = rollback_create(&mac, 1000 / 60)) == NULL) {
+            fprintf(stderr, "Cannot play with %s.\n", netplay_address);
+            destroy_context();
+            return 1;
+        }
+        seed_machine(&mac, seed);
+        mac.input = NULL;
+        mac.speaker = NULL;
+    }
 
-        /* Update timed subsystems. */
-        update_time(&mac, last_delta);
-
-        /* Render frame every 1/60th of second. */
-        while (render_delta >= (1000 / 60)) {
-            render_display(&mac);
-            render_delta -= (1000 / 60);
+    /* Timelines are kept in memory and only written at exit. */
+    if (trace_file) {
+        traces[0] = trace_create(1, "emulation", TRACE_EVENTS);
+        traces[1] = trace_create(2, "display", TRACE_EVENTS);
+        if (traces[0] == NULL || traces[1] == NULL) {
+            fprintf(stderr, "Cannot trace the timeline.\n");
+            destroy_context();
+            return 1;
         }
+        set_trace(traces[1]);
+    }
 
-        /* Hack to reduce CPU usage :D
-         * Maybe not best way but it works!! */
-        SDL_Delay(1);
+    /* Emulation runs on its own thread; this one polls SDL and presents. */
+    pthread_t emulator;
+    if ((frames = triple_create()) == NULL
+            || pthread_create(&emulator, NULL, emulate, &mac)) {
+        fprintf(stderr, "Cannot start emulation thread.\n");
+        destroy_context();
+        return 1;
+    }
+    for (;;) {
+        uint64_t mark = get_microseconds();
+        if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE) || is_close_requested()) {
+            break;
+        }
+        word keys = local_keys();
+        __atomic_store_n(&held_keys, keys, __ATOMIC_RELAXED);
+        if (mac.input) {
+            queue_keys(keys);
+        }
+        phase(traces[1], "events", &mark);
+        const struct frame_t* frame = triple_latest(frames);
+        if (frame) {
+            struct hud_sample_t sample = { 0 };
+            render_display(frame, &hud, &sample);
+            sample_frame(&sample, frame);
+            hud_push(&hud, &sample);
+        } else {
+            SDL_Delay(1);
+            phase(traces[1], "delay", &mark);
+        }
+    }
+    __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+    pthread_join(emulator, NULL);
+    triple_destroy(frames);
+    if (trace_file) {
+        if (trace_save(trace_file, traces, 2)) {
+            fprintf(stderr, "Cannot write timeline to %s.\n", trace_file);
+        }
+        long dropped = trace_dropped(traces[0]) + trace_dropped(traces[1]);
+        if (dropped > 0) {
+            fprintf(stderr, "Timeline wrapped, its %ld oldest events were "
+                    "dropped.\n", dropped);
+        }
+        trace_destroy(traces[0]);
+        trace_destroy(traces[1]);
     }
 
     /* Dispose SDL context. */
     destroy_context();
+    if (video && video_close(video)) {
+        fprintf(stderr, "Error writing video to %s.\n", video_file);
+    }
+    if (share) {
+        share_destroy(share, share_name);
+    }
+    if (net) {
+        rollback_destroy(rb);
+        netplay_close(net);
+    }
+    input_destroy(input);
+    aot_unload(&mac);
+    if (mac.analysis) {
+        free_analysis(&analysis);
+    }
 
     return 0;
 }
@@ -0,0 +1,112 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hud.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#define HUD_TEXT 0x00FF00FF     // Opaque green.
+#define HUD_BACK 0x000000A0     // Translucent black.
+
+/*
+ * 3x5 font. Every octal digit is a row, the most significant one on top,
+ * and every bit a pixel, the most significant one on the left.
+ */
+static const unsigned short glyphs[128] = {
+    ['0'] = 075557, ['1'] = 026227, ['2'] = 071747, ['3'] = 071717,
+    ['4'] = 055711, ['5'] = 074717, ['6'] = 074757, ['7'] = 071222,
+    ['8'] = 075757, ['9'] = 075717,
+    ['A'] = 025755, ['B'] = 065656, ['C'] = 034443, ['D'] = 065556,
+    ['E'] = 074647, ['F'] = 074644, ['G'] = 034553, ['H'] = 055755,
+    ['I'] = 072227, ['J'] = 011152, ['K'] = 055655, ['L'] = 044447,
+    ['M'] = 057755, ['N'] = 065555, ['O'] = 025552, ['P'] = 065644,
+    ['Q'] = 025563, ['R'] = 065655, ['S'] = 034216, ['T'] = 072222,
+    ['U'] = 055557, ['V'] = 055552, ['W'] = 055775, ['X'] = 055255,
+    ['Y'] = 055222, ['Z'] = 071247,
+    ['.'] = 000002, ['%'] = 051245, [':'] = 002020, ['/'] = 011244,
+    ['-'] = 000700,
+};
+
+void
+hud_push(struct hud_t* hud, const struct hud_sample_t* sample)
+{
+    hud->ring[hud->next] = *sample;
+    hud->next = (hud->next + 1) % HUD_FRAMES;
+    if (hud->count < HUD_FRAMES)
+        hud->count++;
+}
+
+/* Draw a line of text; characters are 4x6 with the spacing. */
+static void
+draw_text(uint32_t* pixels, int pitch, int x, int y, const char* text)
+{
+    for (; *text && x + 3 <= HUD_WIDTH; text++, x += 4) {
+        unsigned short glyph = glyphs[toupper((unsigned char) *text) & 0x7F];
+        for (int row = 0; row < 5; row++) {
+            int bits = (glyph >> (3 * (4 - row))) & 7;
+            for (int col = 0; col < 3; col++) {
+                if (bits & (4 >> col))
+                    pixels[(y + row) * pitch + x + col] = HUD_TEXT;
+            }
+        }
+    }
+}
+
+void
+hud_draw(const struct hud_t* hud, int underruns, uint32_t* pixels,
+        int pitch)
+{
+    struct hud_sample_t sum;
+    memset(&sum, 0, sizeof(sum));
+    for (int k = 0; k < hud->count; k++) {
+        const struct hud_sample_t* s = &hud->ring[k];
+        sum.frame_us += s->frame_us;
+        sum.emulate_us += s->emulate_us;
+        sum.expand_us += s->expand_us;
+        sum.upload_us += s->upload_us;
+        sum.present_us += s->present_us;
+        sum.idle_us += s->idle_us;
+        sum.instructions += s->instructions;
+        sum.dropped += s->dropped;
+        sum.late += s->late;
+    }
+    double frames = hud->count ? hud->count : 1;
+    double wall = sum.frame_us ? sum.frame_us : 1;
+    double idle = 100.0 * sum.idle_us / wall;
+
+    char lines[6][48];
+    snprintf(lines[0], sizeof(lines[0]), "IPS %.0f",
+            sum.instructions * 1e6 / wall);
+    snprintf(lines[1], sizeof(lines[1]), "FRAME %.2f MS",
+            sum.frame_us / frames / 1000);
+    snprintf(lines[2], sizeof(lines[2]), "EMU %.2f EXP %.2f",
+            sum.emulate_us / frames / 1000, sum.expand_us / frames / 1000);
+    snprintf(lines[3], sizeof(lines[3]), "UPL %.2f PRE %.2f",
+            sum.upload_us / frames / 1000, sum.present_us / frames / 1000);
+    snprintf(lines[4], sizeof(lines[4]), "DROP %u LATE %u IDLE %.0f%%",
+            (unsigned) sum.dropped, (unsigned) sum.late, idle > 100 ? 100 : idle);
+    snprintf(lines[5], sizeof(lines[5]), "AUDIO UNDERRUNS %d", underruns);
+
+    for (int y = 0; y < HUD_HEIGHT; y++) {
+        for (int x = 0; x < HUD_WIDTH; x++)
+            pixels[y * pitch + x] = HUD_BACK;
+    }
+    for (int line = 0; line < 6; line++)
+        draw_text(pixels, pitch, 2, 2 + 6 * line, lines[line]);
+}
@@ -0,0 +1,71 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUD_H_
+#define HUD_H_
+
+#include <stdint.h>
+
+/* Frames the statistics are averaged over. */
+#define HUD_FRAMES 60
+
+/* Size of the overlay, in pixels. */
+#define HUD_WIDTH 160
+#define HUD_HEIGHT 38
+
+/**
+ * What happened between two frames shown.
+ */
+struct hud_sample_t
+{
+    uint32_t frame_us;          // Wall time since the previous frame shown.
+    uint32_t emulate_us;        // Spent running the machine.
+    uint32_t expand_us;         // Spent filtering the screen into pixels.
+    uint32_t upload_us;         // Spent uploading and copying the texture.
+    uint32_t present_us;        // Spent presenting.
+    uint32_t idle_us;           // Spent sleeping by the emulation thread.
+    uint32_t instructions;      // Instructions emulated.
+    uint32_t dropped;           // Frames published but never shown.
+    uint32_t late;              // Frames published behind time.
+};
+
+/**
+ * Statistics of the last HUD_FRAMES frames shown.
+ */
+struct hud_t
+{
+    struct hud_sample_t ring[HUD_FRAMES];
+    int next;                   // Where the next sample goes.
+    int count;                  // Samples in the ring.
+};
+
+/**
+ * Add the sample of a frame, forgetting the oldest one if full.
+ */
+void hud_push(struct hud_t* hud, const struct hud_sample_t* sample);
+
+/**
+ * Draw the statistics with a built-in font as HUD_WIDTH x HUD_HEIGHT
+ * RGBA8888 pixels: green text on a translucent background.
+ * @param underruns audio underruns so far.
+ * @param pitch distance between rows of pixels, in pixels.
+ */
+void hud_draw(const struct hud_t* hud, int underruns, uint32_t* pixels,
+        int pitch);
+
+#endif // HUD_H_
@@ -18,6 +18,7 @@
 
 
 #include "libsdl.h"
+#include <lib8/scale.h>
 
 #include <stdlib.h>
 #include <math.h>
@@ -65,10 +66,38 @@ static SDL_Renderer* renderer = NULL;
 
 static SDL_Texture* texture = NULL;
 
+/* Overlay the HUD is drawn on. */
+static SDL_Texture* hud_texture = NULL;
+
+/* Toggled by F1. */
+static int hud_shown;
+
 static SDL_AudioDeviceID device = 0;
 
 static SDL_AudioSpec* spec = NULL;
 
+/* Filter given to set_filter. */
+static int filter = SCALE_NONE;
+
+/* Timeline given to set_trace. */
+static struct trace_t* trace;
+
+/* Part of the texture holding the frame being shown. */
+static SDL_Rect shown;
+
+/* Screen being shown, to tell whether a frame changed. */
+static uint64_t shown_key;
+static int shown_esm = -1;
+
+/* When the sound card last asked for samples, 0 after a pause. */
+static Uint32 last_feed;
+
+/* Is the speaker playing? Only the emulation thread touches it. */
+static int playing;
+
+/* Times the sound card asked for samples too late. */
+static int underruns;
+
 /**
  * This is the function that generates the beep noise heard in the emulator.
  * It generates RAW PCM values that are written to the stream. This is fast
@@ -78,6 +107,13 @@ static void
 feed(void* udata, Uint8* stream, int len)
 {
     struct audiodata_t* audio = (struct audiodata_t *) udata;
+
+    /* Twice the time a buffer lasts without a call means a gap was heard. */
+    Uint32 now = SDL_GetTicks();
+    Uint32 last = __atomic_exchange_n(&last_feed, now, __ATOMIC_RELAXED);
+    if (last && now - last > 2000u * spec->samples / spec->freq) {
+        __atomic_fetch_add(&underruns, 1, __ATOMIC_RELAXED);
+    }
     for (int i = 0; i < len; i++) {
         stream[i] = sinf(audio->tone_pos) + 127;
         audio->tone_pos += audio->tone_inc;
@@ -120,6 +156,10 @@ clean_up()
         free(spec);
         spec = NULL;
     }
+    if (hud_texture != NULL) {
+        SDL_DestroyTexture(hud_texture);
+        hud_texture = NULL;
+    }
     if (texture != NULL) {
         SDL_DestroyTexture(texture);
         texture = NULL;
@@ -135,30 +175,6 @@ clean_up()
     SDL_Quit();
 }
 
-#define TEXTURE_PIXEL(x, y) (128 * (y) + (x))
-
-static void
-expand_screen(char* from, Uint32* to, int use_hdpi)
-{
-    if (use_hdpi) {
-        for (int i = 0; i < 8192; i++)
-            to[i] = from[i] ? -1 : 0;
-    } else {
-        int x = 0, y = 0;
-        for (int i = 0; i < 2048; i++) {
-            Uint32 val = from[i] ? -1 : 0;
-            to[TEXTURE_PIXEL(2 * x + 0, 2 * y + 0)] = val;
-            to[TEXTURE_PIXEL(2 * x + 1, 2 * y + 0)] = val;
-            to[TEXTURE_PIXEL(2 * x + 0, 2 * y + 1)] = val;
-            to[TEXTURE_PIXEL(2 * x + 1, 2 * y + 1)] = val;
-            if (++x == 64) {
-                x = 0;
-                y++;
-            }
-        }
-    }
-}
-
 int
 init_context()
 {
@@ -178,11 +194,18 @@ init_context()
         return 1;
     }
     texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
-            SDL_TEXTUREACCESS_STREAMING, 128, 64);
+            SDL_TEXTUREACCESS_STREAMING, SCALE_MAX_WIDTH, SCALE_MAX_HEIGHT);
     if (texture == NULL) {
         clean_up();
         return 1;
     }
+    hud_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+            SDL_TEXTUREACCESS_STREAMING, HUD_WIDTH, HUD_HEIGHT);
+    if (hud_texture == NULL) {
+        clean_up();
+        return 1;
+    }
+    SDL_SetTextureBlendMode(hud_texture, SDL_BLENDMODE_BLEND);
     return 0;
 }
 
@@ -209,25 +232,82 @@ is_close_requested()
         if (ev.type == SDL_QUIT) {
             return 1;
         }
+        if (ev.type == SDL_KEYDOWN && ev.key.keysym.sym == SDLK_F1
+                && !ev.key.repeat) {
+            hud_shown = !hud_shown;
+        }
     }
     return 0;
 }
 
 void
-render_display(struct machine_t* machine)
+set_filter(int new_filter)
+{
+    filter = new_filter;
+    shown_esm = -1;
+}
+
+void
+set_trace(struct trace_t* new_trace)
+{
+    trace = new_trace;
+}
+
+void
+render_display(const struct frame_t* frame, const struct hud_t* hud,
+        struct hud_sample_t* sample)
 {
     void*   pixels;
     int     pitch;
+    uint64_t start = get_microseconds();
+    uint64_t locked = start, expanded = start, unlocked = start;
 
-    /* Update SDL Texture with current data in CPU. */
-    SDL_LockTexture(texture, NULL, &pixels, &pitch);
-    expand_screen(machine->screen, (Uint32 *) pixels, machine->esm);
-    SDL_UnlockTexture(texture);
+    /* Filter and upload the screen only if it changed. */
+    int changed = frame->key != shown_key || frame->esm != shown_esm;
+    if (changed) {
+        int factor = scale_factor(filter);
+        shown.x = shown.y = 0;
+        shown.w = (frame->esm ? 128 : 64) * factor;
+        shown.h = (frame->esm ? 64 : 32) * factor;
+        SDL_LockTexture(texture, &shown, &pixels, &pitch);
+        locked = get_microseconds();
+        scale_screen(filter, frame->screen, frame->esm, (Uint32 *) pixels,
+                pitch / sizeof(Uint32));
+        expanded = get_microseconds();
+        SDL_UnlockTexture(texture);
+        unlocked = get_microseconds();
+        shown_key = frame->key;
+        shown_esm = frame->esm;
+    }
 
-    /* Render the texture. */
+    /* Render the texture, and the HUD over it. */
     SDL_RenderClear(renderer);
-    SDL_RenderCopy(renderer, texture, NULL, NULL);
+    SDL_RenderCopy(renderer, texture, &shown, NULL);
+    if (hud_shown) {
+        SDL_Rect corner = { 4, 4, 2 * HUD_WIDTH, 2 * HUD_HEIGHT };
+        SDL_LockTexture(hud_texture, NULL, &pixels, &pitch);
+        hud_draw(hud, audio_underruns(), (Uint32 *) pixels,
+                pitch / sizeof(Uint32));
+        SDL_UnlockTexture(hud_texture);
+        SDL_RenderCopy(renderer, hud_texture, NULL, &corner);
+    }
+    uint64_t copied = get_microseconds();
+
     SDL_RenderPresent(renderer);
+    uint64_t presented = get_microseconds();
+
+    sample->expand_us += expanded - start;
+    sample->upload_us += copied - expanded;
+    sample->present_us += presented - copied;
+    if (trace) {
+        if (changed) {
+            trace_event(trace, "lock", start, locked);
+            trace_event(trace, "expand", locked, expanded);
+            trace_event(trace, "unlock", expanded, unlocked);
+        }
+        trace_event(trace, "copy", unlocked, copied);
+        trace_event(trace, "present", copied, presented);
+    }
 }
 
 /**
@@ -253,9 +333,27 @@ is_key_down(char key)
 void
 update_speaker(int enabled)
 {
+    if (enabled && !playing) {
+        __atomic_store_n(&last_feed, 0, __ATOMIC_RELAXED);
+    }
+    playing = enabled;
     if (enabled) {
         SDL_PauseAudioDevice(device, 0);
     } else {
         SDL_PauseAudioDevice(device, 1);
     }
 }
+
+int
+audio_underruns()
+{
+    return __atomic_load_n(&underruns, __ATOMIC_RELAXED);
+}
+
+uint64_t
+get_microseconds()
+{
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 now = SDL_GetPerformanceCounter();
+    return now / frequency * 1000000 + now % frequency * 1000000 / frequency;
+}
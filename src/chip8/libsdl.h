@@ -20,6 +20,9 @@
 #define LIBSDL_H_
 
 #include <lib8/cpu.h>
+#include <lib8/triple.h>
+#include <lib8/trace.h>
+#include "hud.h"
 
 #include <SDL.h>
 
@@ -29,7 +32,25 @@ int try_enable_sound();
 
 void destroy_context();
 
-void render_display(struct machine_t* cpu);
+/**
+ * Choose the filter used to scale screens up, from lib8/scale.h.
+ */
+void set_filter(int filter);
+
+/**
+ * Record the phases of render_display in a timeline, or NULL for none.
+ */
+void set_trace(struct trace_t* trace);
+
+/**
+ * Show a frame. The frame is only filtered and uploaded again when its
+ * screen is not the one being shown. The HUD, toggled with F1, is drawn
+ * over it.
+ * @param hud statistics shown by the HUD.
+ * @param sample where the time spent in every phase is added.
+ */
+void render_display(const struct frame_t* frame, const struct hud_t* hud,
+        struct hud_sample_t* sample);
 
 int is_close_requested();
 
@@ -37,4 +58,15 @@ int is_key_down(char);
 
 void update_speaker(int);
 
+/**
+ * Count the times the sound card asked for samples later than it should
+ * have, which is heard as a gap.
+ */
+int audio_underruns();
+
+/**
+ * Microseconds since some fixed point, for timing.
+ */
+uint64_t get_microseconds();
+
 #endif // LIBSDL_H_
@@ -0,0 +1,240 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "netplay.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* Systems without MSG_NOSIGNAL set SO_NOSIGPIPE on the socket instead. */
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* Size of a message on the wire: type, frame and value. */
+#define MESSAGE_SIZE 13
+
+struct netplay_t
+{
+    int fd;                             // Connected socket.
+    unsigned char buf[MESSAGE_SIZE];    // Message being received.
+    int len;                            // Bytes of it received.
+};
+
+/* Open a socket for an address, bound to it or connected to it. */
+static int
+open_socket(const char* address, int listening)
+{
+    if (strchr(address, '/')) {
+        struct sockaddr_un sun;
+        if (strlen(address) >= sizeof(sun.sun_path))
+            return -1;
+        memset(&sun, 0, sizeof(sun));
+        sun.sun_family = AF_UNIX;
+        strcpy(sun.sun_path, address);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd == -1)
+            return -1;
+        if (listening)
+            unlink(address);
+        int err = listening ? bind(fd, (struct sockaddr*) &sun, sizeof(sun))
+            : connect(fd, (struct sockaddr*) &sun, sizeof(sun));
+        if (err) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    /* [host:]port, the loopback interface unless told otherwise. */
+    char host[256] = "127.0.0.1";
+    const char* port = strrchr(address, ':');
+    if (port) {
+        if (port - address >= (long) sizeof(host))
+            return -1;
+        memcpy(host, address, port - address);
+        host[port - address] = 0;
+        port++;
+    } else {
+        port = address;
+    }
+
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res))
+        return -1;
+    int fd = -1;
+    for (struct addrinfo* ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd == -1)
+            continue;
+        int one = 1;
+        if (listening)
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        int err = listening ? bind(fd, ai->ai_addr, ai->ai_addrlen)
+            : connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (err == 0) {
+            /* Keys are tiny and late keys are what rollback is about. */
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+/* Wrap a connected socket, which is made non blocking. */
+static struct netplay_t*
+wrap_socket(int fd)
+{
+    struct netplay_t* net = malloc(sizeof(struct netplay_t));
+    if (net == NULL || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK)) {
+        free(net);
+        close(fd);
+        return NULL;
+    }
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    net->fd = fd;
+    net->len = 0;
+    return net;
+}
+
+struct netplay_t*
+netplay_host(const char* address, uint32_t seed)
+{
+    int server = open_socket(address, 1);
+    if (server == -1)
+        return NULL;
+    if (listen(server, 1)) {
+        close(server);
+        return NULL;
+    }
+    int fd = accept(server, NULL, NULL);
+    close(server);
+    if (strchr(address, '/'))
+        unlink(address);
+    if (fd == -1)
+        return NULL;
+    struct netplay_t* net = wrap_socket(fd);
+    if (net && netplay_send(net, NETPLAY_HELLO, 0, seed)) {
+        netplay_close(net);
+        return NULL;
+    }
+    return net;
+}
+
+struct netplay_t*
+netplay_join(const char* address, uint32_t* seed)
+{
+    int fd = open_socket(address, 0);
+    if (fd == -1)
+        return NULL;
+    struct netplay_t* net = wrap_socket(fd);
+    if (net == NULL)
+        return NULL;
+
+    /* The first message is the hello. */
+    int type, got;
+    long frame;
+    uint64_t value;
+    while ((got = netplay_receive(net, &type, &frame, &value)) == 0)
+        usleep(1000);
+    if (got < 0 || type != NETPLAY_HELLO) {
+        netplay_close(net);
+        return NULL;
+    }
+    *seed = value;
+    return net;
+}
+
+int
+netplay_send(struct netplay_t* net, int type, long frame, uint64_t value)
+{
+    unsigned char buf[MESSAGE_SIZE];
+    buf[0] = type;
+    for (int k = 0; k < 4; k++)
+        buf[1 + k] = (frame >> (24 - 8 * k)) & 0xFF;
+    for (int k = 0; k < 8; k++)
+        buf[5 + k] = (value >> (56 - 8 * k)) & 0xFF;
+
+    /*
+     * Messages are small, so the socket buffer is rarely full. A player
+     * that has left must not kill this one with SIGPIPE.
+     */
+    int sent = 0;
+    while (sent < MESSAGE_SIZE) {
+        ssize_t n = send(net->fd, buf + sent, MESSAGE_SIZE - sent,
+                MSG_NOSIGNAL);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            continue;
+        if (n <= 0)
+            return -1;
+        sent += n;
+    }
+    return 0;
+}
+
+int
+netplay_receive(struct netplay_t* net, int* type, long* frame,
+        uint64_t* value)
+{
+    while (net->len < MESSAGE_SIZE) {
+        ssize_t n = recv(net->fd, net->buf + net->len, MESSAGE_SIZE - net->len, 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        net->len += n;
+    }
+    net->len = 0;
+    *type = net->buf[0];
+    *frame = 0;
+    for (int k = 0; k < 4; k++)
+        *frame = (*frame << 8) | net->buf[1 + k];
+    *value = 0;
+    for (int k = 0; k < 8; k++)
+        *value = (*value << 8) | net->buf[5 + k];
+    return 1;
+}
+
+void
+netplay_close(struct netplay_t* net)
+{
+    close(net->fd);
+    free(net);
+}
@@ -0,0 +1,66 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETPLAY_H_
+#define NETPLAY_H_
+
+#include <stdint.h>
+
+/*
+ * Messages between the two players. Every message is a type, a frame and
+ * a value, sent in network byte order.
+ */
+#define NETPLAY_HELLO 1     // Sent by the host: value is the random seed.
+#define NETPLAY_KEYS 2      // Keys held from frame on.
+#define NETPLAY_HASH 3      // Hash of the state before frame.
+
+/**
+ * Connection with the other player. Addresses containing a '/' are UNIX
+ * socket paths; anything else is a TCP port, optionally preceded by a
+ * host and a colon, on the loopback interface by default.
+ */
+struct netplay_t;
+
+/**
+ * Wait for the other player to connect and tell it the seed.
+ * @return the connection, or NULL on error.
+ */
+struct netplay_t* netplay_host(const char* address, uint32_t seed);
+
+/**
+ * Connect to a player that is hosting and get the seed from it.
+ * @return the connection, or NULL on error.
+ */
+struct netplay_t* netplay_join(const char* address, uint32_t* seed);
+
+/**
+ * Send a message. A broken connection does not raise SIGPIPE.
+ * @return 0, or -1 if the connection is broken.
+ */
+int netplay_send(struct netplay_t* net, int type, long frame, uint64_t value);
+
+/**
+ * Take a message that has arrived, without waiting.
+ * @return 1 if there was a message, 0 if not, -1 if the connection is over.
+ */
+int netplay_receive(struct netplay_t* net, int* type, long* frame,
+        uint64_t* value);
+
+void netplay_close(struct netplay_t* net);
+
+#endif // NETPLAY_H_
@@ -0,0 +1,504 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "analyze.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OPCODE_NNN(opcode) (opcode & 0xFFF)
+#define OPCODE_KK(opcode) (opcode & 0xFF)
+#define OPCODE_N(opcode) (opcode & 0xF)
+#define OPCODE_X(opcode) ((opcode >> 8) & 0xF)
+#define OPCODE_P(opcode) (opcode >> 12)
+
+/* Artifact file header. Version must be bumped when the layout changes. */
+#define AN_MAGIC "C8AN"
+#define AN_VERSION 1
+
+/**
+ * Abstract state carried along every path during the walk. Only what is
+ * needed to resolve sprites, stores and BNNN targets is tracked: the I
+ * register and V0, each one either known to be a constant or unknown.
+ */
+struct walk_t
+{
+    address pc;
+    address i;
+    byte v0;
+    byte i_known, v0_known;
+};
+
+/* Bytes an FX33/FX55 writes when reached with a known I. */
+struct store_t
+{
+    address pc;                 // The store.
+    address from;               // First address written.
+    byte len;                   // Bytes written.
+};
+
+/*
+ * Every address is walked with the merge of the states of all the paths
+ * that reach it: a value that differs between paths becomes unknown. A
+ * field only goes from known to unknown, so an address is walked at most
+ * three times and every walk pushes at most two successors.
+ */
+#define MAX_PUSHES (6 * MEMSIZ)
+
+/**
+ * Scratch data used while analyzing. The walk is a worklist over
+ * addresses; an address is queued again whenever its state loses a known
+ * value. Stores are recorded as every path reaches them, before states
+ * are merged, so that a store is checked against every known I.
+ */
+struct scratch_t
+{
+    const byte* mem;            // Memory being analyzed.
+    byte insn[MEMSIZ];          // Does an instruction start here?
+    byte in_queue[MEMSIZ];      // Is the address waiting to be walked?
+    struct walk_t state[MEMSIZ]; // Merged state of the paths reaching it.
+    int target[MEMSIZ];         // Resolved BNNN target or -1.
+    struct store_t stores[MAX_PUSHES];
+    int nstores;
+    address queue[MEMSIZ];
+    int queued;
+};
+
+static word
+fetch(const byte* mem, address pc)
+{
+    return (mem[pc] << 8) | mem[pc + 1];
+}
+
+static int
+is_skip(word opcode)
+{
+    switch (OPCODE_P(opcode)) {
+    case 0x3: case 0x4: case 0x5: case 0x9:
+        return 1;
+    case 0xE:
+        return OPCODE_KK(opcode) == 0x9E || OPCODE_KK(opcode) == 0xA1;
+    }
+    return 0;
+}
+
+/* Does the opcode write V0 with something that is not a constant? */
+static int
+clobbers_v0(word opcode)
+{
+    switch (OPCODE_P(opcode)) {
+    case 0x8: case 0xC:
+        return OPCODE_X(opcode) == 0;
+    case 0xF:
+        switch (OPCODE_KK(opcode)) {
+        case 0x07: case 0x0A:
+            return OPCODE_X(opcode) == 0;
+        case 0x65: case 0x85:
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Record the bytes a store writes if it is reached with a known I. */
+static void
+note_store(struct scratch_t* s, const struct walk_t* state)
+{
+    if (!state->i_known || state->pc >= MEMSIZ - 1
+            || s->nstores == MAX_PUSHES)
+        return;
+    word opcode = fetch(s->mem, state->pc);
+    if (OPCODE_P(opcode) != 0xF)
+        return;
+    int len = OPCODE_KK(opcode) == 0x33 ? 3
+        : OPCODE_KK(opcode) == 0x55 ? OPCODE_X(opcode) + 1 : 0;
+    if (len == 0)
+        return;
+    struct store_t* store = &s->stores[s->nstores++];
+    store->pc = state->pc;
+    store->from = state->i;
+    store->len = len;
+}
+
+static void
+push(struct scratch_t* s, struct walk_t state, address pc)
+{
+    state.pc = pc & ADDRESS_MASK;
+    note_store(s, &state);
+
+    struct walk_t* known = &s->state[state.pc];
+    if (!s->insn[state.pc]) {
+        s->insn[state.pc] = 1;
+        *known = state;
+    } else {
+        /* Forget what the paths disagree on; walk again if it changed. */
+        int changed = 0;
+        if (known->i_known && (!state.i_known || state.i != known->i)) {
+            known->i_known = 0;
+            changed = 1;
+        }
+        if (known->v0_known && (!state.v0_known || state.v0 != known->v0)) {
+            known->v0_known = 0;
+            changed = 1;
+        }
+        if (!changed)
+            return;
+    }
+    if (!s->in_queue[state.pc]) {
+        s->in_queue[state.pc] = 1;
+        s->queue[s->queued++] = state.pc;
+    }
+}
+
+static void
+mark(byte* map, address from, int len, byte flag)
+{
+    for (int k = 0; k < len && from + k < MEMSIZ; k++) {
+        map[from + k] |= flag;
+    }
+}
+
+/**
+ * Follow every reachable path from 0x200, marking instructions, leaders,
+ * sprites and stores. This does not build blocks yet; it only discovers
+ * which addresses hold instructions and where control can go.
+ */
+static void
+walk(struct analysis_t* an, struct scratch_t* s, const byte* mem)
+{
+    struct walk_t entry = { 0x200, 0, 0, 0, 0 };
+    push(s, entry, 0x200);
+    an->map[0x200] |= AN_LEADER;
+
+    while (s->queued > 0) {
+        address pc = s->queue[--s->queued];
+        struct walk_t st = s->state[pc];
+        s->in_queue[pc] = 0;
+        if (pc >= MEMSIZ - 1)
+            continue;
+        word opcode = fetch(mem, pc);
+        address next = (pc + 2) & ADDRESS_MASK;
+        mark(an->map, pc, 2, AN_CODE);
+
+        if (opcode == 0x00EE || opcode == 0x00FD) {
+            continue;
+        } else if (OPCODE_P(opcode) == 0x1) {
+            an->map[OPCODE_NNN(opcode)] |= AN_LEADER;
+            push(s, st, OPCODE_NNN(opcode));
+            continue;
+        } else if (OPCODE_P(opcode) == 0x2) {
+            /* The callee may clobber anything; forget what we know. */
+            struct walk_t unknown = { 0, 0, 0, 0, 0 };
+            an->map[OPCODE_NNN(opcode)] |= AN_LEADER | AN_CALL;
+            an->map[next] |= AN_LEADER;
+            push(s, unknown, OPCODE_NNN(opcode));
+            push(s, unknown, next);
+            continue;
+        } else if (OPCODE_P(opcode) == 0xB) {
+            if (st.v0_known) {
+                address to = (st.v0 + OPCODE_NNN(opcode)) & ADDRESS_MASK;
+                s->target[pc] = to;
+                an->map[to] |= AN_LEADER;
+                push(s, st, to);
+            } else {
+                s->target[pc] = -1;
+                an->map[pc] |= AN_INDIRECT;
+            }
+            continue;
+        } else if (is_skip(opcode)) {
+            address skip = (pc + 4) & ADDRESS_MASK;
+            an->map[next] |= AN_LEADER;
+            an->map[skip] |= AN_LEADER;
+            push(s, st, skip);
+            push(s, st, next);
+            continue;
+        }
+
+        /* Straight line instruction: update the tracked state. */
+        switch (OPCODE_P(opcode)) {
+        case 0x6:
+            if (OPCODE_X(opcode) == 0) {
+                st.v0 = OPCODE_KK(opcode);
+                st.v0_known = 1;
+            }
+            break;
+        case 0x7:
+            if (OPCODE_X(opcode) == 0)
+                st.v0 += OPCODE_KK(opcode);
+            break;
+        case 0xA:
+            st.i = OPCODE_NNN(opcode);
+            st.i_known = 1;
+            break;
+        case 0xD:
+            if (st.i_known) {
+                int rows = OPCODE_N(opcode) ? OPCODE_N(opcode) : 32;
+                mark(an->map, st.i, rows, AN_SPRITE);
+            }
+            break;
+        case 0xF:
+            switch (OPCODE_KK(opcode)) {
+            case 0x1E: case 0x29: case 0x30:
+                st.i_known = 0;
+                break;
+            }
+            break;
+        }
+        if (clobbers_v0(opcode))
+            st.v0_known = 0;
+        push(s, st, next);
+    }
+}
+
+/**
+ * Split the discovered instructions into basic blocks. Every leader starts
+ * a block that lasts until a control transfer or until the next leader.
+ */
+static int
+build_blocks(struct analysis_t* an, struct scratch_t* s, const byte* mem)
+{
+    int capacity = 64;
+    an->blocks = malloc(capacity * sizeof(struct an_block_t));
+    if (an->blocks == NULL)
+        return 1;
+
+    for (int leader = 0; leader < MEMSIZ; leader++) {
+        if (!(an->map[leader] & AN_LEADER) || !s->insn[leader])
+            continue;
+        if (an->nblocks == capacity) {
+            capacity *= 2;
+            struct an_block_t* grown = realloc(an->blocks,
+                    capacity * sizeof(struct an_block_t));
+            if (grown == NULL)
+                return 1;
+            an->blocks = grown;
+        }
+
+        struct an_block_t* b = &an->blocks[an->nblocks++];
+        memset(b, 0, sizeof(struct an_block_t));
+        b->start = leader;
+        address pc = leader;
+        for (;;) {
+            if (pc >= MEMSIZ - 1) {
+                b->kind = AN_END_EXIT;
+                break;
+            }
+            word opcode = fetch(mem, pc);
+            address next = (pc + 2) & ADDRESS_MASK;
+            b->end = pc + 2;
+            if (opcode == 0x00EE) {
+                b->kind = AN_END_RET;
+            } else if (opcode == 0x00FD) {
+                b->kind = AN_END_EXIT;
+            } else if (OPCODE_P(opcode) == 0x1) {
+                b->kind = AN_END_JUMP;
+                b->succ[b->nsucc++] = OPCODE_NNN(opcode);
+            } else if (OPCODE_P(opcode) == 0x2) {
+                b->kind = AN_END_CALL;
+                b->succ[b->nsucc++] = OPCODE_NNN(opcode);
+                b->succ[b->nsucc++] = next;
+            } else if (OPCODE_P(opcode) == 0xB) {
+                if (s->target[pc] >= 0) {
+                    b->kind = AN_END_JUMP;
+                    b->succ[b->nsucc++] = s->target[pc];
+                } else {
+                    b->kind = AN_END_INDIRECT;
+                }
+            } else if (is_skip(opcode)) {
+                b->kind = AN_END_SKIP;
+                b->succ[b->nsucc++] = next;
+                b->succ[b->nsucc++] = (pc + 4) & ADDRESS_MASK;
+            } else if (an->map[next] & AN_LEADER) {
+                b->kind = AN_END_FALL;
+                b->succ[b->nsucc++] = next;
+            } else {
+                pc = next;
+                continue;
+            }
+            break;
+        }
+    }
+    return 0;
+}
+
+int
+analyze_memory(struct analysis_t* an, const byte* mem)
+{
+    memset(an, 0, sizeof(struct analysis_t));
+    struct scratch_t* s = calloc(1, sizeof(struct scratch_t));
+    if (s == NULL)
+        return 1;
+    for (int k = 0; k < MEMSIZ; k++) {
+        s->target[k] = -1;
+    }
+    s->mem = mem;
+
+    walk(an, s, mem);
+
+    /* Flag stores that land on code, now that all code is known. */
+    for (int n = 0; n < s->nstores; n++) {
+        const struct store_t* store = &s->stores[n];
+        for (int k = 0; k < store->len; k++) {
+            address to = store->from + k;
+            if (to < MEMSIZ && (an->map[to] & AN_CODE)) {
+                an->map[to] |= AN_WRITTEN;
+                an->map[store->pc] |= AN_SMC;
+            }
+        }
+    }
+
+    int status = build_blocks(an, s, mem);
+    an->checksum = analysis_checksum(mem);
+    free(s);
+    if (status)
+        free_analysis(an);
+    return status;
+}
+
+const struct an_block_t*
+find_block(const struct analysis_t* an, address pc)
+{
+    int lo = 0, hi = an->nblocks - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (an->blocks[mid].start == pc)
+            return &an->blocks[mid];
+        else if (an->blocks[mid].start < pc)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return NULL;
+}
+
+uint32_t
+analysis_checksum(const byte* mem)
+{
+    /* FNV-1a: tiny and good enough to detect a different ROM. */
+    uint32_t hash = 2166136261u;
+    for (int k = 0; k < MEMSIZ; k++) {
+        hash = (hash ^ mem[k]) * 16777619u;
+    }
+    return hash;
+}
+
+/* The artifact is always little endian, whatever the host is. */
+static void
+put16(FILE* fp, uint16_t value)
+{
+    fputc(value & 0xFF, fp);
+    fputc(value >> 8, fp);
+}
+
+static void
+put32(FILE* fp, uint32_t value)
+{
+    put16(fp, value & 0xFFFF);
+    put16(fp, value >> 16);
+}
+
+static uint32_t
+get(FILE* fp, int bytes)
+{
+    uint32_t value = 0;
+    for (int k = 0; k < bytes; k++) {
+        int c = fgetc(fp);
+        value |= (uint32_t) (c == EOF ? 0 : c) << (8 * k);
+    }
+    return value;
+}
+
+int
+save_analysis(const struct analysis_t* an, const char* file)
+{
+    FILE* fp = fopen(file, "wb");
+    if (fp == NULL)
+        return 1;
+    fwrite(AN_MAGIC, 4, 1, fp);
+    put16(fp, AN_VERSION);
+    put16(fp, 0);
+    put32(fp, an->checksum);
+    put32(fp, an->nblocks);
+    fwrite(an->map, MEMSIZ, 1, fp);
+    for (int k = 0; k < an->nblocks; k++) {
+        const struct an_block_t* b = &an->blocks[k];
+        put16(fp, b->start);
+        put16(fp, b->end);
+        put16(fp, b->succ[0]);
+        put16(fp, b->succ[1]);
+        fputc(b->nsucc, fp);
+        fputc(b->kind, fp);
+    }
+    return fclose(fp) != 0;
+}
+
+int
+load_analysis(struct analysis_t* an, const char* file)
+{
+    memset(an, 0, sizeof(struct analysis_t));
+    FILE* fp = fopen(file, "rb");
+    if (fp == NULL)
+        return 1;
+
+    char magic[4];
+    if (fread(magic, 4, 1, fp) != 1 || memcmp(magic, AN_MAGIC, 4)
+            || get(fp, 2) != AN_VERSION) {
+        fclose(fp);
+        return 1;
+    }
+    get(fp, 2);
+    an->checksum = get(fp, 4);
+    an->nblocks = get(fp, 4);
+    if (an->nblocks > MEMSIZ / 2 || fread(an->map, MEMSIZ, 1, fp) != 1) {
+        fclose(fp);
+        return 1;
+    }
+
+    an->blocks = calloc(an->nblocks ? an->nblocks : 1,
+            sizeof(struct an_block_t));
+    if (an->blocks == NULL) {
+        fclose(fp);
+        return 1;
+    }
+    for (int k = 0; k < an->nblocks; k++) {
+        struct an_block_t* b = &an->blocks[k];
+        b->start = get(fp, 2) & ADDRESS_MASK;
+        b->end = get(fp, 2) & 0x1FFF;
+        b->succ[0] = get(fp, 2) & ADDRESS_MASK;
+        b->succ[1] = get(fp, 2) & ADDRESS_MASK;
+        b->nsucc = get(fp, 1);
+        if (b->nsucc > 2)
+            b->nsucc = 2;
+        b->kind = get(fp, 1);
+    }
+    int truncated = feof(fp);
+    fclose(fp);
+    if (truncated) {
+        free_analysis(an);
+        return 1;
+    }
+    return 0;
+}
+
+void
+free_analysis(struct analysis_t* an)
+{
+    free(an->blocks);
+    an->blocks = NULL;
+    an->nblocks = 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ANALYZE_H_
+#define ANALYZE_H_
+
+#include "cpu.h"
+
+/* Flags for every byte in the analysis map. */
+#define AN_CODE 0x01        // Part of a reachable instruction.
+#define AN_SPRITE 0x02      // Read as sprite data by a DXYN.
+#define AN_LEADER 0x04      // First instruction of a basic block.
+#define AN_CALL 0x08        // Entry point of a 2NNN subroutine.
+#define AN_SMC 0x10         // FX33/FX55 store that writes into code.
+#define AN_WRITTEN 0x20     // Code byte that a store will overwrite.
+#define AN_INDIRECT 0x40    // BNNN whose target could not be resolved.
+
+/* How a basic block ends. */
+#define AN_END_FALL 0       // Falls through into the next leader.
+#define AN_END_JUMP 1       // 1NNN, or BNNN with a known target.
+#define AN_END_CALL 2       // 2NNN, continues after the call on return.
+#define AN_END_RET 3        // 00EE.
+#define AN_END_SKIP 4       // Conditional skip, two successors.
+#define AN_END_EXIT 5       // 00FD, or running off the end of memory.
+#define AN_END_INDIRECT 6   // BNNN with an unknown target.
+
+/**
+ * A basic block is a run of instructions that is always executed from
+ * the first one to the last one. Control only enters at start and only
+ * leaves after the last instruction, towards one of the successors.
+ */
+struct an_block_t
+{
+    address start;      // Address of the first instruction.
+    address end;        // Address right after the last instruction.
+    address succ[2];    // Successor blocks, nsucc of them are valid.
+    byte nsucc;         // How many successors there are.
+    byte kind;          // How the block ends, one of AN_END_*.
+};
+
+/**
+ * Result of the static analysis of a ROM. The map has one entry per byte
+ * of memory holding the AN_* flags. A byte in the ROM area that is neither
+ * code nor sprite is data. Blocks are sorted by start address.
+ */
+struct analysis_t
+{
+    byte map[MEMSIZ];               // AN_* flags for every address.
+    uint32_t checksum;              // Checksum of the analyzed memory.
+    int nblocks;                    // How many blocks there are.
+    struct an_block_t* blocks;      // Control flow graph.
+};
+
+/**
+ * Analyze the program loaded in memory. The analyzer walks every path from
+ * 0x200 following jumps, calls, returns and skips, tracking the value of I
+ * and V0 along the way so that sprites and BNNN targets can be resolved
+ * when they are loaded with constants.
+ *
+ * @param an analysis structure to fill. Release it with free_analysis.
+ * @param mem memory image of the machine, after loading the ROM.
+ * @return 0 on success, != 0 if memory could not be allocated.
+ */
+int analyze_memory(struct analysis_t* an, const byte* mem);
+
+/**
+ * Find the basic block starting at the given address.
+ * @return the block or NULL if there is no block starting there.
+ */
+const struct an_block_t* find_block(const struct analysis_t* an, address pc);
+
+/**
+ * Compute the checksum used to match an analysis with a memory image.
+ */
+uint32_t analysis_checksum(const byte* mem);
+
+/**
+ * Write an analysis to a file so that it can be loaded at startup.
+ * @return 0 on success, != 0 on error.
+ */
+int save_analysis(const struct analysis_t* an, const char* file);
+
+/**
+ * Read an analysis written by save_analysis.
+ * @return 0 on success, != 0 if the file cannot be read or is not valid.
+ */
+int load_analysis(struct analysis_t* an, const char* file);
+
+/**
+ * Release the memory used by an analysis.
+ */
+void free_analysis(struct analysis_t* an);
+
+#endif // ANALYZE_H_
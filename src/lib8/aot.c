@@ -0,0 +1,489 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "aot.h"
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OPCODE_NNN(opcode) (opcode & 0xFFF)
+#define OPCODE_KK(opcode) (opcode & 0xFF)
+#define OPCODE_N(opcode) (opcode & 0xF)
+#define OPCODE_X(opcode) ((opcode >> 8) & 0xF)
+#define OPCODE_Y(opcode) ((opcode >> 4) & 0xF)
+#define OPCODE_P(opcode) (opcode >> 12)
+
+#define STRINGIFY(...) #__VA_ARGS__
+#define EXPAND_STRING(...) STRINGIFY(__VA_ARGS__)
+
+/**
+ * Runtime data for a loaded module. Blocks are looked up by address, and a
+ * block is removed from the lookup table when its code is overwritten.
+ */
+struct aot_t
+{
+    void* handle;                       // dlopen handle.
+    const struct aot_module_t* module;  // Module exported by the object.
+    struct aot_env_t env;               // Pointers into the machine.
+    aot_block_t entry[MEMSIZ];          // Live block starting at address.
+    unsigned char* live;                // Is block k still valid?
+    address lo, hi;                     // Range of memory with code.
+};
+
+/*
+ * Code generation.
+ */
+
+static word
+fetch(const byte* mem, address pc)
+{
+    return (mem[pc] << 8) | mem[pc + 1];
+}
+
+/* Index of the compiled block starting at an address, or -1. */
+static int
+compiled_at(const int* index, address pc)
+{
+    return index[pc & ADDRESS_MASK];
+}
+
+/**
+ * Emit a jump to another address. Compiled successors are entered with a
+ * tail call so that hot loops never go back to the dispatcher; anything
+ * else returns to run_machine, which picks it up from the PC.
+ */
+static void
+emit_goto(FILE* out, const int* index, address to, const char* indent)
+{
+    to &= ADDRESS_MASK;
+    fprintf(out, "%s*PC = 0x%03x;\n", indent, to);
+    if (compiled_at(index, to) >= 0)
+        fprintf(out, "%sreturn b_%03x(env, budget);\n", indent, to);
+    else
+        fprintf(out, "%sreturn budget;\n", indent);
+}
+
+/**
+ * Emit a straight line instruction as C. Instructions that are not worth
+ * compiling (drawing, timers with side effects, random numbers...) are
+ * delegated to the interpreter through exec.
+ */
+static void
+emit_simple(FILE* out, word opcode, address next, int quirks)
+{
+    int x = OPCODE_X(opcode), y = OPCODE_Y(opcode), kk = OPCODE_KK(opcode);
+    switch (OPCODE_P(opcode)) {
+    case 0x6:
+        fprintf(out, "    V[%d] = %d;\n", x, kk);
+        return;
+    case 0x7:
+        fprintf(out, "    V[%d] += %d;\n", x, kk);
+        return;
+    case 0x8:
+        /* Same statements as the interpreter, also when X or Y is F. */
+        switch (OPCODE_N(opcode)) {
+        case 0x0:
+            fprintf(out, "    V[%d] = V[%d];\n", x, y);
+            return;
+        case 0x1:
+            fprintf(out, "    V[%d] |= V[%d];\n", x, y);
+            if (quirks & QUIRK_LOGIC)
+                fprintf(out, "    V[15] = 0;\n");
+            return;
+        case 0x2:
+            fprintf(out, "    V[%d] &= V[%d];\n", x, y);
+            if (quirks & QUIRK_LOGIC)
+                fprintf(out, "    V[15] = 0;\n");
+            return;
+        case 0x3:
+            fprintf(out, "    V[%d] ^= V[%d];\n", x, y);
+            if (quirks & QUIRK_LOGIC)
+                fprintf(out, "    V[15] = 0;\n");
+            return;
+        case 0x4:
+            fprintf(out, "    V[15] = V[%d] > ((V[%d] + V[%d]) & 0xFF);\n", x, x, y);
+            fprintf(out, "    V[%d] += V[%d];\n", x, y);
+            return;
+        case 0x5:
+            fprintf(out, "    V[15] = V[%d] > V[%d];\n", x, y);
+            fprintf(out, "    V[%d] -= V[%d];\n", x, y);
+            return;
+        case 0x6:
+            if (quirks & QUIRK_SHIFT)
+                fprintf(out, "    V[%d] = V[%d];\n", x, y);
+            fprintf(out, "    V[15] = V[%d] & 1;\n", x);
+            fprintf(out, "    V[%d] >>= 1;\n", x);
+            return;
+        case 0x7:
+            fprintf(out, "    V[15] = V[%d] > V[%d];\n", y, x);
+            fprintf(out, "    V[%d] = V[%d] - V[%d];\n", x, y, x);
+            return;
+        case 0xE:
+            if (quirks & QUIRK_SHIFT)
+                fprintf(out, "    V[%d] = V[%d];\n", x, y);
+            fprintf(out, "    V[15] = (V[%d] & 0x80) != 0;\n", x);
+            fprintf(out, "    V[%d] <<= 1;\n", x);
+            return;
+        }
+        return;
+    case 0xA:
+        fprintf(out, "    *I = 0x%03x;\n", OPCODE_NNN(opcode));
+        return;
+    case 0xF:
+        switch (kk) {
+        case 0x07:
+            fprintf(out, "    V[%d] = *env->dt;\n", x);
+            return;
+        case 0x15:
+            fprintf(out, "    *env->dt = V[%d];\n", x);
+            return;
+        case 0x18:
+            fprintf(out, "    *env->st = V[%d];\n", x);
+            return;
+        case 0x1E:
+            fprintf(out, "    *I = (*I + V[%d]) & 0xFFF;\n", x);
+            return;
+        case 0x29:
+            fprintf(out, "    *I = 0x50 + (V[%d] & 0xF) * 5;\n", x);
+            return;
+        case 0x65:
+            for (int reg = 0; reg <= x; reg++) {
+                fprintf(out, "    V[%d] = MEM[*I + %d];\n", reg, reg);
+            }
+            if (quirks & QUIRK_MEMORY)
+                fprintf(out, "    *I = (*I + %d) & 0xFFF;\n", x + 1);
+            return;
+        }
+        break;
+    }
+    fprintf(out, "    env->exec(env->cpu, 0x%04x, 0x%03x);\n", opcode, next);
+}
+
+/* Does the instruction end a block when it is delegated to exec? */
+static int
+is_delegated_terminator(word opcode)
+{
+    switch (OPCODE_P(opcode)) {
+    case 0x0:
+        return opcode == 0x00FD;
+    case 0xE:
+        return 1;
+    case 0xF:
+        switch (OPCODE_KK(opcode)) {
+        case 0x0A: case 0x33: case 0x55:
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Emit the last instruction of a block and the transfer of control to
+ * whatever comes next.
+ */
+static void
+emit_terminator(FILE* out, const int* index, word opcode, address pc,
+        int quirks)
+{
+    address next = (pc + 2) & ADDRESS_MASK, skip = (pc + 4) & ADDRESS_MASK;
+    int x = OPCODE_X(opcode), y = OPCODE_Y(opcode), kk = OPCODE_KK(opcode);
+    const char* cond = NULL;
+    char buf[32];
+
+    switch (OPCODE_P(opcode)) {
+    case 0x0:
+        if (opcode == 0x00EE) {
+            fprintf(out, "    if (*env->sp > 0)\n");
+            fprintf(out, "        *PC = env->stack[(int) --*env->sp];\n");
+            fprintf(out, "    else\n");
+            fprintf(out, "        *PC = 0x%03x;\n", next);
+            fprintf(out, "    return budget;\n");
+            return;
+        }
+        break;
+    case 0x1:
+        emit_goto(out, index, OPCODE_NNN(opcode), "    ");
+        return;
+    case 0x2:
+        fprintf(out, "    if (*env->sp < 16) {\n");
+        fprintf(out, "        env->stack[(int) (*env->sp)++] = 0x%03x;\n", next);
+        emit_goto(out, index, OPCODE_NNN(opcode), "        ");
+        fprintf(out, "    }\n");
+        emit_goto(out, index, next, "    ");
+        return;
+    case 0x3:
+        snprintf(buf, sizeof(buf), "V[%d] == %d", x, kk);
+        cond = buf;
+        break;
+    case 0x4:
+        snprintf(buf, sizeof(buf), "V[%d] != %d", x, kk);
+        cond = buf;
+        break;
+    case 0x5:
+        snprintf(buf, sizeof(buf), "V[%d] == V[%d]", x, y);
+        cond = buf;
+        break;
+    case 0x9:
+        snprintf(buf, sizeof(buf), "V[%d] != V[%d]", x, y);
+        cond = buf;
+        break;
+    case 0xB:
+        fprintf(out, "    *PC = (V[%d] + 0x%03x) & 0xFFF;\n",
+                (quirks & QUIRK_JUMP) ? x : 0, OPCODE_NNN(opcode));
+        fprintf(out, "    return budget;\n");
+        return;
+    }
+
+    if (cond) {
+        fprintf(out, "    if (%s) {\n", cond);
+        emit_goto(out, index, skip, "        ");
+        fprintf(out, "    }\n");
+        emit_goto(out, index, next, "    ");
+    } else if (is_delegated_terminator(opcode)) {
+        fprintf(out, "    *PC = env->exec(env->cpu, 0x%04x, 0x%03x);\n",
+                opcode, next);
+        fprintf(out, "    return budget;\n");
+    } else {
+        /* Block ended because the next instruction is a leader. */
+        emit_simple(out, opcode, next, quirks);
+        emit_goto(out, index, next, "    ");
+    }
+}
+
+/* Can this block be compiled? Code the ROM overwrites must not be. */
+static int
+is_compilable(const struct analysis_t* an, const struct an_block_t* b)
+{
+    if (b->end <= b->start || b->end > MEMSIZ)
+        return 0;
+    for (int addr = b->start; addr < b->end; addr++) {
+        if (an->map[addr] & AN_WRITTEN)
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * Emit an instruction in the middle of a block. Waiting for a key has to
+ * go back to the dispatcher, and so does a store that overwrites the block
+ * being run. The instructions not run are given back to the budget.
+ */
+static void
+emit_body(FILE* out, word opcode, address pc, int id, int left, int quirks)
+{
+    address next = (pc + 2) & ADDRESS_MASK;
+    if (OPCODE_P(opcode) == 0xF && OPCODE_KK(opcode) == 0x0A) {
+        fprintf(out, "    *PC = env->exec(env->cpu, 0x%04x, 0x%03x);\n",
+                opcode, next);
+        fprintf(out, "    return budget + %d;\n", left);
+    } else if (OPCODE_P(opcode) == 0xF
+            && (OPCODE_KK(opcode) == 0x33 || OPCODE_KK(opcode) == 0x55)) {
+        fprintf(out, "    env->exec(env->cpu, 0x%04x, 0x%03x);\n", opcode, next);
+        fprintf(out, "    if (!env->live[%d]) {\n", id);
+        fprintf(out, "        *PC = 0x%03x;\n", next);
+        fprintf(out, "        return budget + %d;\n", left);
+        fprintf(out, "    }\n");
+    } else {
+        emit_simple(out, opcode, next, quirks);
+    }
+}
+
+int
+aot_generate(FILE* out, const byte* mem, const struct analysis_t* an,
+        int quirks)
+{
+    int* index = malloc(MEMSIZ * sizeof(int));
+    if (index == NULL)
+        return 0;
+    for (int k = 0; k < MEMSIZ; k++) {
+        index[k] = -1;
+    }
+    int count = 0;
+    for (int k = 0; k < an->nblocks; k++) {
+        if (is_compilable(an, &an->blocks[k]))
+            index[an->blocks[k].start] = count++;
+    }
+
+    fprintf(out, "/* Generated by chip8-aot. Do not edit. */\n\n");
+    fprintf(out, "%s;\n%s;\n\n", EXPAND_STRING(AOT_ENV),
+            EXPAND_STRING(AOT_MODULE));
+
+    for (int k = 0; k < an->nblocks; k++) {
+        if (index[an->blocks[k].start] >= 0) {
+            fprintf(out, "static int b_%03x(const struct aot_env_t*, int);\n",
+                    an->blocks[k].start);
+        }
+    }
+
+    for (int k = 0; k < an->nblocks; k++) {
+        const struct an_block_t* b = &an->blocks[k];
+        int id = index[b->start];
+        if (id < 0)
+            continue;
+        fprintf(out, "\nstatic int\nb_%03x(const struct aot_env_t* env, int budget)\n{\n",
+                b->start);
+        fprintf(out, "    unsigned char* const V = env->v;\n");
+        fprintf(out, "    unsigned char* const MEM = env->mem;\n");
+        fprintf(out, "    unsigned short* const I = env->i;\n");
+        fprintf(out, "    unsigned short* const PC = env->pc;\n");
+        fprintf(out, "    (void) MEM;\n    (void) I;\n");
+        fprintf(out, "    if (budget < %d || !env->live[%d])\n", (b->end - b->start) / 2, id);
+        fprintf(out, "        return budget;\n");
+        fprintf(out, "    budget -= %d;\n", (b->end - b->start) / 2);
+        for (address pc = b->start; pc + 2 < b->end; pc += 2) {
+            word opcode = fetch(mem, pc);
+            fprintf(out, "    /* 0x%03x: %04X */\n", pc, opcode);
+            emit_body(out, opcode, pc, id, (b->end - pc - 2) / 2, quirks);
+        }
+        word last = fetch(mem, b->end - 2);
+        fprintf(out, "    /* 0x%03x: %04X */\n", b->end - 2, last);
+        emit_terminator(out, index, last, b->end - 2, quirks);
+        fprintf(out, "}\n");
+    }
+
+    fprintf(out, "\nstatic const unsigned short aot_start[] = {");
+    for (int k = 0; k < an->nblocks; k++) {
+        if (index[an->blocks[k].start] >= 0)
+            fprintf(out, " 0x%03x,", an->blocks[k].start);
+    }
+    fprintf(out, " 0 };\nstatic const unsigned short aot_end[] = {");
+    for (int k = 0; k < an->nblocks; k++) {
+        if (index[an->blocks[k].start] >= 0)
+            fprintf(out, " 0x%03x,", an->blocks[k].end);
+    }
+    fprintf(out, " 0 };\nstatic const aot_block_t aot_blocks[] = {");
+    for (int k = 0; k < an->nblocks; k++) {
+        if (index[an->blocks[k].start] >= 0)
+            fprintf(out, "\n    b_%03x,", an->blocks[k].start);
+    }
+    fprintf(out, "\n    0\n};\n\n");
+    fprintf(out, "const struct aot_module_t %s = {\n", AOT_SYMBOL);
+    fprintf(out, "    %d, 0x%08xu, %d, %d, aot_start, aot_end, aot_blocks\n};\n",
+            AOT_ABI_VERSION, an->checksum, quirks, count);
+
+    free(index);
+    return count;
+}
+
+/*
+ * Runtime.
+ */
+
+static unsigned short
+aot_exec(void* data, unsigned short opcode, unsigned short pc)
+{
+    struct machine_t* cpu = data;
+    cpu->pc = pc;
+    execute_opcode(cpu, opcode);
+    return cpu->pc;
+}
+
+int
+aot_load(struct machine_t* cpu, const char* file)
+{
+    struct aot_t* aot = calloc(1, sizeof(struct aot_t));
+    if (aot == NULL)
+        return 1;
+    aot->handle = dlopen(file, RTLD_NOW | RTLD_LOCAL);
+    if (aot->handle == NULL) {
+        free(aot);
+        return 1;
+    }
+
+    const struct aot_module_t* module = dlsym(aot->handle, AOT_SYMBOL);
+    if (module == NULL || module->abi != AOT_ABI_VERSION
+            || module->checksum != analysis_checksum(cpu->mem)
+            || module->quirks != cpu->quirks) {
+        dlclose(aot->handle);
+        free(aot);
+        return 1;
+    }
+    aot->live = malloc(module->nblocks + 1);
+    if (aot->live == NULL) {
+        dlclose(aot->handle);
+        free(aot);
+        return 1;
+    }
+
+    aot->module = module;
+    aot->lo = MEMSIZ;
+    aot->hi = 0;
+    for (int k = 0; k < module->nblocks; k++) {
+        aot->entry[module->start[k] & ADDRESS_MASK] = module->blocks[k];
+        aot->live[k] = 1;
+        if (module->start[k] < aot->lo)
+            aot->lo = module->start[k];
+        if (module->end[k] > aot->hi)
+            aot->hi = module->end[k];
+    }
+
+    aot->env.mem = cpu->mem;
+    aot->env.v = cpu->v;
+    aot->env.i = &cpu->i;
+    aot->env.pc = &cpu->pc;
+    aot->env.stack = cpu->stack;
+    aot->env.sp = &cpu->sp;
+    aot->env.dt = &cpu->dt;
+    aot->env.st = &cpu->st;
+    aot->env.live = aot->live;
+    aot->env.cpu = cpu;
+    aot->env.exec = &aot_exec;
+
+    aot_unload(cpu);
+    cpu->aot = aot;
+    return 0;
+}
+
+void
+aot_unload(struct machine_t* cpu)
+{
+    struct aot_t* aot = cpu->aot;
+    if (aot == NULL)
+        return;
+    cpu->aot = NULL;
+    dlclose(aot->handle);
+    free(aot->live);
+    free(aot);
+}
+
+int
+aot_run(struct machine_t* cpu, int steps)
+{
+    struct aot_t* aot = cpu->aot;
+    aot_block_t block = aot->entry[cpu->pc & ADDRESS_MASK];
+    if (block == NULL)
+        return steps;
+    return block(&aot->env, steps);
+}
+
+void
+aot_invalidate(struct machine_t* cpu, address from, int len)
+{
+    struct aot_t* aot = cpu->aot;
+    if (from >= aot->hi || from + len <= aot->lo)
+        return;
+    const struct aot_module_t* module = aot->module;
+    for (int k = 0; k < module->nblocks; k++) {
+        if (from < module->end[k] && from + len > module->start[k]) {
+            aot->live[k] = 0;
+            aot->entry[module->start[k]] = NULL;
+        }
+    }
+}
@@ -0,0 +1,125 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AOT_H_
+#define AOT_H_
+
+#include "cpu.h"
+#include "analyze.h"
+
+#include <stdio.h>
+
+/*
+ * Ahead of time compilation. chip8-aot translates every basic block of a
+ * ROM into a C function and builds a shared object out of them. At run
+ * time the module is loaded with aot_load and run_machine executes the
+ * native blocks instead of interpreting them.
+ *
+ * Generated code does not include any header. Everything it shares with
+ * lib8 is defined below as macros so that the very same text is compiled
+ * into lib8 and pasted at the top of every generated file.
+ */
+
+/* Must be bumped whenever AOT_ENV or AOT_MODULE change. */
+#define AOT_ABI_VERSION 2
+
+/* Name of the symbol a module exports. */
+#define AOT_SYMBOL "chip8_aot_module"
+
+/**
+ * Machine state as seen by native blocks. Blocks read and write registers
+ * through these pointers and hand anything that is not worth compiling to
+ * exec, which runs one instruction in the interpreter with pc set to the
+ * address of the next instruction and returns the resulting pc.
+ */
+#define AOT_ENV \
+    struct aot_env_t { \
+        unsigned char* mem; \
+        unsigned char* v; \
+        unsigned short* i; \
+        unsigned short* pc; \
+        unsigned short* stack; \
+        char* sp; \
+        unsigned char* dt; \
+        unsigned char* st; \
+        const unsigned char* live; \
+        void* cpu; \
+        unsigned short (*exec)(void*, unsigned short, unsigned short); \
+    }
+
+/**
+ * A native block runs its instructions if the budget allows it, chains
+ * into statically known successors and returns the budget left. When the
+ * budget is too small, or the block was invalidated, it returns without
+ * doing anything and the interpreter takes over.
+ */
+#define AOT_MODULE \
+    typedef int (*aot_block_t)(const struct aot_env_t*, int); \
+    struct aot_module_t { \
+        int abi; \
+        unsigned int checksum; \
+        int quirks; \
+        int nblocks; \
+        const unsigned short* start; \
+        const unsigned short* end; \
+        const aot_block_t* blocks; \
+    }
+
+AOT_ENV;
+AOT_MODULE;
+
+/**
+ * Translate the analyzed program into C. Blocks whose code may be written
+ * by the program itself according to the analysis are left out.
+ *
+ * @param out stream where the C source is written.
+ * @param mem memory image of the machine, after loading the ROM.
+ * @param an analysis of the memory image.
+ * @param quirks quirk profile the module will be run with.
+ * @return how many blocks were translated.
+ */
+int aot_generate(FILE* out, const byte* mem, const struct analysis_t* an,
+        int quirks);
+
+/**
+ * Load a module built by chip8-aot and attach it to a machine. The module
+ * must have been built from the ROM currently loaded in the machine, for
+ * the quirk profile of the machine.
+ *
+ * @return 0 on success, != 0 if the module cannot be used.
+ */
+int aot_load(struct machine_t* cpu, const char* file);
+
+/**
+ * Detach and unload the module attached to a machine, if any.
+ */
+void aot_unload(struct machine_t* cpu);
+
+/**
+ * Run native blocks starting at the current PC while the budget allows.
+ * @return the budget left; equal to steps if no block could run.
+ */
+int aot_run(struct machine_t* cpu, int steps);
+
+/**
+ * Disable every block overlapping a memory range that has been written,
+ * so that modified code goes back to the interpreter.
+ */
+void aot_invalidate(struct machine_t* cpu, address from, int len);
+
+#endif // AOT_H_
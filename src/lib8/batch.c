@@ -0,0 +1,146 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "batch.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct batch_t
+{
+    int n;                          // How many machines.
+    int steps;                      // Instructions per frame.
+    batch_terminal_t terminal;      // Extra terminal condition.
+    void* data;                     // Given to terminal.
+    struct machine_t boot;          // State to reset machines to.
+    struct machine_t* machines;     // n machines, contiguous.
+};
+
+/* Every low resolution pixel becomes two bits. */
+static const byte double_bits[16] = {
+    0x00, 0x03, 0x0C, 0x0F, 0x30, 0x33, 0x3C, 0x3F,
+    0xC0, 0xC3, 0xCC, 0xCF, 0xF0, 0xF3, 0xFC, 0xFF
+};
+
+struct batch_t*
+batch_create(int n, const struct machine_t* boot, int steps, uint32_t seed)
+{
+    struct batch_t* batch = malloc(sizeof(struct batch_t));
+    if (batch == NULL)
+        return NULL;
+    batch->machines = malloc(n * sizeof(struct machine_t));
+    if (batch->machines == NULL) {
+        free(batch);
+        return NULL;
+    }
+    batch->n = n;
+    batch->steps = steps;
+    batch->terminal = NULL;
+    batch->data = NULL;
+
+    memcpy(&batch->boot, boot, sizeof(struct machine_t));
+    batch->boot.keydown = NULL;
+    batch->boot.input = NULL;
+    batch->boot.speaker = NULL;
+    batch->boot.aot = NULL;
+    batch->boot.keypad = 0;
+    for (int k = 0; k < n; k++) {
+        memcpy(&batch->machines[k], &batch->boot, sizeof(struct machine_t));
+        seed_machine(&batch->machines[k], seed + k);
+    }
+    return batch;
+}
+
+void
+batch_set_terminal(struct batch_t* batch, batch_terminal_t terminal,
+        void* data)
+{
+    batch->terminal = terminal;
+    batch->data = data;
+}
+
+void
+batch_reset(struct batch_t* batch, int k)
+{
+    struct machine_t* cpu = &batch->machines[k];
+    uint32_t rng = cpu->rng;
+    memcpy(cpu, &batch->boot, sizeof(struct machine_t));
+    cpu->rng = rng;
+}
+
+struct machine_t*
+batch_machine(struct batch_t* batch, int k)
+{
+    return &batch->machines[k];
+}
+
+void
+batch_observe(const struct machine_t* cpu, byte* obs)
+{
+    if (cpu->esm) {
+        for (int k = 0; k < BATCH_OBS_SIZE; k++) {
+            const char* px = cpu->screen + 8 * k;
+            obs[k] = (px[0] & 1) << 7 | (px[1] & 1) << 6 | (px[2] & 1) << 5
+                | (px[3] & 1) << 4 | (px[4] & 1) << 3 | (px[5] & 1) << 2
+                | (px[6] & 1) << 1 | (px[7] & 1);
+        }
+        return;
+    }
+
+    /* Pack a low resolution row into 8 bytes and write it twice. */
+    for (int y = 0; y < 32; y++) {
+        byte* row = obs + 32 * y;
+        for (int x = 0; x < 64; x += 4) {
+            const char* px = cpu->screen + 64 * y + x;
+            row[x / 4] = double_bits[(px[0] & 1) << 3 | (px[1] & 1) << 2
+                | (px[2] & 1) << 1 | (px[3] & 1)];
+        }
+        memcpy(row + 16, row, 16);
+    }
+}
+
+int
+batch_run_frame(struct batch_t* batch, const word* keys, byte* obs,
+        byte* done)
+{
+    int resets = 0;
+    for (int k = 0; k < batch->n; k++) {
+        struct machine_t* cpu = &batch->machines[k];
+        cpu->keypad = keys[k];
+        run_machine(cpu, batch->steps);
+        tick_timers(cpu);
+
+        int over = cpu->exit
+            || (batch->terminal && batch->terminal(cpu, batch->data));
+        if (over) {
+            batch_reset(batch, k);
+            resets++;
+        }
+        if (done)
+            done[k] = over;
+        if (obs)
+            batch_observe(cpu, obs + k * BATCH_OBS_SIZE);
+    }
+    return resets;
+}
+
+void
+batch_destroy(struct batch_t* batch)
+{
+    free(batch->machines);
+    free(batch);
+}
@@ -0,0 +1,98 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include "cpu.h"
+
+/**
+ * Size of the observation of a machine: a 128x64 bitmap, one bit per
+ * pixel, most significant bit first. Low resolution screens are scaled
+ * up 2x so that every observation has the same shape.
+ */
+#define BATCH_OBS_SIZE (128 * 64 / 8)
+
+/**
+ * Decides whether an episode is over, besides 00FD.
+ * @param cpu machine that has just run a frame.
+ * @param data pointer given to batch_set_terminal.
+ * @return != 0 if the machine should be reset.
+ */
+typedef int (*batch_terminal_t)(const struct machine_t* cpu, void* data);
+
+/**
+ * A batch of machines running the same ROM in lockstep. The machines are
+ * kept in one contiguous array and are reset to the boot state when an
+ * episode is over.
+ */
+struct batch_t;
+
+/**
+ * Create a batch. Every machine starts as a copy of boot, which usually is
+ * a machine that has just loaded a ROM. Keyboard pollers, speakers and
+ * native modules are not copied: keys come from batch_run_frame.
+ *
+ * @param n how many machines.
+ * @param boot state machines start from and are reset to.
+ * @param steps how many instructions make a frame.
+ * @param seed machine k is seeded with seed + k.
+ * @return the batch, or NULL if out of memory.
+ */
+struct batch_t* batch_create(int n, const struct machine_t* boot, int steps,
+        uint32_t seed);
+
+/**
+ * Set a terminal condition checked after every frame, or NULL for none.
+ */
+void batch_set_terminal(struct batch_t* batch, batch_terminal_t terminal,
+        void* data);
+
+/**
+ * Run one frame on every machine: set the keypad, run the instructions
+ * of a frame and tick the timers once. Machines whose episode is over
+ * are reset; their observation is the first one of the new episode.
+ *
+ * @param keys n keypad masks, bit K is key K.
+ * @param obs n * BATCH_OBS_SIZE bytes for the observations, or NULL.
+ * @param done n flags set to 1 when the machine was reset, or NULL.
+ * @return how many machines were reset.
+ */
+int batch_run_frame(struct batch_t* batch, const word* keys, byte* obs,
+        byte* done);
+
+/**
+ * Reset a machine to the boot state. The random number generator is not
+ * reset, so episodes differ.
+ */
+void batch_reset(struct batch_t* batch, int k);
+
+/**
+ * Get a machine of the batch.
+ */
+struct machine_t* batch_machine(struct batch_t* batch, int k);
+
+/**
+ * Pack the screen of a machine into an observation.
+ * @param obs BATCH_OBS_SIZE bytes.
+ */
+void batch_observe(const struct machine_t* cpu, byte* obs);
+
+void batch_destroy(struct batch_t* batch);
+
+#endif // BATCH_H_
@@ -0,0 +1,258 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "compact.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct pool_t
+{
+    int n;                          // How many machines.
+    int steps;                      // Instructions per frame.
+    struct host_t host;             // Shared by every machine.
+    struct machine_t work;          // Machines are run here.
+    struct compact_t* machines;     // n compact machines, contiguous.
+};
+
+/*
+ * Pixels are either 0 or 1, so eight of them read as a little endian word
+ * can be gathered into a byte, or spread back, with a multiplication.
+ */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+static inline byte
+pack_pixels(const char* px)
+{
+    uint64_t word;
+    memcpy(&word, px, sizeof(word));
+    return (word * 0x8040201008040201ULL) >> 56;
+}
+
+static inline void
+unpack_pixels(char* px, byte bits)
+{
+    uint64_t word = (bits * 0x0101010101010101ULL) & 0x0102040810204080ULL;
+    word = ((word + 0x7F7F7F7F7F7F7F7FULL) >> 7) & 0x0101010101010101ULL;
+    memcpy(px, &word, sizeof(word));
+}
+
+#else
+
+static inline byte
+pack_pixels(const char* px)
+{
+    return px[0] << 7 | px[1] << 6 | px[2] << 5 | px[3] << 4
+        | px[4] << 3 | px[5] << 2 | px[6] << 1 | px[7];
+}
+
+static inline void
+unpack_pixels(char* px, byte bits)
+{
+    for (int b = 0; b < 8; b++)
+        px[b] = (bits >> (7 - b)) & 1;
+}
+
+#endif
+
+void
+compact_pack(struct compact_t* dst, const struct machine_t* cpu)
+{
+    struct compact_regs_t* regs = &dst->regs;
+    regs->pc = cpu->pc;
+    regs->i = cpu->i;
+    memcpy(regs->stack, cpu->stack, sizeof(regs->stack));
+    memcpy(regs->v, cpu->v, sizeof(regs->v));
+    regs->sp = cpu->sp;
+    regs->dt = cpu->dt;
+    regs->st = cpu->st;
+    regs->wait_key = cpu->wait_key;
+    regs->keypad = cpu->keypad;
+    regs->esm = cpu->esm;
+    regs->exit = cpu->exit != 0;
+    regs->rng = cpu->rng;
+
+    dst->screen_key = cpu->screen_key;
+    dst->delta = cpu->delta;
+    dst->cycles = cpu->cycles;
+    dst->clock = cpu->clock;
+    memcpy(dst->r, cpu->r, sizeof(dst->r));
+    memcpy(dst->mem, cpu->mem, sizeof(dst->mem));
+
+    /* Most of the screen is usually blank, 64 pixels are checked at once. */
+    for (int k = 0; k < (int) sizeof(dst->screen); k += 8) {
+        const char* px = cpu->screen + 8 * k;
+        uint64_t any = 0, word[8];
+        memcpy(word, px, sizeof(word));
+        for (int w = 0; w < 8; w++)
+            any |= word[w];
+        if (any == 0) {
+            memset(dst->screen + k, 0, 8);
+            continue;
+        }
+        for (int w = 0; w < 8; w++)
+            dst->screen[k + w] = pack_pixels(px + 8 * w);
+    }
+}
+
+void
+compact_unpack(struct machine_t* cpu, const struct compact_t* src,
+        const struct host_t* host)
+{
+    const struct compact_regs_t* regs = &src->regs;
+    cpu->pc = regs->pc;
+    cpu->i = regs->i;
+    memcpy(cpu->stack, regs->stack, sizeof(regs->stack));
+    memcpy(cpu->v, regs->v, sizeof(regs->v));
+    cpu->sp = regs->sp;
+    cpu->dt = regs->dt;
+    cpu->st = regs->st;
+    cpu->wait_key = regs->wait_key;
+    cpu->keypad = regs->keypad;
+    cpu->esm = regs->esm;
+    cpu->exit = regs->exit;
+    cpu->rng = regs->rng;
+
+    cpu->screen_key = src->screen_key;
+    cpu->delta = src->delta;
+    cpu->cycles = src->cycles;
+    cpu->clock = src->clock;
+    memcpy(cpu->r, src->r, sizeof(cpu->r));
+    memcpy(cpu->mem, src->mem, sizeof(src->mem));
+    memcpy(cpu->mem + MEMSIZ, src->mem, MEMGUARD);
+
+    for (int k = 0; k < (int) sizeof(src->screen); k += 8) {
+        char* px = cpu->screen + 8 * k;
+        uint64_t bits;
+        memcpy(&bits, src->screen + k, sizeof(bits));
+        if (bits == 0) {
+            memset(px, 0, 64);
+            continue;
+        }
+        for (int w = 0; w < 8; w++)
+            unpack_pixels(px + 8 * w, src->screen[k + w]);
+    }
+
+    cpu->keydown = host->keydown;
+    cpu->input = NULL;
+    cpu->speaker = host->speaker;
+    cpu->analysis = host->analysis;
+    cpu->aot = host->aot;
+    set_quirks(cpu, host->quirks);
+}
+
+/* Mix a word into a hash, one multiply and rotate per word. */
+static inline uint64_t
+mix(uint64_t hash, uint64_t word)
+{
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+    return hash << 31 | hash >> 33;
+}
+
+uint64_t
+compact_hash(const struct compact_t* src)
+{
+    const struct compact_regs_t* regs = &src->regs;
+    uint64_t hash = 0xCBF29CE484222325ULL, word;
+    hash = mix(hash, (uint64_t) regs->pc << 48 | (uint64_t) regs->i << 32
+            | regs->sp << 24 | regs->dt << 16 | regs->st << 8 | regs->esm);
+    hash = mix(hash, (uint64_t) regs->rng << 32
+            | (byte) regs->wait_key << 8 | regs->exit);
+    for (int k = 0; k < 16; k += 4) {
+        hash = mix(hash, (uint64_t) regs->stack[k] << 48
+                | (uint64_t) regs->stack[k + 1] << 32
+                | (uint64_t) regs->stack[k + 2] << 16 | regs->stack[k + 3]);
+    }
+    for (int k = 0; k < 16; k += 8) {
+        memcpy(&word, regs->v + k, sizeof(word));
+        hash = mix(hash, word);
+    }
+    for (int k = 0; k < MEMSIZ; k += 8) {
+        memcpy(&word, src->mem + k, sizeof(word));
+        hash = mix(hash, word);
+    }
+    memcpy(&word, src->r, sizeof(word));
+    hash = mix(hash, word);
+    hash = mix(hash, src->screen_key);
+    hash = mix(hash, (uint32_t) src->delta);
+    hash = mix(hash, (uint32_t) src->cycles);
+    return hash ^ hash >> 29;
+}
+
+struct pool_t*
+pool_create(int n, const struct machine_t* boot, int steps, uint32_t seed)
+{
+    struct pool_t* pool = malloc(sizeof(struct pool_t));
+    if (pool == NULL)
+        return NULL;
+    void* machines;
+    if (posix_memalign(&machines, 64, n * sizeof(struct compact_t))) {
+        free(pool);
+        return NULL;
+    }
+    pool->machines = machines;
+    pool->n = n;
+    pool->steps = steps;
+    pool->host.keydown = boot->keydown;
+    pool->host.speaker = boot->speaker;
+    pool->host.analysis = boot->analysis;
+    pool->host.aot = NULL;
+    pool->host.quirks = boot->quirks;
+
+    memcpy(&pool->work, boot, sizeof(struct machine_t));
+    pool->work.input = NULL;
+    for (int k = 0; k < n; k++) {
+        seed_machine(&pool->work, seed + k);
+        compact_pack(&pool->machines[k], &pool->work);
+    }
+    return pool;
+}
+
+void
+pool_run_frame(struct pool_t* pool, const word* keys)
+{
+    struct machine_t* cpu = &pool->work;
+    for (int k = 0; k < pool->n; k++) {
+        compact_unpack(cpu, &pool->machines[k], &pool->host);
+        if (keys)
+            cpu->keypad = keys[k];
+        run_machine(cpu, pool->steps);
+        tick_timers(cpu);
+        compact_pack(&pool->machines[k], cpu);
+    }
+}
+
+struct compact_t*
+pool_machine(struct pool_t* pool, int k)
+{
+    return &pool->machines[k];
+}
+
+struct host_t*
+pool_host(struct pool_t* pool)
+{
+    return &pool->host;
+}
+
+void
+pool_destroy(struct pool_t* pool)
+{
+    free(pool->machines);
+    free(pool);
+}
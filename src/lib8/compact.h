@@ -0,0 +1,140 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMPACT_H_
+#define COMPACT_H_
+
+#include "cpu.h"
+
+/**
+ * Compact machines. A machine_t is about 12 KB, mostly the byte per pixel
+ * screen, with the registers spread between large arrays and callbacks in
+ * every instance. A compact machine keeps the same state in about 5 KB:
+ * the registers fit a single cache line, the screen takes a bit per pixel
+ * and the memory mirror is left out. Callbacks and quirks are shared by every
+ * machine of a host instead.
+ *
+ * Compact machines cannot run by themselves. They are unpacked into a
+ * machine_t that is reused for every machine and stays in cache, run and
+ * packed again. Large pools of machines for searches and batch jobs are
+ * meant to be kept this way.
+ */
+
+/**
+ * Things shared by every compact machine of a host.
+ */
+struct host_t
+{
+    keyboard_poller_t keydown;  // Keyboard poller, or NULL to use the keypad.
+    speaker_handler_t speaker;  // Speaker handler, or NULL.
+    const struct analysis_t* analysis; // Static analysis of the ROM, if any.
+    struct aot_t* aot;          // Native code of the unpacked machine, or NULL.
+    int quirks;                 // Quirk profile.
+};
+
+/**
+ * Registers of a compact machine, in a single cache line.
+ */
+struct compact_regs_t
+{
+    address pc;                 // Program Counter
+    address i;                  // Special I register
+    address stack[16];          // Stack
+    byte v[16];                 // General purpose registers
+    byte sp;                    // Stack Pointer
+    byte dt, st;                // Timers
+    char wait_key;              // Key the CHIP-8 is idle waiting for.
+    word keypad;                // Keys down.
+    byte esm;                   // Is in Extended Screen Mode?
+    byte exit;                  // Should close the game.
+    uint32_t rng;               // State of the random number generator.
+} __attribute__((aligned(64)));
+
+struct compact_t
+{
+    struct compact_regs_t regs; // Hot registers.
+    byte mem[MEMSIZ];           // Memory, without the mirror.
+    byte screen[1024];          // Screen, one bit per pixel, MSB first.
+    uint64_t screen_key;        // Zobrist hash of the screen.
+    byte r[8];                  // R register set.
+    int delta;                  // Milliseconds not yet applied to timers.
+    int cycles;                 // VIP cycles run past the last frame budget.
+    uint64_t clock;             // Steps run, the time of key events.
+} __attribute__((aligned(64)));
+
+/**
+ * Pack the state of a machine. Callbacks, quirks and native code are not
+ * kept: they belong to the host.
+ */
+void compact_pack(struct compact_t* dst, const struct machine_t* cpu);
+
+/**
+ * Unpack a compact machine into a machine that can run. The machine gets
+ * no input queue, since a queue feeds a single machine.
+ */
+void compact_unpack(struct machine_t* cpu, const struct compact_t* src,
+        const struct host_t* host);
+
+/**
+ * Hash the state of a compact machine, to tell apart states that behave
+ * differently from now on. The keypad, which is input and not state, and
+ * the clock, which only counts steps, are left out, and the screen counts
+ * through its Zobrist hash.
+ */
+uint64_t compact_hash(const struct compact_t* src);
+
+/**
+ * A pool of compact machines running the same ROM, every one stepped a
+ * frame at a time through a single working machine.
+ */
+struct pool_t;
+
+/**
+ * Create a pool. Every machine starts as a copy of boot; the callbacks and
+ * quirks of boot become the host of the pool. Native code loaded into boot
+ * is bound to boot and is not used: pools run on the interpreter.
+ *
+ * @param n how many machines.
+ * @param boot state every machine starts from.
+ * @param steps how many instructions make a frame.
+ * @param seed machine k is seeded with seed + k.
+ * @return the pool, or NULL if out of memory.
+ */
+struct pool_t* pool_create(int n, const struct machine_t* boot, int steps,
+        uint32_t seed);
+
+/**
+ * Run one frame on every machine: set the keypad, run the instructions of
+ * a frame and tick the timers once, as batch_run_frame.
+ * @param keys n keypad masks, or NULL to keep the keypads as they are.
+ */
+void pool_run_frame(struct pool_t* pool, const word* keys);
+
+/**
+ * Get a compact machine of the pool.
+ */
+struct compact_t* pool_machine(struct pool_t* pool, int k);
+
+/**
+ * Get the host shared by the machines of the pool.
+ */
+struct host_t* pool_host(struct pool_t* pool);
+
+void pool_destroy(struct pool_t* pool);
+
+#endif // COMPACT_H_
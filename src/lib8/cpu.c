@@ -17,6 +17,9 @@
  */
 
 #include "cpu.h"
+#include "analyze.h"
+#include "aot.h"
+#include "input.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -68,29 +71,105 @@ static char hexcodes[] = {
     0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
-static int global_delta;
+/**
+ * Big 8x10 font used by FX30 in extended screen mode. This array should
+ * be memcopied to memory address 0x0A0, right after the small font.
+ */
+static char bigfont[] = {
+    0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+    0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+    0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+    0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+    0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+    0x3E, 0x7C, 0xE0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+    0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C, // 9
+    0x3C, 0x7E, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFE, 0xC3, 0xC3, 0xFE, 0xFE, 0xC3, 0xC3, 0xFE, 0xFC, // B
+    0x3C, 0x7E, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0x7E, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
 
 typedef void (*opcode_table_t) (struct machine_t* cpu, word opcode);
 
+/**
+ * Zobrist key of a pixel. The screen hash is the XOR of the keys of every
+ * lit pixel, so toggling a pixel is just XORing its key into the hash.
+ * Keys are computed with the MurmurHash3 finalizer instead of a table.
+ */
+static uint64_t
+pixel_key(int pos)
+{
+    uint64_t key = pos + 0x9E3779B97F4A7C15ULL;
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+/**
+ * Keep the mirror after the memory up to date after a store. Bytes stored
+ * past the end belong to the beginning of the memory, and stores to the
+ * beginning must show up in the mirror. Loads never need this.
+ */
 static void
-nibble_0(struct machine_t* cpu, word opcode)
+mirror_store(struct machine_t* cpu, address from, int len)
 {
+    if (from + len > MEMSIZ)
+        memcpy(cpu->mem, cpu->mem + MEMSIZ, from + len - MEMSIZ);
+    if (from < MEMGUARD || from + len > MEMSIZ)
+        memcpy(cpu->mem + MEMSIZ, cpu->mem, MEMGUARD);
+}
+
+/* Write a pixel keeping the screen hash up to date. */
+static void
+put_pixel(struct machine_t* cpu, int pos, char value)
+{
+    if ((cpu->screen[pos] != 0) != (value != 0))
+        cpu->screen_key ^= pixel_key(pos);
+    cpu->screen[pos] = value;
+}
+
+/*
+ * Handlers taking quirks or hires arguments are specialized for every
+ * quirk profile and screen resolution by OPCODE_TABLES below. They are
+ * always inlined there, so with both arguments being constants the
+ * compiler folds every check away, including masks and strides.
+ */
+#if defined(__GNUC__)
+#define SPECIALIZED static inline __attribute__((always_inline)) void
+#else
+#define SPECIALIZED static inline void
+#endif
+
+SPECIALIZED
+special_0(struct machine_t* cpu, word opcode, int hires)
+{
+    const int width = hires ? 128 : 64, height = hires ? 64 : 32;
     if ((opcode & 0xFFF0) == 0x00c0)  {
         /* 00CN: SCD - Scroll down. */
-        int rowsiz = cpu->esm ? 128 : 64;
-        int colsiz = cpu->esm ? 64 : 32;
         int n = OPCODE_N(opcode);
-        int start_row = 0, last_row = colsiz - n - 1;
+        int start_row = 0, last_row = height - n - 1;
         for (int row = last_row; row >= start_row; row--) {
-            for (int x = 0; x < rowsiz; x++) {
-                int from = row * rowsiz + x;
-                int to = (row + n) * rowsiz + x;
-                cpu->screen[to] = cpu->screen[from];
+            for (int x = 0; x < width; x++) {
+                int from = row * width + x;
+                int to = (row + n) * width + x;
+                put_pixel(cpu, to, cpu->screen[from]);
             }
         }
     } else if (opcode == 0x00e0) {
         /* 00E0: CLS - Clear the screen. */
-        memset(cpu->screen, 0, 2048);
+        for (int pos = 0; pos < width * height; pos++) {
+            if (cpu->screen[pos])
+                cpu->screen_key ^= pixel_key(pos);
+        }
+        memset(cpu->screen, 0, width * height);
     } else if (opcode == 0x00ee) {
         /* 00EE: RET - Return from subroutine. */
         if (cpu->sp > 0)
@@ -98,26 +177,22 @@ nibble_0(struct machine_t* cpu, word opcode)
         /* TODO: Should throw an error on stack underflow. */
     } else if (opcode == 0x00fb) {
         /* 00FB: SCR - Scroll 4 pixels to the right. */
-        int rowsiz = cpu->esm ? 128 : 64;
-        int colsiz = cpu->esm ? 64 : 32;
-        int start_col = 0, last_col = rowsiz - 4 - 1;
+        int start_col = 0, last_col = width - 4 - 1;
         for (int col = last_col; col >= start_col; col--) {
-            for (int y = 0; y < colsiz; y++) {
-                int from = y * rowsiz + col;
-                int to = y * rowsiz + (4 + col);
-                cpu->screen[to] = cpu->screen[from];
+            for (int y = 0; y < height; y++) {
+                int from = y * width + col;
+                int to = y * width + (4 + col);
+                put_pixel(cpu, to, cpu->screen[from]);
             }
         }
     } else if (opcode == 0x00fc) {
         /* 00FC: SCL - Scroll 4 pixels to the left. */
-        int rowsiz = cpu->esm ? 128 : 64;
-        int colsiz = cpu->esm ? 64 : 32;
-        int start_col = 4, last_col = rowsiz - 1;
+        int start_col = 4, last_col = width - 1;
         for (int col = start_col; col <= last_col; col++) {
-            for (int y = 0; y < colsiz; y++) {
-                int from = y * rowsiz + col;
-                int to = y * rowsiz + (col - 4);
-                cpu->screen[to] = cpu->screen[from];
+            for (int y = 0; y < height; y++) {
+                int from = y * width + col;
+                int to = y * width + (col - 4);
+                put_pixel(cpu, to, cpu->screen[from]);
             }
         }
     } else if (opcode == 0x00fd) {
@@ -125,10 +200,10 @@ nibble_0(struct machine_t* cpu, word opcode)
         cpu->exit = 1;
     } else if (opcode == 0x00fe) {
         /* 00FE: LOW - Disable extended screen mode. */
-        cpu->esm = 0;
+        set_screen_mode(cpu, 0);
     } else if (opcode == 0x00ff) {
         /* 00FF: HIGH - Enable extended scren mode. */
-        cpu->esm = 1;
+        set_screen_mode(cpu, 1);
     }
 }
 
@@ -188,8 +263,8 @@ nibble_7(struct machine_t* cpu, word opcode)
     cpu->v[OPCODE_X(opcode)] += OPCODE_KK(opcode);
 }
 
-static void
-nibble_8(struct machine_t* cpu, word opcode)
+SPECIALIZED
+special_8(struct machine_t* cpu, word opcode, int quirks)
 {
     /* All these opcodes work with X and most of them with Y, worth it. */
     byte x = OPCODE_X(opcode), y = OPCODE_Y(opcode);
@@ -202,14 +277,20 @@ nibble_8(struct machine_t* cpu, word opcode)
     case 1:
         /* 8XY1: OR - Set V[X] |= V[Y]. */
         cpu->v[x] |= cpu->v[y];
+        if (quirks & QUIRK_LOGIC)
+            cpu->v[0xf] = 0;
         break;
     case 2:
         /* 8XY2: AND - Set V[X] &= V[Y]. */
         cpu->v[x] &= cpu->v[y];
+        if (quirks & QUIRK_LOGIC)
+            cpu->v[0xf] = 0;
         break;
     case 3:
         /* 8XY3: XOR - Set V[X] ^= V[Y]. */
         cpu->v[x] ^= cpu->v[y];
+        if (quirks & QUIRK_LOGIC)
+            cpu->v[0xf] = 0;
         break;
     case 4:
         /* 8XY4: ADD - Set V[X] += V[Y], V[15] is carry flag. */
@@ -223,6 +304,8 @@ nibble_8(struct machine_t* cpu, word opcode)
         break;
     case 6:
         /* 8X06: SHR - Shifts right V[X], LSB bit goes to V[15]. */
+        if (quirks & QUIRK_SHIFT)
+            cpu->v[x] = cpu->v[y];
         cpu->v[0xf] = (cpu->v[x] & 1);
         cpu->v[x] >>= 1;
         break;
@@ -233,6 +316,8 @@ nibble_8(struct machine_t* cpu, word opcode)
         break;
     case 0xE:
         /* 8X0E: SHL - Shifts left V[X], MSB bit goes to V[15]. */
+        if (quirks & QUIRK_SHIFT)
+            cpu->v[x] = cpu->v[y];
         cpu->v[0xF] = ((cpu->v[x] & 0x80) != 0);
         cpu->v[x] <<= 1;
         break;
@@ -254,27 +339,32 @@ nibble_A(struct machine_t* cpu, word opcode)
     cpu->i = OPCODE_NNN(opcode);
 }
 
-static void
-nibble_B(struct machine_t* cpu, word opcode)
+SPECIALIZED
+special_B(struct machine_t* cpu, word opcode, int quirks)
 {
     /* BNNN: JP - Jump to memory address (V[0] + NNN). */
-    cpu->pc = (cpu->v[0] + OPCODE_NNN(opcode)) & 0xFFF;
+    int reg = (quirks & QUIRK_JUMP) ? OPCODE_X(opcode) : 0;
+    cpu->pc = (cpu->v[reg] + OPCODE_NNN(opcode)) & 0xFFF;
 }
 
 static void
 nibble_C(struct machine_t* cpu, word opcode)
 {
     /* CXKK: RND - Put a random value, bitmasked against KK in V[X]. */
-    cpu->v[OPCODE_X(opcode)] = rand() & OPCODE_KK(opcode);
+    cpu->rng ^= cpu->rng << 13;
+    cpu->rng ^= cpu->rng >> 17;
+    cpu->rng ^= cpu->rng << 5;
+    cpu->v[OPCODE_X(opcode)] = (cpu->rng >> 8) & OPCODE_KK(opcode);
 }
 
-static void
-nibble_D(struct machine_t* cpu, word opcode)
+SPECIALIZED
+special_D(struct machine_t* cpu, word opcode, int quirks, int hires)
 {
     /* DXYN: DRW - Draw a sprite on the screen at location V[X], V[Y]. */
+    const int width = hires ? 128 : 64, height = hires ? 64 : 32;
     byte x = OPCODE_X(opcode), y = OPCODE_Y(opcode);
     cpu->v[15] = 0;
-    if (cpu->esm && OPCODE_N(opcode) == 0) {
+    if (hires && OPCODE_N(opcode) == 0) {
         for (int j = 0; j < 16; j++) {
             // Sprite to plot on this line.
             byte hi = cpu->mem[cpu->i + 2 * j];
@@ -282,47 +372,68 @@ nibble_D(struct machine_t* cpu, word opcode)
             word sprite = hi << 8 | lo;
             for (int i = 0; i < 16; i++) {
                 // Where to plot at.
-                int px = (cpu->v[x] + i) & 127;
-                int py = (cpu->v[y] + j) & 63;
-                int pos = 128 * py + px;
+                int px = (cpu->v[x] & (width - 1)) + i;
+                int py = (cpu->v[y] & (height - 1)) + j;
+                if ((quirks & QUIRK_CLIP) && (px >= width || py >= height))
+                    continue;
+                px &= width - 1;
+                py &= height - 1;
+                int pos = width * py + px;
                 // What to plot.
                 int pixel = (sprite & (1 << (15-i))) != 0;
                 cpu->v[15] |= (cpu->screen[pos] & pixel);
                 cpu->screen[pos] ^= pixel;
+                if (pixel)
+                    cpu->screen_key ^= pixel_key(pos);
             }
         }
     } else for (int j = 0; j < OPCODE_N(opcode); j++) {
         byte sprite = cpu->mem[cpu->i + j];
         for (int i = 0; i < 8; i++) {
             // Where to plot at.
-            int px = (cpu->v[x] + i) & (cpu->esm ? 127 : 63);
-            int py = (cpu->v[y] + j) & (cpu->esm ? 63 : 31);
-            int pos = (cpu->esm ? 128 : 64) * py + px;
+            int px = (cpu->v[x] & (width - 1)) + i;
+            int py = (cpu->v[y] & (height - 1)) + j;
+            if ((quirks & QUIRK_CLIP) && (px >= width || py >= height))
+                continue;
+            px &= width - 1;
+            py &= height - 1;
+            int pos = width * py + px;
             // What to plot.
             int pixel = (sprite & (1 << (7-i))) != 0;
             cpu->v[15] |= (cpu->screen[pos] & pixel);
             cpu->screen[pos] ^= pixel;
+            if (pixel)
+                cpu->screen_key ^= pixel_key(pos);
         }
     }
 }
 
+/* Is a key down? Asks the poller or, if there is none, the keypad. */
+static int
+is_key_down(struct machine_t* cpu, char key)
+{
+    if (cpu->keydown)
+        return cpu->keydown(key);
+    return (cpu->keypad >> key) & 1;
+}
+
 static void
 nibble_E(struct machine_t* cpu, word opcode)
 {
     char key = cpu->v[OPCODE_X(opcode)];
     if (OPCODE_KK(opcode) == 0x9E) {
         /* EX9E: SKP - Skip next instruction if key V[X] is down. */
-        if (cpu->keydown && cpu->keydown(key & 0xF))
+        if (is_key_down(cpu, key & 0xF))
             cpu->pc = (cpu->pc + 2) & 0xFFF;
     } else if (OPCODE_KK(opcode) == 0xA1) {
         /* EXA1: SKNP - Skip next instruction if key V[X] is not down. */
-        if (cpu->keydown && !cpu->keydown(key & 0xF))
+        if (!is_key_down(cpu, key & 0xF))
             cpu->pc = (cpu->pc + 2) & 0xFFF;
     }
 }
 
-static void
-nibble_F(struct machine_t* cpu, word opcode)
+SPECIALIZED
+special_F(struct machine_t* cpu, word opcode, int quirks)
 {
     switch (OPCODE_KK(opcode)) {
     case 0x07:
@@ -343,7 +454,7 @@ nibble_F(struct machine_t* cpu, word opcode)
         break;
     case 0x1E:
         /* FX1E: ADD - Add V[X] to I. */
-        cpu->i += cpu->v[OPCODE_X(opcode)];
+        cpu->i = (cpu->i + cpu->v[OPCODE_X(opcode)]) & ADDRESS_MASK;
         break;
     case 0x29:
         /* FX29: LD - Set I to the address location for the sprite. */
@@ -351,37 +462,45 @@ nibble_F(struct machine_t* cpu, word opcode)
         break;
     case 0x30:
         /* FX30: LD H, F - Load a 10 byte font glyph. */
-        cpu->i = 0x8200 + (cpu->v[OPCODE_X(opcode)] & 0xF) * 10;
+        cpu->i = 0xA0 + (cpu->v[OPCODE_X(opcode)] & 0xF) * 10;
         break;
     case 0x33:
         /* FX33: Represent V[X] as BCD in I, I+1, I+2. */
         cpu->mem[cpu->i + 2] = cpu->v[OPCODE_X(opcode)] % 10;
         cpu->mem[cpu->i + 1] = (cpu->v[OPCODE_X(opcode)] / 10) % 10;
         cpu->mem[cpu->i] = cpu->v[OPCODE_X(opcode)] / 100;
+        mirror_store(cpu, cpu->i, 3);
+        if (cpu->aot)
+            aot_invalidate(cpu, cpu->i, 3);
         break;
     case 0x55:
         /* FX55: LD - Save registers V[0] to V[x] starting at I. */
         for (int reg = 0; reg <= OPCODE_X(opcode); reg++) {
             cpu->mem[cpu->i + reg] = cpu->v[reg];
         }
+        mirror_store(cpu, cpu->i, OPCODE_X(opcode) + 1);
+        if (cpu->aot)
+            aot_invalidate(cpu, cpu->i, OPCODE_X(opcode) + 1);
+        if (quirks & QUIRK_MEMORY)
+            cpu->i = (cpu->i + OPCODE_X(opcode) + 1) & ADDRESS_MASK;
         break;
     case 0x65:
         /* FX65: LD - Load registers V[0] to V[x] from I. */
         for (int reg = 0; reg <= OPCODE_X(opcode); reg++) {
             cpu->v[reg] = cpu->mem[cpu->i + reg];
         }
+        if (quirks & QUIRK_MEMORY)
+            cpu->i = (cpu->i + OPCODE_X(opcode) + 1) & ADDRESS_MASK;
         break;
     case 0x75:
         /* FX75: LD R, V - Store V[0]..V[X] in R registers. */
-        // FIXME: Should check that X <= 7.
-        for (int reg = 0; reg <= OPCODE_X(opcode); reg++) {
+        for (int reg = 0; reg <= OPCODE_X(opcode) && reg < 8; reg++) {
             cpu->r[reg] = cpu->v[reg];
         }
         break;
     case 0x85:
         /* FX85: LD V, R - Load V[0]..V[X] in R registers. */
-        // FIXME: Should check that X <= 7.
-        for (int reg = 0; reg <= OPCODE_X(opcode); reg++) {
+        for (int reg = 0; reg <= OPCODE_X(opcode) && reg < 8; reg++) {
             cpu->v[reg] = cpu->r[reg];
         }
         break;
@@ -389,95 +508,467 @@ nibble_F(struct machine_t* cpu, word opcode)
 }
 
 /**
- * This is the handler table. There are 16 handlers in the following array,
- * each one covering a subset of the opcodes for the CHIP-8. During opcode
- * fetching, the most significant nibble (most significant hex char) is taken
- * out as a value in range [0, 15]. The handler from this array whose index
- * matches the value of that nibble is executed. The handler should execute
- * opcodes starting by that value.
+ * These are the handler tables, one for every quirk profile and screen
+ * resolution, so that switching modes just switches tables. There are 16
+ * handlers in every table, each one covering a subset of the opcodes for
+ * the CHIP-8. During opcode fetching, the most significant nibble (most
+ * significant hex char) is taken out as a value in range [0, 15]. The
+ * handler from the table whose index matches the value of that nibble is
+ * executed. The handler should execute opcodes starting by that value.
  */
-static opcode_table_t nibbles[16] = {
-    &nibble_0, &nibble_1, &nibble_2, &nibble_3,
-    &nibble_4, &nibble_5, &nibble_6, &nibble_7,
-    &nibble_8, &nibble_9, &nibble_A, &nibble_B,
-    &nibble_C, &nibble_D, &nibble_E, &nibble_F
+struct opcodes_t
+{
+    opcode_table_t nibbles[16];
+    const struct opcodes_t* lores;  // Table to switch to on 00FE.
+    const struct opcodes_t* hires;  // Table to switch to on 00FF.
 };
 
+#define OPCODE_TABLE(name, quirks, hires, lores_name, hires_name) \
+    static void name##_0(struct machine_t* cpu, word opcode) \
+    { special_0(cpu, opcode, hires); } \
+    static void name##_8(struct machine_t* cpu, word opcode) \
+    { special_8(cpu, opcode, quirks); } \
+    static void name##_B(struct machine_t* cpu, word opcode) \
+    { special_B(cpu, opcode, quirks); } \
+    static void name##_D(struct machine_t* cpu, word opcode) \
+    { special_D(cpu, opcode, quirks, hires); } \
+    static void name##_F(struct machine_t* cpu, word opcode) \
+    { special_F(cpu, opcode, quirks); } \
+    static const struct opcodes_t name = { { \
+        &name##_0, &nibble_1, &nibble_2, &nibble_3, \
+        &nibble_4, &nibble_5, &nibble_6, &nibble_7, \
+        &name##_8, &nibble_9, &nibble_A, &name##_B, \
+        &nibble_C, &name##_D, &nibble_E, &name##_F \
+    }, &lores_name, &hires_name }
+
+/* A low and a high resolution table for a quirk profile. */
+#define OPCODE_TABLES(name, quirks) \
+    static const struct opcodes_t name##_lores, name##_hires; \
+    OPCODE_TABLE(name##_lores, quirks, 0, name##_lores, name##_hires); \
+    OPCODE_TABLE(name##_hires, quirks, 1, name##_lores, name##_hires)
+
+OPCODE_TABLES(ops_default, QUIRKS_DEFAULT);
+OPCODE_TABLES(ops_chip8, QUIRKS_CHIP8);
+OPCODE_TABLES(ops_schip, QUIRKS_SCHIP);
+OPCODE_TABLES(ops_xochip, QUIRKS_XOCHIP);
+
+static const struct {
+    const char* name;
+    int quirks;
+    const struct opcodes_t* ops;
+} profiles[] = {
+    { "default", QUIRKS_DEFAULT, &ops_default_lores },
+    { "chip8", QUIRKS_CHIP8, &ops_chip8_lores },
+    { "schip", QUIRKS_SCHIP, &ops_schip_lores },
+    { "xochip", QUIRKS_XOCHIP, &ops_xochip_lores },
+};
+
+#define PROFILES (int) (sizeof(profiles) / sizeof(profiles[0]))
+
+int
+set_quirks(struct machine_t* cpu, int quirks)
+{
+    for (int k = 0; k < PROFILES; k++) {
+        if (profiles[k].quirks == quirks) {
+            cpu->quirks = quirks;
+            cpu->ops = cpu->esm ? profiles[k].ops->hires : profiles[k].ops;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void
+set_screen_mode(struct machine_t* cpu, int esm)
+{
+    cpu->esm = esm != 0;
+    cpu->ops = esm ? cpu->ops->hires : cpu->ops->lores;
+}
+
+int
+quirks_by_name(const char* name)
+{
+    for (int k = 0; k < PROFILES; k++) {
+        if (strcmp(profiles[k].name, name) == 0)
+            return profiles[k].quirks;
+    }
+    return -1;
+}
+
 void
 init_machine(struct machine_t* machine)
 {
     memset(machine, 0x00, sizeof(struct machine_t));
     memcpy(machine->mem + 0x50, hexcodes, 80);
+    memcpy(machine->mem + 0xA0, bigfont, 160);
     machine->pc = 0x200;
     machine->wait_key = -1;
-    global_delta = 0;
+    set_quirks(machine, QUIRKS_DEFAULT);
+    seed_machine(machine, 0);
     log("Debug mode is enabled");
     log("Machine has been initialized");
 }
 
-void
-step_machine(struct machine_t* cpu)
+/**
+ * Are we waiting for a key press? A key that is down ends the wait of
+ * FX0A and is stored in its register.
+ * @return != 0 if the machine is still waiting.
+ */
+static int
+is_waiting(struct machine_t* cpu)
+{
+    if (cpu->wait_key == -1)
+        return 0;
+    for (int i = 0; i < 16; i++) {
+        if (is_key_down(cpu, i)) {
+            /* Key was down. Restore system. */
+            cpu->v[(int) cpu->wait_key] = i;
+            cpu->wait_key = -1;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Fetch and execute one instruction, without counting it in the clock. */
+static void
+step_instruction(struct machine_t* cpu)
 {
     if (cpu->exit)
         return;
 
-    /* Are we waiting for a key press? */
-    if (cpu->wait_key != -1 && cpu->keydown) {
-        for (int i = 0; i < 16; i++) {
-            int status = cpu->keydown(i);
-            if (status) {
-                /* Key was down. Restore system. */
-                cpu->v[(int) cpu->wait_key] = i;
-                cpu->wait_key = -1;
-                break;
-            }
-        }
-        /* Test again. If we are still waiting for a key, don't fetch. */
-        if (cpu->wait_key != -1) {
-            return;
-        }
-    }
-    
+    /* If we are still waiting for a key, don't fetch. */
+    if (is_waiting(cpu))
+        return;
+
     /* Fetch next opcode. */
     word opcode = (cpu->mem[cpu->pc] << 8) | cpu->mem[cpu->pc + 1];
     cpu->pc = (cpu->pc + 2) & 0xFFF;
 
     if (is_debug) {
         printf("Executing opcode 0x%x...\n", opcode);
+        address at = (cpu->pc - 2) & 0xFFF;
+        if (cpu->analysis && !(cpu->analysis->map[at] & AN_CODE)) {
+            printf("MESSAGE: 0x%03x is not code according to analysis\n", at);
+        }
     }
 
     /* Execute the corresponding handler from the nibble table. */
-    nibbles[OPCODE_P(opcode)](cpu, opcode);
+    cpu->ops->nibbles[OPCODE_P(opcode)](cpu, opcode);
+}
+
+/**
+ * Superinstructions. A few opcode pairs are so common in game loops that
+ * they are decoded together and run with a single dispatch: coordinate
+ * setup (6XKK 6YKK), drawing (ANNN DXYN), conditional branches (skip and
+ * 1NNN) and loop counters (7XKK 3YKK). The PC must point past the first
+ * opcode of the pair.
+ * @return how many instructions were run, 0 if this is not a known pair.
+ * Conditional branches whose skip is taken count as one instruction.
+ */
+static int
+fused_step(struct machine_t* cpu, word first)
+{
+    address at = cpu->pc;
+    word second = (cpu->mem[at] << 8) | cpu->mem[at + 1];
+    address next = (at + 2) & 0xFFF;
+    int taken;
+
+    switch (OPCODE_P(first)) {
+    case 0x3:
+        taken = cpu->v[OPCODE_X(first)] == OPCODE_KK(first);
+        break;
+    case 0x4:
+        taken = cpu->v[OPCODE_X(first)] != OPCODE_KK(first);
+        break;
+    case 0x5:
+        taken = cpu->v[OPCODE_X(first)] == cpu->v[OPCODE_Y(first)];
+        break;
+    case 0x9:
+        taken = cpu->v[OPCODE_X(first)] != cpu->v[OPCODE_Y(first)];
+        break;
+    case 0x6:
+        if (OPCODE_P(second) != 0x6)
+            return 0;
+        cpu->v[OPCODE_X(first)] = OPCODE_KK(first);
+        cpu->v[OPCODE_X(second)] = OPCODE_KK(second);
+        cpu->pc = next;
+        return 2;
+    case 0x7:
+        if (OPCODE_P(second) != 0x3)
+            return 0;
+        cpu->v[OPCODE_X(first)] += OPCODE_KK(first);
+        cpu->pc = next;
+        if (cpu->v[OPCODE_X(second)] == OPCODE_KK(second))
+            cpu->pc = (next + 2) & 0xFFF;
+        return 2;
+    case 0xA:
+        if (OPCODE_P(second) != 0xD)
+            return 0;
+        cpu->i = OPCODE_NNN(first);
+        cpu->pc = next;
+        cpu->ops->nibbles[0xD](cpu, second);
+        return 2;
+    default:
+        return 0;
+    }
+
+    /* Conditional branch: the skip either jumps over the 1NNN or not. */
+    if (OPCODE_P(second) != 0x1)
+        return 0;
+    if (taken) {
+        cpu->pc = next;
+        return 1;
+    }
+    cpu->pc = OPCODE_NNN(second);
+    return 2;
 }
 
 void
-update_time(struct machine_t* cpu, int delta)
+step_machine(struct machine_t* cpu)
 {
-    global_delta += delta;
-    while (global_delta > (1000 / 60)) {
-        global_delta -= (1000 / 60);
-        if (cpu->dt > 0) {
-            cpu->dt--;
+    if (cpu->input)
+        input_apply(cpu->input, cpu, 1);
+    step_instruction(cpu);
+    cpu->clock++;
+}
+
+/* Run steps with no key event due in between. */
+static void
+run_steps(struct machine_t* cpu, int steps)
+{
+    while (steps > 0) {
+        /* Waiting for keys and logging opcodes are left to step_instruction. */
+        if (cpu->wait_key != -1 || cpu->exit || is_debug) {
+            step_instruction(cpu);
+            steps--;
+            continue;
         }
-        if (cpu->st > 0) {
-            if (--cpu->st == 0 && cpu->speaker) {
-                /* Disable speaker buzz. */
-                cpu->speaker(0);
-            } else if (cpu->speaker) {
-                /* Enable speaker buzz. */
-                cpu->speaker(1);
+        if (cpu->aot) {
+            int left = aot_run(cpu, steps);
+            if (left != steps) {
+                steps = left;
+                continue;
             }
         }
+
+        word opcode = (cpu->mem[cpu->pc] << 8) | cpu->mem[cpu->pc + 1];
+        cpu->pc = (cpu->pc + 2) & 0xFFF;
+        int done = steps >= 2 ? fused_step(cpu, opcode) : 0;
+        if (done == 0) {
+            cpu->ops->nibbles[OPCODE_P(opcode)](cpu, opcode);
+            done = 1;
+        }
+        steps -= done;
+    }
+}
+
+void
+run_machine(struct machine_t* cpu, int steps)
+{
+    while (steps > 0) {
+        int chunk = cpu->input ? input_apply(cpu->input, cpu, steps) : steps;
+        run_steps(cpu, chunk);
+        cpu->clock += chunk;
+        steps -= chunk;
+    }
+}
+
+void
+run_frames(struct machine_t* cpu, int frames, int steps)
+{
+    for (int frame = 0; frame < frames; frame++) {
+        run_machine(cpu, steps);
+        tick_timers(cpu);
+    }
+}
+
+/*
+ * COSMAC VIP instruction costs, in machine cycles. Every instruction pays
+ * VIP_FETCH_CYCLES for the fetch and the dispatch through the interpreter
+ * jump table, then for its own routine. These are approximations of the
+ * VIP interpreter: what matters is that cheap and expensive instructions
+ * keep their ratio. SCHIP and XO-CHIP instructions, which the VIP did
+ * not have, cost like the nearest VIP routine.
+ */
+#define VIP_SKIP_CYCLES 4
+#define VIP_CLEAR_CYCLES (24 + 6 * 256)
+
+static const short vip_nibble_cycles[16] = {
+    0, 12, 26, 10, 10, 14, 6, 10, 44, 14, 12, 22, 36, 26, 18, 0
+};
+
+/* Nibbles of the conditional skips. */
+static const char vip_skips[16] = {
+    0, 0, 0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0
+};
+
+int
+vip_cycles(const struct machine_t* cpu, word opcode)
+{
+    int x = OPCODE_X(opcode);
+    int cycles = VIP_FETCH_CYCLES + vip_nibble_cycles[OPCODE_P(opcode)];
+
+    switch (OPCODE_P(opcode)) {
+    case 0x0:
+        if (opcode == 0x00E0 || opcode == 0x00FB || opcode == 0x00FC
+                || (opcode & 0xFFF0) == 0x00C0) {
+            /* Clear and scrolls rewrite the whole display memory. */
+            return cycles + VIP_CLEAR_CYCLES;
+        }
+        if ((opcode & 0xFF00) == 0x0000)
+            return cycles + 10;
+        /* 0NNN calls a machine code routine. */
+        return cycles + 26;
+    case 0xD: {
+        /* Every sprite row is shifted into place bit by bit. */
+        int rows = OPCODE_N(opcode) ? OPCODE_N(opcode) : 32;
+        return cycles + rows * (30 + 6 * (cpu->v[x] & 7));
+    }
+    case 0xF:
+        switch (OPCODE_KK(opcode)) {
+        case 0x1E:
+        case 0x0A:
+            return cycles + 14;
+        case 0x29:
+        case 0x30:
+            return cycles + 16;
+        case 0x33: {
+            /* BCD is done by repeated subtraction, one loop per unit. */
+            int v = cpu->v[x];
+            return cycles + 36 + 8 * (v / 100 + v / 10 % 10 + v % 10);
+        }
+        case 0x55:
+        case 0x65:
+        case 0x75:
+        case 0x85:
+            return cycles + 14 + 14 * (x + 1);
+        default:
+            return cycles + 10;
+        }
+    default:
+        return cycles;
+    }
+}
+
+int
+run_vip_frame(struct machine_t* cpu, int vblank)
+{
+    int budget = VIP_FRAME_CYCLES - VIP_DISPLAY_CYCLES - cpu->cycles;
+    int count = 0;
+
+    while (budget > 0) {
+        if (cpu->input)
+            input_apply(cpu->input, cpu, 1);
+        if (cpu->exit) {
+            budget = 0;
+            break;
+        }
+
+        /* FX0A keeps polling the keypad until a key is down. */
+        cpu->clock++;
+        if (is_waiting(cpu)) {
+            budget -= VIP_FETCH_CYCLES;
+            continue;
+        }
+
+        address at = cpu->pc;
+        word opcode = (cpu->mem[at] << 8) | cpu->mem[at + 1];
+        cpu->pc = (at + 2) & 0xFFF;
+        budget -= vip_cycles(cpu, opcode);
+        cpu->ops->nibbles[OPCODE_P(opcode)](cpu, opcode);
+        if (vip_skips[OPCODE_P(opcode)] && cpu->pc == ((at + 4) & 0xFFF))
+            budget -= VIP_SKIP_CYCLES;
+        count++;
+
+        /* The VIP draws right after the display interrupt. */
+        if (vblank && OPCODE_P(opcode) == 0xD) {
+            budget = 0;
+            break;
+        }
+    }
+    cpu->cycles = -budget;
+    return count;
+}
+
+int
+timing_by_name(const char* name)
+{
+    if (strcmp(name, "fixed") == 0)
+        return TIMING_FIXED;
+    if (strcmp(name, "vip") == 0)
+        return TIMING_VIP;
+    if (strcmp(name, "vip-vblank") == 0)
+        return TIMING_VIP_VBLANK;
+    return -1;
+}
+
+void
+snapshot_machine(struct machine_t* dst, const struct machine_t* src)
+{
+    keyboard_poller_t keydown = dst->keydown;
+    speaker_handler_t speaker = dst->speaker;
+    const struct analysis_t* analysis = dst->analysis;
+    struct aot_t* aot = dst->aot;
+    struct input_queue_t* input = dst->input;
+
+    memcpy(dst, src, sizeof(struct machine_t));
+    dst->keydown = keydown;
+    dst->input = input;
+    dst->speaker = speaker;
+    dst->analysis = analysis;
+    dst->aot = aot;
+}
+
+void
+execute_opcode(struct machine_t* cpu, word opcode)
+{
+    cpu->ops->nibbles[OPCODE_P(opcode)](cpu, opcode);
+}
+
+void
+update_time(struct machine_t* cpu, int delta)
+{
+    cpu->delta += delta;
+    while (cpu->delta > (1000 / 60)) {
+        cpu->delta -= (1000 / 60);
+        tick_timers(cpu);
+    }
+}
+
+void
+tick_timers(struct machine_t* cpu)
+{
+    if (cpu->dt > 0) {
+        cpu->dt--;
+    }
+    if (cpu->st > 0) {
+        if (--cpu->st == 0 && cpu->speaker) {
+            /* Disable speaker buzz. */
+            cpu->speaker(0);
+        } else if (cpu->speaker) {
+            /* Enable speaker buzz. */
+            cpu->speaker(1);
+        }
     }
 }
 
+void
+seed_machine(struct machine_t* cpu, uint32_t seed)
+{
+    /* xorshift32 must never be zero. */
+    cpu->rng = seed ^ 0x9E3779B9;
+    if (cpu->rng == 0)
+        cpu->rng = 0x9E3779B9;
+}
+
 void
 screen_fill_column(struct machine_t* cpu, int column)
 {
     int rowsiz = cpu->esm ? 128 : 64;
     int limit = cpu->esm ? 64 : 32;
     for (int y = 0; y < limit; y++) {
-        cpu->screen[rowsiz * y + column] = 1;
+        put_pixel(cpu, rowsiz * y + column, 1);
     }
 }
 
@@ -487,7 +978,7 @@ screen_clear_column(struct machine_t* cpu, int column)
     int rowsiz = cpu->esm ? 128 : 64;
     int limit = cpu->esm ? 64 : 32;
     for (int y = 0; y < limit; y++) {
-        cpu->screen[rowsiz * y + column] = 0;
+        put_pixel(cpu, rowsiz * y + column, 0);
     }
 }
 
@@ -497,7 +988,7 @@ screen_fill_row(struct machine_t* cpu, int row)
     int limit = cpu->esm ? 128 : 64;
     int rowsiz = limit;
     for (int x = 0; x < limit; x++) {
-        cpu->screen[rowsiz * row + x] = 1;
+        put_pixel(cpu, rowsiz * row + x, 1);
     }
 }
 
@@ -507,7 +998,7 @@ screen_clear_row(struct machine_t* cpu, int row)
     int limit = cpu->esm ? 128 : 64;
     int rowsiz = limit;
     for (int x = 0; x < limit; x++) {
-        cpu->screen[rowsiz * row + x] = 0;
+        put_pixel(cpu, rowsiz * row + x, 0);
     }
 }
 
@@ -522,12 +1013,28 @@ void
 screen_set_pixel(struct machine_t* cpu, int row, int column)
 {
     int rowsiz = cpu->esm ? 128 : 64;
-    cpu->screen[rowsiz * row + column] = 1;
+    put_pixel(cpu, rowsiz * row + column, 1);
 }
 
 void
 screen_clear_pixel(struct machine_t* cpu, int row, int column)
 {
     int rowsiz = cpu->esm ? 128 : 64;
-    cpu->screen[rowsiz * row + column] = 0;
+    put_pixel(cpu, rowsiz * row + column, 0);
+}
+
+uint64_t
+screen_hash(const struct machine_t* cpu)
+{
+    return cpu->screen_key;
+}
+
+void
+screen_rehash(struct machine_t* cpu)
+{
+    cpu->screen_key = 0;
+    for (int pos = 0; pos < (int) sizeof(cpu->screen); pos++) {
+        if (cpu->screen[pos])
+            cpu->screen_key ^= pixel_key(pos);
+    }
 }
@@ -23,6 +23,14 @@
 
 #define MEMSIZ 4096 // How much memory can handle the CHIP-8
 
+/**
+ * Bytes after the memory that mirror its first bytes. No instruction
+ * reaches further than I + 31 or PC + 1, so with I and PC kept below
+ * MEMSIZ every access made by a ROM lands in the memory or in the mirror
+ * and wraps around without masking or checking the address.
+ */
+#define MEMGUARD 32
+
 /**
  * Type definition for a byte value. Bytes are unsigned 8-bit variables.
  * They are widely used on the CHIP-8 since the memory and registers are
@@ -57,13 +65,35 @@ typedef int (*keyboard_poller_t)(char);
 
 typedef void (*speaker_handler_t)(int);
 
+struct analysis_t;
+
+struct aot_t;
+
+struct input_queue_t;
+
+struct opcodes_t;
+
+/*
+ * Quirks. ROMs written for different CHIP-8 implementations expect some
+ * opcodes to behave differently. A quirk profile is a set of these flags.
+ */
+#define QUIRK_SHIFT 0x01    // 8XY6 and 8XYE shift V[Y] into V[X].
+#define QUIRK_MEMORY 0x02   // FX55 and FX65 leave I past the last register.
+#define QUIRK_JUMP 0x04     // BXNN jumps to V[X] + XNN instead of V[0] + NNN.
+#define QUIRK_CLIP 0x08     // Sprites are clipped at the edges, not wrapped.
+#define QUIRK_LOGIC 0x10    // 8XY1, 8XY2 and 8XY3 reset V[F].
+
+#define QUIRKS_DEFAULT 0
+#define QUIRKS_CHIP8 (QUIRK_SHIFT | QUIRK_MEMORY | QUIRK_CLIP | QUIRK_LOGIC)
+#define QUIRKS_SCHIP (QUIRK_JUMP | QUIRK_CLIP)
+#define QUIRKS_XOCHIP (QUIRK_SHIFT | QUIRK_MEMORY)
+
 /**
  * Main data structure for holding information and state about processor.
  * Memory, stack, and register set is all defined here.
  */
 struct machine_t
 {
-    byte mem[MEMSIZ];         // Memory is allocated as a buffer
     address pc;                // Program Counter
 
     address stack[16];          // Stack can hold 16 16-bit values
@@ -74,14 +104,34 @@ struct machine_t
     byte dt, st;             // Timers
 
     char screen[8192];          // Screen bitmap
+    uint64_t screen_key;        // Zobrist hash of the screen bitmap.
     char wait_key;              // Key the CHIP-8 is idle waiting for.
 
     keyboard_poller_t keydown; // Keyboard poller
     speaker_handler_t speaker; // Speaker handler
+    word keypad;                // Keys down, used when there is no poller.
+    struct input_queue_t* input; // Key events applied to keypad, if any.
+    uint64_t clock;             // Instructions run, the time of key events.
+    uint32_t rng;               // State of the random number generator.
+    int delta;                  // Milliseconds not yet applied to timers.
+    int cycles;                 // VIP cycles run past the last frame budget.
 
     int exit;                   // Should close the game.
-    int esm;                    // Is in Extended Screen Mode? 
+    int esm;                    // Is in Extended Screen Mode? See set_screen_mode.
     byte r[8];                  // R register set.
+
+    const struct analysis_t* analysis; // Static analysis of the ROM, if any.
+    struct aot_t* aot;          // Native code for the ROM, if any.
+
+    int quirks;                 // Quirk profile, set with set_quirks.
+    const struct opcodes_t* ops; // Handlers specialized for the quirks.
+
+    /*
+     * Memory is allocated as a buffer, followed by the mirror. It is the
+     * last field so that guard_create can put a guard page right after.
+     * Code writing to the first MEMGUARD bytes must update the mirror.
+     */
+    byte mem[MEMSIZ + MEMGUARD];
 };
 
 /**
@@ -94,6 +144,31 @@ struct machine_t
  */
 void init_machine(struct machine_t* cpu);
 
+/**
+ * Select the quirk profile of a machine. Every profile has its own opcode
+ * handlers, generated at compile time, so quirks are never checked while
+ * running. init_machine selects QUIRKS_DEFAULT.
+ * @param cpu reference pointer to the machine.
+ * @param quirks one of the QUIRKS_* profiles.
+ * @return 0 on success, != 0 if there is no such profile.
+ */
+int set_quirks(struct machine_t* cpu, int quirks);
+
+/**
+ * Switch between the low and the high resolution screen modes, as 00FE
+ * and 00FF do. Draw, scroll and clear are specialized for every mode, so
+ * the esm field must not be written directly while the machine runs.
+ * @param cpu reference pointer to the machine.
+ * @param esm != 0 for the 128x64 extended screen mode.
+ */
+void set_screen_mode(struct machine_t* cpu, int esm);
+
+/**
+ * Look up a quirk profile by name: default, chip8, schip or xochip.
+ * @return the profile, or -1 if the name is unknown.
+ */
+int quirks_by_name(const char* name);
+
 /**
  * Step the machine. This method will fetch an instruction from memory
  * and execute it. After invoking this method, the state of the provided
@@ -102,6 +177,91 @@ void init_machine(struct machine_t* cpu);
  */
 void step_machine(struct machine_t* cpu);
 
+/**
+ * Run the machine for a number of steps. This is the same as calling
+ * step_machine that many times, but native code loaded with aot_load is
+ * used whenever it is available for the current PC, and common opcode
+ * pairs are run as a single superinstruction. Steps are split wherever a
+ * key event of cpu->input is due, so events land on the same instruction
+ * as with step_machine.
+ * @param cpu reference pointer to the machine to run.
+ * @param steps how many instructions to execute.
+ */
+void run_machine(struct machine_t* cpu, int steps);
+
+/**
+ * Run the machine for a number of frames, each one made of some steps
+ * followed by a tick of the timers.
+ * @param cpu reference pointer to the machine to run.
+ * @param frames how many frames to run.
+ * @param steps how many instructions make a frame.
+ */
+void run_frames(struct machine_t* cpu, int frames, int steps);
+
+/**
+ * Machine cycles of a COSMAC VIP frame: the 1802 runs at 1.76 MHz, 8 clock
+ * pulses per machine cycle, and the display interrupt comes 60 times per
+ * second. Part of every frame goes to the display DMA and the interrupt
+ * routine and is not available to the interpreter.
+ */
+#define VIP_FRAME_CYCLES 3668
+#define VIP_DISPLAY_CYCLES 1100
+
+/* Cycles of the interpreter fetch loop, also spent by every FX0A poll. */
+#define VIP_FETCH_CYCLES 68
+
+#define TIMING_FIXED 0      // A fixed amount of instructions per frame.
+#define TIMING_VIP 1        // The cycle budget of the COSMAC VIP.
+#define TIMING_VIP_VBLANK 2 // The same, and DXYN waits for vblank.
+
+/**
+ * Run the machine for one frame with the timing of the original COSMAC VIP
+ * interpreter. Every instruction costs the machine cycles that the VIP
+ * spends on it, which depend on the opcode and on its operands, and the
+ * frame runs as many instructions as fit in its cycle budget. Cycles run
+ * past the budget are taken from the next frame. Native code and
+ * superinstructions are not used, because they would not be costed. The
+ * timers are not ticked.
+ * @param cpu reference pointer to the machine to run.
+ * @param vblank != 0 to end the frame after DXYN, as the VIP waits for
+ *     the next display interrupt before drawing a sprite.
+ * @return how many instructions were run.
+ */
+int run_vip_frame(struct machine_t* cpu, int vblank);
+
+/**
+ * Look up a timing model by name: fixed, vip or vip-vblank.
+ * @return one of the TIMING_* models, or -1 if the name is unknown.
+ */
+int timing_by_name(const char* name);
+
+/**
+ * Machine cycles the COSMAC VIP interpreter takes to run an opcode on the
+ * current state of a machine, fetch and decode included. Skips that are
+ * taken cost a few cycles more, which run_vip_frame adds once it knows.
+ * @param cpu reference pointer to the machine, not modified.
+ * @param opcode instruction about to be executed.
+ */
+int vip_cycles(const struct machine_t* cpu, word opcode);
+
+/**
+ * Copy the state of a machine into another, to take a snapshot of it or
+ * to restore one. The bindings of the destination, that is its keyboard
+ * poller, input queue, speaker, analysis and native code, are kept: native code is
+ * bound to a single machine and cannot be shared with a snapshot.
+ * @param dst machine to copy the state to.
+ * @param src machine to copy the state from.
+ */
+void snapshot_machine(struct machine_t* dst, const struct machine_t* src);
+
+/**
+ * Execute a single opcode as if it had been fetched from memory. The PC
+ * must already point to the next instruction.
+ * @param cpu reference pointer to the machine.
+ * @param opcode instruction to execute.
+ */
+void execute_opcode(struct machine_t* cpu, word opcode);
+
 /**
  * Updates subsystems that depend on time. Several parts of the CHIP-8
  * depend on a timer. Examples are the DT and ST countdown registers, whose
@@ -111,6 +271,21 @@ void step_machine(struct machine_t* cpu);
  */
 void update_time(struct machine_t* cpu, int delta);
 
+/**
+ * Count down the DT and ST registers once, as it happens 60 times per
+ * second. Useful when time is measured in frames instead of milliseconds.
+ * @param cpu reference pointer to the machine.
+ */
+void tick_timers(struct machine_t* cpu);
+
+/**
+ * Seed the random number generator used by CXKK. Every machine has its
+ * own generator, so two machines seeded the same way behave the same.
+ * @param cpu reference pointer to the machine.
+ * @param seed any value.
+ */
+void seed_machine(struct machine_t* cpu, uint32_t seed);
+
 void screen_fill_column(struct machine_t* cpu, int column);
 
 void screen_clear_column(struct machine_t* cpu, int column);
@@ -125,6 +300,21 @@ void screen_set_pixel(struct machine_t* cpu, int row, int column);
 
 void screen_clear_pixel(struct machine_t* cpu, int row, int column);
 
+/**
+ * Fingerprint of the screen bitmap. It is kept up to date by every
+ * instruction and screen_* function that touches pixels, so getting it
+ * is O(1). Equal screens always have the same hash.
+ * @param cpu reference pointer to the machine.
+ */
+uint64_t screen_hash(const struct machine_t* cpu);
+
+/**
+ * Recompute the screen hash from scratch. Must be called after writing to
+ * the screen bitmap directly instead of using the screen_* functions.
+ * @param cpu reference pointer to the machine.
+ */
+void screen_rehash(struct machine_t* cpu);
+
 void set_debug_mode(int mode);
 
 #endif // CPU_H_
@@ -0,0 +1,489 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "explore.h"
+#include "compact.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct stateset_t
+{
+    uint64_t* slots;            // 0 is an empty slot.
+    uint64_t mask;              // Slots - 1, slots being a power of two.
+    long count;                 // Hashes inserted.
+    long limit;                 // Hashes allowed, to keep probes short.
+};
+
+struct stateset_t*
+stateset_create(long capacity)
+{
+    struct stateset_t* set = malloc(sizeof(struct stateset_t));
+    if (set == NULL)
+        return NULL;
+    uint64_t slots = 1024;
+    while (slots < 2 * (uint64_t) capacity)
+        slots *= 2;
+    set->slots = calloc(slots, sizeof(uint64_t));
+    if (set->slots == NULL) {
+        free(set);
+        return NULL;
+    }
+    set->mask = slots - 1;
+    set->count = 0;
+    set->limit = slots / 4 * 3;
+    return set;
+}
+
+int
+stateset_insert(struct stateset_t* set, uint64_t hash)
+{
+    hash += hash == 0;
+    for (uint64_t k = hash & set->mask;; k = (k + 1) & set->mask) {
+        uint64_t slot = __atomic_load_n(&set->slots[k], __ATOMIC_RELAXED);
+        if (slot == hash)
+            return 0;
+        if (slot != 0)
+            continue;
+        if (__atomic_fetch_add(&set->count, 1, __ATOMIC_RELAXED) >= set->limit) {
+            __atomic_fetch_sub(&set->count, 1, __ATOMIC_RELAXED);
+            return -1;
+        }
+        if (__atomic_compare_exchange_n(&set->slots[k], &slot, hash, 0,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            return 1;
+        /* Another thread took the slot first, maybe with the same hash. */
+        __atomic_fetch_sub(&set->count, 1, __ATOMIC_RELAXED);
+        if (slot == hash)
+            return 0;
+    }
+}
+
+void
+stateset_destroy(struct stateset_t* set)
+{
+    free(set->slots);
+    free(set);
+}
+
+/* A state reached, kept to rebuild the path to the goal. */
+struct node_t
+{
+    int parent;                 // Node it was reached from, or -1.
+    word keys;                  // Keypad held to reach it.
+    word depth;                 // Decisions taken to reach it.
+};
+
+/* A state waiting to be expanded. */
+struct open_t
+{
+    int node;
+    long score;
+    struct compact_t* state;
+};
+
+struct search_t
+{
+    const struct explore_config_t* config;
+    struct host_t host;         // Shared by every state.
+    struct stateset_t* seen;    // Hashes of the states reached.
+    struct node_t* nodes;       // max_states nodes.
+    long count;                 // Nodes taken.
+    int goal;                   // Node that met the goal, or -1.
+    int stop;                   // Set on goal, full or out of memory.
+    int failed;                 // Ran out of memory.
+    long expanded;
+    long duplicates;
+
+    /* Breadth first: the level being expanded. */
+    struct open_t* level;
+    long nlevel;
+    long next;                  // Next state of the level to take.
+
+    /* Best first: a binary heap of the best states, under the lock. */
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    struct open_t* heap;
+    long nheap, capheap;
+    int active;                 // Threads expanding a state.
+    int done;
+};
+
+struct worker_t
+{
+    struct search_t* search;
+    struct machine_t cpu;       // States are run here.
+    struct open_t* out;         // Children found by the last expansion.
+    long nout, capout;
+    pthread_t thread;
+};
+
+static struct compact_t*
+alloc_state(void)
+{
+    void* state;
+    if (posix_memalign(&state, 64, sizeof(struct compact_t)))
+        return NULL;
+    return state;
+}
+
+static void
+stop(struct search_t* search, int failed)
+{
+    if (failed)
+        __atomic_store_n(&search->failed, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&search->stop, 1, __ATOMIC_RELEASE);
+}
+
+static int
+stopped(struct search_t* search)
+{
+    return __atomic_load_n(&search->stop, __ATOMIC_ACQUIRE);
+}
+
+/* Keep a child to expand later. */
+static int
+push_out(struct worker_t* w, int node, long score, struct compact_t* state)
+{
+    if (w->nout == w->capout) {
+        long cap = w->capout ? 2 * w->capout : 64;
+        struct open_t* out = realloc(w->out, cap * sizeof(struct open_t));
+        if (out == NULL)
+            return 1;
+        w->out = out;
+        w->capout = cap;
+    }
+    w->out[w->nout].node = node;
+    w->out[w->nout].score = score;
+    w->out[w->nout].state = state;
+    w->nout++;
+    return 0;
+}
+
+/*
+ * Try every choice from a state. New states become nodes and go to the
+ * output of the worker, unless they met the goal or cannot go further.
+ */
+static void
+expand(struct worker_t* w, struct open_t* open)
+{
+    struct search_t* search = w->search;
+    const struct explore_config_t* config = search->config;
+    int depth = search->nodes[open->node].depth + 1;
+    struct compact_t* child = NULL;
+
+    for (int c = 0; c < config->nchoices && !stopped(search); c++) {
+        compact_unpack(&w->cpu, open->state, &search->host);
+        w->cpu.keypad = config->choices[c];
+        run_frames(&w->cpu, config->frames, config->steps);
+
+        if (child == NULL && (child = alloc_state()) == NULL) {
+            stop(search, 1);
+            break;
+        }
+        compact_pack(child, &w->cpu);
+        int fresh = stateset_insert(search->seen, compact_hash(child));
+        if (fresh == 0) {
+            __atomic_fetch_add(&search->duplicates, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        long id = fresh > 0
+            ? __atomic_fetch_add(&search->count, 1, __ATOMIC_RELAXED) : 0;
+        if (fresh < 0 || id >= config->max_states) {
+            stop(search, 0);
+            break;
+        }
+        search->nodes[id].parent = open->node;
+        search->nodes[id].keys = config->choices[c];
+        search->nodes[id].depth = depth;
+
+        if (expr_eval(config->goal, &w->cpu)) {
+            int none = -1;
+            __atomic_compare_exchange_n(&search->goal, &none, (int) id, 0,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+            stop(search, 0);
+            break;
+        }
+        if (w->cpu.exit || depth >= config->max_depth)
+            continue;
+        long score = config->score ? expr_eval(config->score, &w->cpu) : 0;
+        if (push_out(w, id, score, child)) {
+            stop(search, 1);
+            break;
+        }
+        child = NULL;
+    }
+    free(child);
+    free(open->state);
+    open->state = NULL;
+    __atomic_fetch_add(&search->expanded, 1, __ATOMIC_RELAXED);
+}
+
+static void*
+bfs_worker(void* data)
+{
+    struct worker_t* w = data;
+    struct search_t* search = w->search;
+    while (!stopped(search)) {
+        long k = __atomic_fetch_add(&search->next, 1, __ATOMIC_RELAXED);
+        if (k >= search->nlevel)
+            break;
+        expand(w, &search->level[k]);
+    }
+    return NULL;
+}
+
+/* Is a better than b? Higher scores first, then fewer decisions. */
+static int
+better(const struct search_t* search, const struct open_t* a,
+        const struct open_t* b)
+{
+    if (a->score != b->score)
+        return a->score > b->score;
+    return search->nodes[a->node].depth < search->nodes[b->node].depth;
+}
+
+static int
+heap_push(struct search_t* search, const struct open_t* open)
+{
+    if (search->nheap == search->capheap) {
+        long cap = search->capheap ? 2 * search->capheap : 1024;
+        struct open_t* heap = realloc(search->heap, cap * sizeof(struct open_t));
+        if (heap == NULL)
+            return 1;
+        search->heap = heap;
+        search->capheap = cap;
+    }
+    long k = search->nheap++;
+    while (k > 0 && better(search, open, &search->heap[(k - 1) / 2])) {
+        search->heap[k] = search->heap[(k - 1) / 2];
+        k = (k - 1) / 2;
+    }
+    search->heap[k] = *open;
+    return 0;
+}
+
+static struct open_t
+heap_pop(struct search_t* search)
+{
+    struct open_t top = search->heap[0];
+    struct open_t last = search->heap[--search->nheap];
+    long k = 0, n = search->nheap;
+    for (;;) {
+        long child = 2 * k + 1;
+        if (child >= n)
+            break;
+        if (child + 1 < n
+                && better(search, &search->heap[child + 1], &search->heap[child]))
+            child++;
+        if (!better(search, &search->heap[child], &last))
+            break;
+        search->heap[k] = search->heap[child];
+        k = child;
+    }
+    if (n > 0)
+        search->heap[k] = last;
+    return top;
+}
+
+static void*
+best_worker(void* data)
+{
+    struct worker_t* w = data;
+    struct search_t* search = w->search;
+    pthread_mutex_lock(&search->lock);
+    for (;;) {
+        while (!search->done && search->nheap == 0 && search->active > 0)
+            pthread_cond_wait(&search->wake, &search->lock);
+        if (search->done || search->nheap == 0) {
+            search->done = 1;
+            pthread_cond_broadcast(&search->wake);
+            break;
+        }
+        struct open_t open = heap_pop(search);
+        search->active++;
+        pthread_mutex_unlock(&search->lock);
+
+        expand(w, &open);
+
+        pthread_mutex_lock(&search->lock);
+        search->active--;
+        for (long k = 0; k < w->nout; k++) {
+            if (heap_push(search, &w->out[k])) {
+                free(w->out[k].state);
+                stop(search, 1);
+            }
+        }
+        w->nout = 0;
+        if (stopped(search))
+            search->done = 1;
+        pthread_cond_broadcast(&search->wake);
+    }
+    pthread_mutex_unlock(&search->lock);
+    return NULL;
+}
+
+/* Run a worker on every thread, this one included, until they are done. */
+static void
+run_workers(struct worker_t* workers, int threads, void* (*work)(void*))
+{
+    int started = 1;
+    while (started < threads && pthread_create(&workers[started].thread,
+                NULL, work, &workers[started]) == 0)
+        started++;
+    work(&workers[0]);
+    for (int k = 1; k < started; k++)
+        pthread_join(workers[k].thread, NULL);
+}
+
+static void
+search_bfs(struct search_t* search, struct worker_t* workers, int threads,
+        struct open_t root)
+{
+    search->level = malloc(sizeof(struct open_t));
+    if (search->level == NULL) {
+        free(root.state);
+        stop(search, 1);
+        return;
+    }
+    search->level[0] = root;
+    search->nlevel = 1;
+
+    while (search->nlevel > 0 && !stopped(search)) {
+        search->next = 0;
+        run_workers(workers, threads, bfs_worker);
+
+        /* States left when the search stopped halfway are never taken. */
+        long taken = search->next < search->nlevel ? search->next : search->nlevel;
+        for (long k = taken; k < search->nlevel; k++)
+            free(search->level[k].state);
+
+        long total = 0;
+        for (int t = 0; t < threads; t++)
+            total += workers[t].nout;
+        free(search->level);
+        search->nlevel = 0;
+        search->level = malloc((total ? total : 1) * sizeof(struct open_t));
+        for (int t = 0; t < threads; t++) {
+            if (workers[t].nout == 0)
+                continue;
+            if (search->level) {
+                memcpy(search->level + search->nlevel, workers[t].out,
+                        workers[t].nout * sizeof(struct open_t));
+                search->nlevel += workers[t].nout;
+            } else {
+                for (long k = 0; k < workers[t].nout; k++)
+                    free(workers[t].out[k].state);
+                stop(search, 1);
+            }
+            workers[t].nout = 0;
+        }
+    }
+    for (long k = 0; k < search->nlevel; k++)
+        free(search->level[k].state);
+    free(search->level);
+}
+
+static void
+search_best(struct search_t* search, struct worker_t* workers, int threads,
+        struct open_t root)
+{
+    pthread_mutex_init(&search->lock, NULL);
+    pthread_cond_init(&search->wake, NULL);
+    if (heap_push(search, &root)) {
+        free(root.state);
+        stop(search, 1);
+    } else {
+        run_workers(workers, threads, best_worker);
+    }
+    for (long k = 0; k < search->nheap; k++)
+        free(search->heap[k].state);
+    free(search->heap);
+    pthread_cond_destroy(&search->wake);
+    pthread_mutex_destroy(&search->lock);
+}
+
+int
+explore_run(const struct machine_t* boot,
+        const struct explore_config_t* config, word* path,
+        struct explore_result_t* result)
+{
+    struct search_t search;
+    memset(&search, 0, sizeof(search));
+    search.config = config;
+    search.goal = -1;
+    search.host.quirks = boot->quirks;
+    search.host.analysis = boot->analysis;
+
+    int threads = config->threads > 0 ? config->threads : 1;
+    struct worker_t* workers = calloc(threads, sizeof(struct worker_t));
+    search.seen = stateset_create(config->max_states);
+    search.nodes = malloc(config->max_states * sizeof(struct node_t));
+    struct open_t root = { 0, 0, alloc_state() };
+    if (workers == NULL || search.seen == NULL || search.nodes == NULL
+            || root.state == NULL || config->max_states < 1) {
+        free(root.state);
+        free(search.nodes);
+        if (search.seen)
+            stateset_destroy(search.seen);
+        free(workers);
+        return 1;
+    }
+    for (int t = 0; t < threads; t++) {
+        workers[t].search = &search;
+        init_machine(&workers[t].cpu);
+    }
+
+    /* The boot state is node 0, and may already meet the goal. */
+    compact_pack(root.state, boot);
+    stateset_insert(search.seen, compact_hash(root.state));
+    search.nodes[0].parent = -1;
+    search.nodes[0].keys = 0;
+    search.nodes[0].depth = 0;
+    search.count = 1;
+    compact_unpack(&workers[0].cpu, root.state, &search.host);
+    if (expr_eval(config->goal, &workers[0].cpu)) {
+        search.goal = 0;
+        free(root.state);
+    } else if (config->order == EXPLORE_BEST) {
+        search_best(&search, workers, threads, root);
+    } else {
+        search_bfs(&search, workers, threads, root);
+    }
+
+    result->found = search.goal >= 0;
+    result->depth = 0;
+    if (search.goal >= 0) {
+        result->depth = search.nodes[search.goal].depth;
+        for (int node = search.goal; node > 0; node = search.nodes[node].parent)
+            path[search.nodes[node].depth - 1] = search.nodes[node].keys;
+    }
+    result->states = search.count < config->max_states
+        ? search.count : config->max_states;
+    result->expanded = search.expanded;
+    result->duplicates = search.duplicates;
+
+    for (int t = 0; t < threads; t++)
+        free(workers[t].out);
+    free(workers);
+    free(search.nodes);
+    stateset_destroy(search.seen);
+    return search.failed;
+}
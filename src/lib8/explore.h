@@ -0,0 +1,100 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXPLORE_H_
+#define EXPLORE_H_
+
+#include "cpu.h"
+#include "expr.h"
+
+#include <stddef.h>
+
+/**
+ * Set of 64-bit state hashes shared by many threads. It is an open
+ * addressing table filled with compare and swap, so threads never lock
+ * and a hash is only ever inserted once.
+ */
+struct stateset_t;
+
+/**
+ * Create a set.
+ * @param capacity how many hashes it must hold; the table is larger.
+ * @return the set, or NULL if out of memory.
+ */
+struct stateset_t* stateset_create(long capacity);
+
+/**
+ * Insert a hash. Safe to call from any thread.
+ * @return 1 if it was not in the set, 0 if it was, -1 if the set is full.
+ */
+int stateset_insert(struct stateset_t* set, uint64_t hash);
+
+void stateset_destroy(struct stateset_t* set);
+
+/* Search orders. */
+#define EXPLORE_BFS 0           // Breadth first: the shortest solution.
+#define EXPLORE_BEST 1          // Highest score first: a solution, soon.
+
+/**
+ * What to search for and how.
+ */
+struct explore_config_t
+{
+    int order;                  // EXPLORE_BFS or EXPLORE_BEST.
+    int threads;                // Threads searching, at least 1.
+    int frames;                 // Frames the keys of a decision are held.
+    int steps;                  // Instructions per frame.
+    const word* choices;        // Keypads tried at every decision.
+    int nchoices;
+    const struct expr_t* goal;  // The search ends when it is not 0.
+    const struct expr_t* score; // Ranks states for EXPLORE_BEST.
+    long max_states;            // Distinct states kept, at most.
+    int max_depth;              // Decisions, at most.
+};
+
+struct explore_result_t
+{
+    int found;                  // Was a goal state reached?
+    int depth;                  // Decisions taken to reach it.
+    long states;                // Distinct states reached.
+    long expanded;              // States whose choices were all tried.
+    long duplicates;            // States pruned as already reached.
+};
+
+/**
+ * Explore the states a ROM can reach. From every state, each keypad of
+ * the choices is held for some frames, which gives a new state. States
+ * are packed as compact machines, and states already reached, as told by
+ * compact_hash, are pruned. Threads take states to expand from a shared
+ * frontier: a whole level at a time for EXPLORE_BFS, or the best ones
+ * from a shared heap for EXPLORE_BEST.
+ *
+ * Only the states waiting to be expanded are kept, about 5 KB each, plus
+ * a few bytes per state reached to rebuild the path to the goal.
+ *
+ * @param boot state to start from, usually one that has just loaded a ROM.
+ *     Its keyboard poller, speaker and native code are not used.
+ * @param path max_depth entries, receive the keypad of every decision
+ *     taken to reach the goal.
+ * @return 0 when the search is over, found or not, != 0 if out of memory.
+ */
+int explore_run(const struct machine_t* boot,
+        const struct explore_config_t* config, word* path,
+        struct explore_result_t* result);
+
+#endif // EXPLORE_H_
@@ -0,0 +1,314 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "expr.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Longest program, deepest stack and deepest nesting of an expression. */
+#define EXPR_CODE 256
+#define EXPR_STACK 32
+#define EXPR_NESTING 64
+
+/* Instructions of the stack program. */
+enum {
+    OP_PUSH, OP_V, OP_MEM, OP_PC, OP_I, OP_SP, OP_DT, OP_ST, OP_ESM,
+    OP_EXIT, OP_NOT, OP_NEG, OP_OR, OP_AND, OP_BOR, OP_BAND, OP_EQ, OP_NE,
+    OP_LT, OP_LE, OP_GT, OP_GE, OP_ADD, OP_SUB, OP_MUL
+};
+
+struct insn_t
+{
+    int op;
+    long value;                 // Pushed by OP_PUSH.
+};
+
+struct expr_t
+{
+    int length;
+    struct insn_t code[EXPR_CODE];
+};
+
+/* Binary operators, by precedence level, the lowest first. */
+struct binary_t
+{
+    int level;
+    const char* token;
+    int op;
+};
+
+static const struct binary_t binaries[] = {
+    { 0, "||", OP_OR }, { 1, "&&", OP_AND }, { 2, "|", OP_BOR },
+    { 3, "&", OP_BAND }, { 4, "==", OP_EQ }, { 4, "!=", OP_NE },
+    { 5, "<=", OP_LE }, { 5, ">=", OP_GE }, { 5, "<", OP_LT },
+    { 5, ">", OP_GT }, { 6, "+", OP_ADD }, { 6, "-", OP_SUB },
+    { 7, "*", OP_MUL }
+};
+
+#define LEVELS 8
+
+/* Registers read by name. */
+struct name_t
+{
+    const char* name;
+    int op;
+};
+
+static const struct name_t names[] = {
+    { "pc", OP_PC }, { "i", OP_I }, { "sp", OP_SP }, { "dt", OP_DT },
+    { "st", OP_ST }, { "esm", OP_ESM }, { "exit", OP_EXIT }
+};
+
+struct parser_t
+{
+    const char* text;
+    const char* at;
+    int depth;                  // Stack depth after the code so far.
+    int nesting;                // Unary operators and brackets open.
+    int error;
+    struct expr_t* expr;
+};
+
+static void
+skip_spaces(struct parser_t* p)
+{
+    while (isspace((unsigned char) *p->at))
+        p->at++;
+}
+
+/* Take a token if it comes next. */
+static int
+accept(struct parser_t* p, const char* token)
+{
+    skip_spaces(p);
+    size_t len = strlen(token);
+    if (strncmp(p->at, token, len))
+        return 0;
+    /* || and && must not be taken as | and &. */
+    if (len == 1 && (*token == '|' || *token == '&') && p->at[1] == *token)
+        return 0;
+    p->at += len;
+    return 1;
+}
+
+static void
+emit(struct parser_t* p, int op, long value)
+{
+    if (p->expr->length == EXPR_CODE) {
+        p->error = 1;
+        return;
+    }
+    p->expr->code[p->expr->length].op = op;
+    p->expr->code[p->expr->length].value = value;
+    p->expr->length++;
+
+    /* Reads and unary operators keep the depth, binaries pop one. */
+    if (op == OP_PUSH || (op >= OP_PC && op <= OP_EXIT))
+        p->depth++;
+    else if (op >= OP_OR)
+        p->depth--;
+    if (p->depth > EXPR_STACK)
+        p->error = 1;
+}
+
+static void parse_level(struct parser_t* p, int level);
+static void parse_unary(struct parser_t* p);
+
+static void
+parse_index(struct parser_t* p, int op)
+{
+    if (!accept(p, "[")) {
+        p->error = 1;
+        return;
+    }
+    parse_level(p, 0);
+    if (!accept(p, "]"))
+        p->error = 1;
+    emit(p, op, 0);
+}
+
+static void
+parse_operand(struct parser_t* p)
+{
+    if (accept(p, "!")) {
+        parse_unary(p);
+        emit(p, OP_NOT, 0);
+        return;
+    }
+    if (accept(p, "-")) {
+        parse_unary(p);
+        emit(p, OP_NEG, 0);
+        return;
+    }
+    if (accept(p, "(")) {
+        parse_level(p, 0);
+        if (!accept(p, ")"))
+            p->error = 1;
+        return;
+    }
+
+    skip_spaces(p);
+    if (isdigit((unsigned char) *p->at)) {
+        char* end;
+        emit(p, OP_PUSH, strtol(p->at, &end, 0));
+        p->at = end;
+        return;
+    }
+
+    const char* start = p->at;
+    while (isalnum((unsigned char) *p->at))
+        p->at++;
+    size_t len = p->at - start;
+    if (len == 3 && strncmp(start, "mem", 3) == 0) {
+        parse_index(p, OP_MEM);
+        return;
+    }
+    if (len == 1 && (*start == 'v' || *start == 'V')) {
+        parse_index(p, OP_V);
+        return;
+    }
+    if (len == 2 && (*start == 'v' || *start == 'V')
+            && isxdigit((unsigned char) start[1])) {
+        emit(p, OP_PUSH, strtol(start + 1, NULL, 16));
+        emit(p, OP_V, 0);
+        return;
+    }
+    for (size_t k = 0; k < sizeof(names) / sizeof(names[0]); k++) {
+        if (strlen(names[k].name) == len
+                && strncmp(start, names[k].name, len) == 0) {
+            emit(p, names[k].op, 0);
+            return;
+        }
+    }
+    p->at = start;
+    p->error = 1;
+}
+
+/* Every nested operand goes through here, so the recursion is bounded. */
+static void
+parse_unary(struct parser_t* p)
+{
+    if (p->error)
+        return;
+    if (p->nesting == EXPR_NESTING) {
+        p->error = 1;
+        return;
+    }
+    p->nesting++;
+    parse_operand(p);
+    p->nesting--;
+}
+
+static void
+parse_level(struct parser_t* p, int level)
+{
+    if (level == LEVELS) {
+        parse_unary(p);
+        return;
+    }
+    parse_level(p, level + 1);
+    while (!p->error) {
+        int op = -1;
+        for (size_t k = 0; k < sizeof(binaries) / sizeof(binaries[0]); k++) {
+            if (binaries[k].level == level && accept(p, binaries[k].token)) {
+                op = binaries[k].op;
+                break;
+            }
+        }
+        if (op == -1)
+            return;
+        parse_level(p, level + 1);
+        emit(p, op, 0);
+    }
+}
+
+struct expr_t*
+expr_parse(const char* text, size_t* offset)
+{
+    struct parser_t p;
+    p.text = p.at = text;
+    p.depth = 0;
+    p.nesting = 0;
+    p.error = 0;
+    p.expr = malloc(sizeof(struct expr_t));
+    if (p.expr == NULL)
+        return NULL;
+    p.expr->length = 0;
+
+    parse_level(&p, 0);
+    skip_spaces(&p);
+    if (p.error || *p.at) {
+        if (offset)
+            *offset = p.at - p.text;
+        free(p.expr);
+        return NULL;
+    }
+    return p.expr;
+}
+
+long
+expr_eval(const struct expr_t* expr, const struct machine_t* cpu)
+{
+    long stack[EXPR_STACK];
+    int top = 0;
+    for (int k = 0; k < expr->length; k++) {
+        const struct insn_t* insn = &expr->code[k];
+        long b = top > 0 ? stack[top - 1] : 0;
+        long a = top > 1 ? stack[top - 2] : 0;
+        switch (insn->op) {
+            case OP_PUSH: stack[top++] = insn->value; break;
+            case OP_V: stack[top - 1] = cpu->v[b & 0xF]; break;
+            case OP_MEM: stack[top - 1] = cpu->mem[b & ADDRESS_MASK]; break;
+            case OP_PC: stack[top++] = cpu->pc; break;
+            case OP_I: stack[top++] = cpu->i; break;
+            case OP_SP: stack[top++] = cpu->sp; break;
+            case OP_DT: stack[top++] = cpu->dt; break;
+            case OP_ST: stack[top++] = cpu->st; break;
+            case OP_ESM: stack[top++] = cpu->esm; break;
+            case OP_EXIT: stack[top++] = cpu->exit != 0; break;
+            case OP_NOT: stack[top - 1] = !b; break;
+            case OP_NEG: stack[top - 1] = -(unsigned long) b; break;
+            default:
+                switch (insn->op) {
+                    case OP_OR: a = a || b; break;
+                    case OP_AND: a = a && b; break;
+                    case OP_BOR: a = a | b; break;
+                    case OP_BAND: a = a & b; break;
+                    case OP_EQ: a = a == b; break;
+                    case OP_NE: a = a != b; break;
+                    case OP_LT: a = a < b; break;
+                    case OP_LE: a = a <= b; break;
+                    case OP_GT: a = a > b; break;
+                    case OP_GE: a = a >= b; break;
+                    /* Wrap around instead of overflowing. */
+                    case OP_ADD: a = (unsigned long) a + b; break;
+                    case OP_SUB: a = (unsigned long) a - b; break;
+                    case OP_MUL: a = (unsigned long) a * b; break;
+                }
+                stack[--top - 1] = a;
+        }
+    }
+    return top ? stack[top - 1] : 0;
+}
+
+void
+expr_free(struct expr_t* expr)
+{
+    free(expr);
+}
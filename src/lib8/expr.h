@@ -0,0 +1,57 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXPR_H_
+#define EXPR_H_
+
+#include "cpu.h"
+
+#include <stddef.h>
+
+/**
+ * Expressions over the state of a machine, such as goals and scores for
+ * searches. They use C syntax and integer arithmetic:
+ *
+ *   mem[0x3F0] >= 10 && v[3] == 7
+ *
+ * Values are numbers (decimal or 0x hex), v[X] or v0-vf, mem[ADDR], pc,
+ * i, sp, dt, st, esm and exit. Operators are, from lowest precedence:
+ * ||, &&, |, &, == !=, < <= > >=, + -, * and the unary ! and -. A goal
+ * is met when its expression is not 0.
+ *
+ * Expressions are compiled into a small stack program, so evaluating one
+ * takes no parsing and no allocations.
+ */
+struct expr_t;
+
+/**
+ * Compile an expression.
+ * @param offset if not NULL, receives the offset in text of the error.
+ * @return the expression, or NULL on a syntax error, including one too
+ *     long or too deeply nested, or out of memory.
+ */
+struct expr_t* expr_parse(const char* text, size_t* offset);
+
+/**
+ * Evaluate an expression on a machine.
+ */
+long expr_eval(const struct expr_t* expr, const struct machine_t* cpu);
+
+void expr_free(struct expr_t* expr);
+
+#endif // EXPR_H_
@@ -0,0 +1,67 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "guard.h"
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* Pages for the machine and its guard page. */
+static size_t
+mapping_size(size_t page)
+{
+    return (sizeof(struct machine_t) + page - 1) / page * page + page;
+}
+
+struct machine_t*
+guard_create(void)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = mapping_size(page);
+    byte* base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        return NULL;
+    byte* guard = base + size - page;
+    if (mprotect(guard, page, PROT_NONE)) {
+        munmap(base, size);
+        return NULL;
+    }
+
+    /*
+     * The structure ends at the guard page. Since the memory is its last
+     * field, only padding, if any, sits between them.
+     */
+    struct machine_t* cpu = (struct machine_t*) (guard - sizeof(struct machine_t));
+    init_machine(cpu);
+    return cpu;
+}
+
+void
+guard_destroy(struct machine_t* cpu)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = mapping_size(page);
+    byte* guard = (byte*) cpu + sizeof(struct machine_t);
+    munmap(guard + page - size, size);
+}
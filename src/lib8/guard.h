@@ -0,0 +1,44 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GUARD_H_
+#define GUARD_H_
+
+#include "cpu.h"
+
+/**
+ * Machines with a guard page. The memory of a machine is the last field of
+ * the structure; guard_create places the machine so that the memory and
+ * its mirror end right where an inaccessible page starts. Any access that
+ * gets past the mirror faults at once instead of silently corrupting
+ * whatever comes next. Meant for tests and for running untrusted ROMs
+ * while looking for bugs; regular machines can live anywhere.
+ */
+
+/**
+ * Allocate and initialize a machine followed by a guard page.
+ * @return the machine, or NULL if it cannot be allocated.
+ */
+struct machine_t* guard_create(void);
+
+/**
+ * Release a machine allocated with guard_create.
+ */
+void guard_destroy(struct machine_t* cpu);
+
+#endif // GUARD_H_
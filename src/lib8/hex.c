@@ -0,0 +1,193 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hex.h"
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/* Character classes used by the scalar decoder. */
+#define HEXC_INVALID 0x00
+#define HEXC_DIGIT 0x10     // Low nibble holds the digit value.
+#define HEXC_SPACE 0x20
+#define HEXC_COMMENT 0x40
+
+/**
+ * Lookup table that classifies every possible input character. Hex digits
+ * map to HEXC_DIGIT | value, so the scalar decoder needs a single load to
+ * both validate and convert a character.
+ */
+static const byte hex_class[256] = {
+    ['0'] = HEXC_DIGIT | 0x0, ['1'] = HEXC_DIGIT | 0x1,
+    ['2'] = HEXC_DIGIT | 0x2, ['3'] = HEXC_DIGIT | 0x3,
+    ['4'] = HEXC_DIGIT | 0x4, ['5'] = HEXC_DIGIT | 0x5,
+    ['6'] = HEXC_DIGIT | 0x6, ['7'] = HEXC_DIGIT | 0x7,
+    ['8'] = HEXC_DIGIT | 0x8, ['9'] = HEXC_DIGIT | 0x9,
+    ['A'] = HEXC_DIGIT | 0xA, ['B'] = HEXC_DIGIT | 0xB,
+    ['C'] = HEXC_DIGIT | 0xC, ['D'] = HEXC_DIGIT | 0xD,
+    ['E'] = HEXC_DIGIT | 0xE, ['F'] = HEXC_DIGIT | 0xF,
+    ['a'] = HEXC_DIGIT | 0xA, ['b'] = HEXC_DIGIT | 0xB,
+    ['c'] = HEXC_DIGIT | 0xC, ['d'] = HEXC_DIGIT | 0xD,
+    ['e'] = HEXC_DIGIT | 0xE, ['f'] = HEXC_DIGIT | 0xF,
+    [' '] = HEXC_SPACE, ['\t'] = HEXC_SPACE, ['\n'] = HEXC_SPACE,
+    ['\r'] = HEXC_SPACE, ['\v'] = HEXC_SPACE, ['\f'] = HEXC_SPACE,
+    ['#'] = HEXC_COMMENT
+};
+
+#if defined(__AVX2__)
+
+#define HEX_BLOCK 32
+
+/**
+ * Decode the longest even run of hex digits at the start of a 32 character
+ * block. Characters are validated with range compares; the nibble value is
+ * (c & 0xF), plus 9 for letters. Pairs are then merged inside each 16-bit
+ * lane and packed down to bytes.
+ *
+ * @param src block of HEX_BLOCK characters.
+ * @param out buffer with room for HEX_BLOCK / 2 bytes.
+ * @return amount of characters consumed, always even.
+ */
+static int
+hex_block(const char* src, byte* out)
+{
+    __m256i c = _mm256_loadu_si256((const __m256i*) src);
+    __m256i lc = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+    __m256i digit = _mm256_and_si256(
+            _mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+    __m256i alpha = _mm256_and_si256(
+            _mm256_cmpgt_epi8(lc, _mm256_set1_epi8('a' - 1)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lc));
+    unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(digit, alpha));
+    int count = (mask == 0xFFFFFFFFu) ? 32 : __builtin_ctz(~mask);
+    count &= ~1;
+    if (count == 0)
+        return 0;
+
+    __m256i val = _mm256_add_epi8(
+            _mm256_and_si256(c, _mm256_set1_epi8(0x0F)),
+            _mm256_and_si256(alpha, _mm256_set1_epi8(9)));
+    __m256i pair = _mm256_or_si256(
+            _mm256_slli_epi16(_mm256_and_si256(val, _mm256_set1_epi16(0xFF)), 4),
+            _mm256_srli_epi16(val, 8));
+    __m256i packed = _mm256_packus_epi16(pair, pair);
+    packed = _mm256_permute4x64_epi64(packed, 0x08);
+    _mm_storeu_si128((__m128i*) out, _mm256_castsi256_si128(packed));
+    return count;
+}
+
+#elif defined(__SSE2__)
+
+#define HEX_BLOCK 16
+
+/**
+ * Decode the longest even run of hex digits at the start of a 16 character
+ * block. Same algorithm as the AVX2 version, half the width.
+ *
+ * @param src block of HEX_BLOCK characters.
+ * @param out buffer with room for HEX_BLOCK / 2 bytes.
+ * @return amount of characters consumed, always even.
+ */
+static int
+hex_block(const char* src, byte* out)
+{
+    __m128i c = _mm_loadu_si128((const __m128i*) src);
+    __m128i lc = _mm_or_si128(c, _mm_set1_epi8(0x20));
+    __m128i digit = _mm_and_si128(
+            _mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+            _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+    __m128i alpha = _mm_and_si128(
+            _mm_cmpgt_epi8(lc, _mm_set1_epi8('a' - 1)),
+            _mm_cmplt_epi8(lc, _mm_set1_epi8('f' + 1)));
+    unsigned mask = _mm_movemask_epi8(_mm_or_si128(digit, alpha));
+    int count = (mask == 0xFFFF) ? 16 : __builtin_ctz(~mask);
+    count &= ~1;
+    if (count == 0)
+        return 0;
+
+    __m128i val = _mm_add_epi8(
+            _mm_and_si128(c, _mm_set1_epi8(0x0F)),
+            _mm_and_si128(alpha, _mm_set1_epi8(9)));
+    __m128i pair = _mm_or_si128(
+            _mm_slli_epi16(_mm_and_si128(val, _mm_set1_epi16(0xFF)), 4),
+            _mm_srli_epi16(val, 8));
+    _mm_storel_epi64((__m128i*) out, _mm_packus_epi16(pair, pair));
+    return count;
+}
+
+#endif
+
+int
+hex_decode(const char* src, size_t len, byte* dst, size_t dstsiz,
+        size_t* written, size_t* offset)
+{
+    size_t pos = 0, out = 0, hi_pos = 0;
+    int hi = -1, status = HEX_OK;
+
+    while (pos < len) {
+#ifdef HEX_BLOCK
+        /* Bulk path: only at byte boundaries and with room to spare. */
+        if (hi < 0 && len - pos >= HEX_BLOCK && dstsiz - out >= HEX_BLOCK / 2) {
+            byte block[HEX_BLOCK / 2];
+            int count = hex_block(src + pos, block);
+            if (count > 0) {
+                memcpy(dst + out, block, count / 2);
+                out += count / 2;
+                pos += count;
+                continue;
+            }
+        }
+#endif
+        byte cls = hex_class[(unsigned char) src[pos]];
+        if (cls & HEXC_DIGIT) {
+            if (hi < 0) {
+                hi = cls & 0xF;
+                hi_pos = pos;
+            } else if (out < dstsiz) {
+                dst[out++] = hi << 4 | (cls & 0xF);
+                hi = -1;
+            } else {
+                status = HEX_OVERFLOW;
+                pos = hi_pos;
+                break;
+            }
+        } else if (cls == HEXC_COMMENT) {
+            /* Skip to the line break, which is then handled as a space. */
+            const char* eol = memchr(src + pos, '\n', len - pos);
+            pos = eol ? (size_t) (eol - src) : len;
+            continue;
+        } else if (cls != HEXC_SPACE) {
+            status = HEX_INVALID;
+            break;
+        }
+        pos++;
+    }
+
+    if (status == HEX_OK && hi >= 0) {
+        status = HEX_ODD;
+        pos = hi_pos;
+    }
+    if (written)
+        *written = out;
+    if (offset && status != HEX_OK)
+        *offset = pos;
+    return status;
+}
@@ -0,0 +1,54 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HEX_H_
+#define HEX_H_
+
+#include "cpu.h"
+
+#include <stddef.h>
+
+/* Return codes for hex_decode. */
+#define HEX_OK 0         // Everything was decoded.
+#define HEX_INVALID 1    // Found a character that is not hex, space or '#'.
+#define HEX_ODD 2        // Input ended in the middle of a byte.
+#define HEX_OVERFLOW 3   // Decoded data does not fit in the output buffer.
+
+/**
+ * Decode an hexadecimal ROM listing into binary. Every pair of hex digits
+ * (case insensitive) becomes one byte. Whitespace is ignored anywhere,
+ * even between the two digits of a byte, and a '#' starts a comment that
+ * lasts until the end of the line.
+ *
+ * Long runs of digits are decoded 16 or 32 characters at a time using
+ * SSE2 or AVX2 when the compiler targets them, falling back to a table
+ * driven scalar decoder otherwise.
+ *
+ * @param src hexadecimal listing to decode.
+ * @param len amount of characters in src.
+ * @param dst buffer where the decoded bytes are written.
+ * @param dstsiz capacity of dst in bytes.
+ * @param written if not NULL, receives the amount of bytes decoded.
+ * @param offset if not NULL, receives the offset in src of the character
+ *        that caused the error when the return code is not HEX_OK.
+ * @return HEX_OK on success or one of the HEX_* error codes.
+ */
+int hex_decode(const char* src, size_t len, byte* dst, size_t dstsiz,
+        size_t* written, size_t* offset);
+
+#endif // HEX_H_
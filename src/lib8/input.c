@@ -0,0 +1,90 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "input.h"
+#include <stdlib.h>
+
+struct input_queue_t
+{
+    unsigned int mask;          // Capacity - 1.
+    unsigned int head;          // Next event to apply, owned by the consumer.
+    unsigned int tail;          // Next free slot, owned by the producer.
+    struct input_event_t events[];
+};
+
+struct input_queue_t*
+input_create(int capacity)
+{
+    unsigned int size = 1;
+    while (size < (unsigned int) capacity)
+        size <<= 1;
+    struct input_queue_t* queue = malloc(sizeof(struct input_queue_t)
+            + size * sizeof(struct input_event_t));
+    if (queue == NULL)
+        return NULL;
+    queue->mask = size - 1;
+    queue->head = 0;
+    queue->tail = 0;
+    return queue;
+}
+
+int
+input_push(struct input_queue_t* queue, const struct input_event_t* events,
+        int n)
+{
+    unsigned int tail = queue->tail;
+    unsigned int head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    int pushed = 0;
+    while (pushed < n && tail - head <= queue->mask) {
+        queue->events[tail & queue->mask] = events[pushed++];
+        tail++;
+    }
+
+    /* Releases the events to the consumer at once. */
+    __atomic_store_n(&queue->tail, tail, __ATOMIC_RELEASE);
+    return pushed;
+}
+
+int
+input_apply(struct input_queue_t* queue, struct machine_t* cpu, int steps)
+{
+    unsigned int head = queue->head;
+    unsigned int tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        const struct input_event_t* event = &queue->events[head & queue->mask];
+        if (event->at > cpu->clock) {
+            uint64_t ahead = event->at - cpu->clock;
+            if (ahead < (uint64_t) steps)
+                steps = ahead;
+            break;
+        }
+        word bit = 1 << (event->key & 0xF);
+        cpu->keypad = event->down ? cpu->keypad | bit : cpu->keypad & ~bit;
+        head++;
+    }
+
+    /* Hands the slots back to the producer. */
+    __atomic_store_n(&queue->head, head, __ATOMIC_RELEASE);
+    return steps;
+}
+
+void
+input_destroy(struct input_queue_t* queue)
+{
+    free(queue);
+}
@@ -0,0 +1,74 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include "cpu.h"
+
+/* Timestamp of an event to apply as soon as possible. */
+#define INPUT_NOW 0
+
+/**
+ * A key pressed or released at an exact point of the execution.
+ */
+struct input_event_t
+{
+    uint64_t at;                // Instructions run before it, see clock.
+    byte key;                   // Key, 0 to F.
+    byte down;                  // 1 if pressed, 0 if released.
+};
+
+/**
+ * Lock-free queue of key events for a single producer and a single
+ * consumer, the machine it is bound to. Once bound with cpu->input, the
+ * machine applies every event to its keypad right before running the
+ * instruction whose clock is the timestamp of the event, so the same
+ * events give the same run whatever the host does meanwhile. Events are
+ * applied in the order they are pushed; an event stamped in the past is
+ * applied at the next instruction.
+ */
+struct input_queue_t;
+
+/**
+ * Create a queue.
+ * @param capacity how many events may be pending, rounded up to a power
+ *     of two.
+ * @return the queue, or NULL if out of memory.
+ */
+struct input_queue_t* input_create(int capacity);
+
+/**
+ * Queue a batch of events. Only the producer thread may call this.
+ * @return how many events were queued, fewer than n if it became full.
+ */
+int input_push(struct input_queue_t* queue, const struct input_event_t* events,
+        int n);
+
+/**
+ * Apply to the keypad of a machine the events that are due at its clock.
+ * Only the consumer thread may call this; the machine does it by itself.
+ * @param steps most instructions the caller is about to run.
+ * @return how many of those instructions can run before the next pending
+ *     event is due, at least 1 and at most steps.
+ */
+int input_apply(struct input_queue_t* queue, struct machine_t* cpu, int steps);
+
+void input_destroy(struct input_queue_t* queue);
+
+#endif // INPUT_H_
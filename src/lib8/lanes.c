@@ -0,0 +1,503 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lanes.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define OPCODE_NNN(opcode) (opcode & 0xFFF)
+#define OPCODE_KK(opcode) (opcode & 0xFF)
+#define OPCODE_N(opcode) (opcode & 0xF)
+#define OPCODE_X(opcode) ((opcode >> 8) & 0xF)
+#define OPCODE_Y(opcode) ((opcode >> 4) & 0xF)
+#define OPCODE_P(opcode) (opcode >> 12)
+
+/* Groups smaller than this are run lane by lane. */
+#define LANES_VECTOR 4
+
+/* Run a statement on every lane. Loops have a fixed trip count. */
+#define EACH_LANE(l) for (int l = 0; l < LANES_MAX; l++)
+
+struct lanes_t
+{
+    int n;                          // Lanes in use.
+
+    /* Registers, one column per lane. */
+    byte v[16][LANES_MAX];
+    address i[LANES_MAX];
+    address pc[LANES_MAX];
+    byte sp[LANES_MAX];
+    byte dt[LANES_MAX];
+    byte st[LANES_MAX];
+    uint32_t rng[LANES_MAX];
+
+    /* Round state. Masks are 0xFF for lanes in, 0 for lanes out. */
+    word op[LANES_MAX];             // Opcode fetched by every lane.
+    byte todo[LANES_MAX];           // Lanes that still have to run.
+    byte mask[LANES_MAX];           // Lanes of the group being run.
+    byte flag[LANES_MAX];           // Scratch for V[F].
+    byte live[LANES_MAX];           // Lanes in use.
+    byte stall[LANES_MAX];          // Lane has exited or waits for a key.
+    int stalled;                    // How many lanes are stalled.
+
+    /* Memory, screen, stack and flags of every lane. */
+    struct machine_t* machines;
+};
+
+/* Copy the registers of a lane into its machine. */
+static void
+load_lane(struct lanes_t* lanes, int l)
+{
+    struct machine_t* cpu = &lanes->machines[l];
+    for (int r = 0; r < 16; r++) {
+        cpu->v[r] = lanes->v[r][l];
+    }
+    cpu->i = lanes->i[l];
+    cpu->pc = lanes->pc[l];
+    cpu->sp = lanes->sp[l];
+    cpu->dt = lanes->dt[l];
+    cpu->st = lanes->st[l];
+    cpu->rng = lanes->rng[l];
+}
+
+/* Copy the registers of a machine back into its lane. */
+static void
+store_lane(struct lanes_t* lanes, int l)
+{
+    struct machine_t* cpu = &lanes->machines[l];
+    for (int r = 0; r < 16; r++) {
+        lanes->v[r][l] = cpu->v[r];
+    }
+    lanes->i[l] = cpu->i;
+    lanes->pc[l] = cpu->pc;
+    lanes->sp[l] = cpu->sp;
+    lanes->dt[l] = cpu->dt;
+    lanes->st[l] = cpu->st;
+    lanes->rng[l] = cpu->rng;
+}
+
+struct lanes_t*
+lanes_create(int n, const struct machine_t* boot, uint32_t seed)
+{
+    if (n < 1 || n > LANES_MAX)
+        return NULL;
+    struct lanes_t* lanes = calloc(1, sizeof(struct lanes_t));
+    if (lanes == NULL)
+        return NULL;
+    lanes->machines = malloc(n * sizeof(struct machine_t));
+    if (lanes->machines == NULL) {
+        free(lanes);
+        return NULL;
+    }
+    lanes->n = n;
+    for (int l = 0; l < n; l++) {
+        struct machine_t* cpu = &lanes->machines[l];
+        memcpy(cpu, boot, sizeof(struct machine_t));
+        cpu->keydown = NULL;
+        cpu->input = NULL;
+        cpu->speaker = NULL;
+        cpu->aot = NULL;
+        cpu->keypad = 0;
+        seed_machine(cpu, seed + l);
+        store_lane(lanes, l);
+        lanes->live[l] = 0xFF;
+    }
+    return lanes;
+}
+
+void
+lanes_set_keys(struct lanes_t* lanes, const word* keys)
+{
+    for (int l = 0; l < lanes->n; l++) {
+        lanes->machines[l].keypad = keys[l];
+    }
+}
+
+void
+lanes_tick(struct lanes_t* lanes)
+{
+    EACH_LANE(l) {
+        lanes->dt[l] -= lanes->dt[l] > 0;
+        lanes->st[l] -= lanes->st[l] > 0;
+    }
+}
+
+const struct machine_t*
+lanes_machine(struct lanes_t* lanes, int k)
+{
+    load_lane(lanes, k);
+    return &lanes->machines[k];
+}
+
+void
+lanes_destroy(struct lanes_t* lanes)
+{
+    free(lanes->machines);
+    free(lanes);
+}
+
+/* Keep track of lanes that cannot run the next round as they are. */
+static void
+update_stall(struct lanes_t* lanes, int l)
+{
+    const struct machine_t* cpu = &lanes->machines[l];
+    byte stall = cpu->exit || cpu->wait_key != -1;
+    lanes->stalled += stall - lanes->stall[l];
+    lanes->stall[l] = stall;
+}
+
+/* Run an instruction on a single lane through the interpreter. */
+static void
+run_scalar(struct lanes_t* lanes, int l, word opcode)
+{
+    load_lane(lanes, l);
+    execute_opcode(&lanes->machines[l], opcode);
+    store_lane(lanes, l);
+    update_stall(lanes, l);
+}
+
+/* Run an instruction lane by lane on every lane of the group. */
+static void
+run_group_scalar(struct lanes_t* lanes, word opcode, address next)
+{
+    for (int l = 0; l < lanes->n; l++) {
+        if (lanes->mask[l]) {
+            lanes->pc[l] = next;
+            run_scalar(lanes, l, opcode);
+        }
+    }
+}
+
+/* Is the vector code for the opcode wrong under the quirks of the lanes? */
+static int
+has_quirks(const struct lanes_t* lanes, word opcode)
+{
+    int quirks = lanes->machines[0].quirks;
+    if (quirks == QUIRKS_DEFAULT || OPCODE_P(opcode) != 0x8)
+        return 0;
+    switch (OPCODE_N(opcode)) {
+    case 0x1: case 0x2: case 0x3:
+        return quirks & QUIRK_LOGIC;
+    case 0x6: case 0xE:
+        return quirks & QUIRK_SHIFT;
+    }
+    return 0;
+}
+
+/* Skip the next instruction on the lanes of the group where cond is set. */
+static void
+skip_if(struct lanes_t* lanes, const byte* cond, address skip)
+{
+    byte* m = lanes->mask;
+    EACH_LANE(l) {
+        lanes->pc[l] = (m[l] & cond[l]) ? skip : lanes->pc[l];
+    }
+}
+
+/**
+ * Run an instruction on every lane of the group. Every lane in the group
+ * is at the same PC, so the address of the next instruction is the same
+ * for all of them.
+ */
+static void
+run_group(struct lanes_t* lanes, word opcode, address pc, int size)
+{
+    byte* m = lanes->mask;
+    byte* f = lanes->flag;
+    address next = (pc + 2) & 0xFFF, skip = (pc + 4) & 0xFFF;
+    int x = OPCODE_X(opcode), y = OPCODE_Y(opcode);
+    byte kk = OPCODE_KK(opcode);
+    address nnn = OPCODE_NNN(opcode);
+    byte* vx = lanes->v[x];
+    byte* vy = lanes->v[y];
+    byte* vf = lanes->v[15];
+
+    /*
+     * Vector code is not worth it for lanes that have diverged, and it is
+     * only written for the default quirks.
+     */
+    if (size < LANES_VECTOR || has_quirks(lanes, opcode)) {
+        run_group_scalar(lanes, opcode, next);
+        return;
+    }
+
+    EACH_LANE(l) {
+        lanes->pc[l] = m[l] ? next : lanes->pc[l];
+    }
+
+    switch (OPCODE_P(opcode)) {
+    case 0x1:
+        EACH_LANE(l) {
+            lanes->pc[l] = m[l] ? nnn : lanes->pc[l];
+        }
+        return;
+    case 0x3:
+        EACH_LANE(l) {
+            f[l] = -(vx[l] == kk);
+        }
+        skip_if(lanes, f, skip);
+        return;
+    case 0x4:
+        EACH_LANE(l) {
+            f[l] = -(vx[l] != kk);
+        }
+        skip_if(lanes, f, skip);
+        return;
+    case 0x5:
+        EACH_LANE(l) {
+            f[l] = -(vx[l] == vy[l]);
+        }
+        skip_if(lanes, f, skip);
+        return;
+    case 0x9:
+        EACH_LANE(l) {
+            f[l] = -(vx[l] != vy[l]);
+        }
+        skip_if(lanes, f, skip);
+        return;
+    case 0x6:
+        EACH_LANE(l) {
+            vx[l] = m[l] ? kk : vx[l];
+        }
+        return;
+    case 0x7:
+        EACH_LANE(l) {
+            vx[l] += kk & m[l];
+        }
+        return;
+    case 0x8:
+        /*
+         * V[F] is written first and V[X] is computed afterwards, as the
+         * interpreter does, which matters when X or Y is F.
+         */
+        switch (OPCODE_N(opcode)) {
+        case 0x0:
+            EACH_LANE(l) {
+                vx[l] = m[l] ? vy[l] : vx[l];
+            }
+            return;
+        case 0x1:
+            EACH_LANE(l) {
+                vx[l] |= vy[l] & m[l];
+            }
+            return;
+        case 0x2:
+            EACH_LANE(l) {
+                vx[l] &= vy[l] | ~m[l];
+            }
+            return;
+        case 0x3:
+            EACH_LANE(l) {
+                vx[l] ^= vy[l] & m[l];
+            }
+            return;
+        case 0x4:
+            EACH_LANE(l) {
+                f[l] = vx[l] > (byte) (vx[l] + vy[l]);
+            }
+            EACH_LANE(l) {
+                vf[l] = m[l] ? f[l] : vf[l];
+            }
+            EACH_LANE(l) {
+                vx[l] += vy[l] & m[l];
+            }
+            return;
+        case 0x5:
+            EACH_LANE(l) {
+                f[l] = vx[l] > vy[l];
+            }
+            EACH_LANE(l) {
+                vf[l] = m[l] ? f[l] : vf[l];
+            }
+            EACH_LANE(l) {
+                vx[l] -= vy[l] & m[l];
+            }
+            return;
+        case 0x6:
+            EACH_LANE(l) {
+                f[l] = vx[l] & 1;
+            }
+            EACH_LANE(l) {
+                vf[l] = m[l] ? f[l] : vf[l];
+            }
+            EACH_LANE(l) {
+                vx[l] = m[l] ? vx[l] >> 1 : vx[l];
+            }
+            return;
+        case 0x7:
+            EACH_LANE(l) {
+                f[l] = vy[l] > vx[l];
+            }
+            EACH_LANE(l) {
+                vf[l] = m[l] ? f[l] : vf[l];
+            }
+            EACH_LANE(l) {
+                vx[l] = m[l] ? (byte) (vy[l] - vx[l]) : vx[l];
+            }
+            return;
+        case 0xE:
+            EACH_LANE(l) {
+                f[l] = (vx[l] & 0x80) != 0;
+            }
+            EACH_LANE(l) {
+                vf[l] = m[l] ? f[l] : vf[l];
+            }
+            EACH_LANE(l) {
+                vx[l] = m[l] ? (byte) (vx[l] << 1) : vx[l];
+            }
+            return;
+        }
+        return;
+    case 0xA:
+        EACH_LANE(l) {
+            lanes->i[l] = m[l] ? nnn : lanes->i[l];
+        }
+        return;
+    case 0xC:
+        EACH_LANE(l) {
+            uint32_t r = lanes->rng[l];
+            r ^= r << 13;
+            r ^= r >> 17;
+            r ^= r << 5;
+            lanes->rng[l] = m[l] ? r : lanes->rng[l];
+        }
+        EACH_LANE(l) {
+            vx[l] = m[l] ? (byte) ((lanes->rng[l] >> 8) & kk) : vx[l];
+        }
+        return;
+    case 0xF:
+        switch (kk) {
+        case 0x07:
+            EACH_LANE(l) {
+                vx[l] = m[l] ? lanes->dt[l] : vx[l];
+            }
+            return;
+        case 0x15:
+            EACH_LANE(l) {
+                lanes->dt[l] = m[l] ? vx[l] : lanes->dt[l];
+            }
+            return;
+        case 0x18:
+            EACH_LANE(l) {
+                lanes->st[l] = m[l] ? vx[l] : lanes->st[l];
+            }
+            return;
+        case 0x1E:
+            EACH_LANE(l) {
+                lanes->i[l] = (lanes->i[l] + (vx[l] & m[l])) & ADDRESS_MASK;
+            }
+            return;
+        case 0x29:
+            EACH_LANE(l) {
+                lanes->i[l] = m[l] ? 0x50 + (vx[l] & 0xF) * 5 : lanes->i[l];
+            }
+            return;
+        }
+        break;
+    }
+
+    /* Memory, screen, stack, keys... one lane at a time. */
+    run_group_scalar(lanes, opcode, next);
+}
+
+/* Is the lane able to run this round? Also handles waiting for a key. */
+static int
+is_lane_ready(struct lanes_t* lanes, int l)
+{
+    struct machine_t* cpu = &lanes->machines[l];
+    if (cpu->exit)
+        return 0;
+    if (cpu->wait_key != -1) {
+        for (int key = 0; key < 16; key++) {
+            if ((cpu->keypad >> key) & 1) {
+                lanes->v[(int) cpu->wait_key][l] = key;
+                cpu->wait_key = -1;
+                break;
+            }
+        }
+        update_stall(lanes, l);
+        return cpu->wait_key == -1;
+    }
+    return 1;
+}
+
+/**
+ * Lanes never interact, so once they have diverged they can just as well
+ * be run one after the other, each one with run_machine.
+ */
+static void
+run_diverged(struct lanes_t* lanes, int steps)
+{
+    for (int l = 0; l < lanes->n; l++) {
+        load_lane(lanes, l);
+        run_machine(&lanes->machines[l], steps);
+        store_lane(lanes, l);
+        update_stall(lanes, l);
+    }
+}
+
+void
+lanes_run(struct lanes_t* lanes, int steps)
+{
+    byte* todo = lanes->todo;
+    byte* m = lanes->mask;
+    while (steps > 0) {
+        int left = 0;
+        if (lanes->stalled == 0) {
+            memcpy(todo, lanes->live, LANES_MAX);
+            left = lanes->n;
+        } else for (int l = 0; l < lanes->n; l++) {
+            todo[l] = is_lane_ready(lanes, l) ? 0xFF : 0;
+            left += todo[l] != 0;
+        }
+        for (int l = 0; l < lanes->n; l++) {
+            const byte* mem = lanes->machines[l].mem;
+            address pc = lanes->pc[l];
+            lanes->op[l] = (mem[pc] << 8) | mem[pc + 1];
+        }
+
+        /* Every group is the set of lanes at the first PC left. */
+        int groups = 0;
+        for (int first = 0; left > 0; first++) {
+            if (!todo[first])
+                continue;
+            address pc = lanes->pc[first];
+            word opcode = lanes->op[first];
+            EACH_LANE(l) {
+                m[l] = todo[l] & -(lanes->pc[l] == pc) & -(lanes->op[l] == opcode);
+            }
+            EACH_LANE(l) {
+                todo[l] &= ~m[l];
+            }
+            int size = 0;
+            for (int l = first; l < lanes->n; l++) {
+                size += m[l] != 0;
+            }
+            left -= size;
+            groups++;
+            run_group(lanes, opcode, pc, size);
+        }
+        steps--;
+
+        /* Too many small groups: lockstep does not pay off anymore. */
+        if (groups * LANES_VECTOR > lanes->n) {
+            run_diverged(lanes, steps);
+            return;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LANES_H_
+#define LANES_H_
+
+#include "cpu.h"
+
+/* Maximum amount of machines run in lockstep. */
+#define LANES_MAX 32
+
+/**
+ * Lockstep execution of many copies of the same ROM. Registers, I, PC,
+ * SP, timers and the random number generators of every copy (lane) are
+ * kept as structure of arrays, one array element per lane, so that the
+ * compiler can run a whole instruction on every lane with vector code.
+ *
+ * Execution goes in rounds and every lane runs exactly one instruction
+ * per round, so lanes are timed as step_machine. In a round, lanes are
+ * grouped by PC and opcode and every group is run together under a lane
+ * mask. Lanes that have diverged simply form more groups. Instructions
+ * that touch memory, the screen or the stack are run lane by lane.
+ */
+struct lanes_t;
+
+/**
+ * Create lanes. Every lane starts as a copy of boot, without keyboard
+ * poller, speaker nor native code: keys are given with lanes_set_keys.
+ *
+ * @param n how many lanes, up to LANES_MAX.
+ * @param boot state every lane starts from.
+ * @param seed lane k is seeded with seed + k.
+ * @return the lanes, or NULL if n is out of range or out of memory.
+ */
+struct lanes_t* lanes_create(int n, const struct machine_t* boot, uint32_t seed);
+
+/**
+ * Set the keypad of every lane.
+ * @param keys n keypad masks, bit K is key K.
+ */
+void lanes_set_keys(struct lanes_t* lanes, const word* keys);
+
+/**
+ * Run every lane for a number of instructions.
+ */
+void lanes_run(struct lanes_t* lanes, int steps);
+
+/**
+ * Count down the timers of every lane once, as tick_timers.
+ */
+void lanes_tick(struct lanes_t* lanes);
+
+/**
+ * Get the state of a lane as a machine. The machine is only a view of the
+ * lane: changes made to its registers are lost on the next lanes_run.
+ */
+const struct machine_t* lanes_machine(struct lanes_t* lanes, int k);
+
+void lanes_destroy(struct lanes_t* lanes);
+
+#endif // LANES_H_
@@ -0,0 +1,237 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libchip8.h"
+#include "cpu.h"
+#include "input.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Identifies a snapshot; bump the version when machine_t changes. */
+#define SNAPSHOT_MAGIC 0x43385350   // "C8SP"
+#define SNAPSHOT_VERSION 2
+
+struct chip8_t
+{
+    uint64_t shown_key;         // Screen hash at the last dirty check.
+    int shown_esm;              // Screen mode at the last dirty check.
+    struct input_queue_t* input; // Key events given to chip8_push_keys.
+    struct machine_t machine;
+};
+
+struct snapshot_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;              // sizeof(struct machine_t), as a check.
+    struct machine_t machine;
+};
+
+/* Is it one of the profiles set_quirks accepts? */
+static int
+is_profile(int quirks)
+{
+    static const char* names[] = { "default", "chip8", "schip", "xochip" };
+    for (int k = 0; k < 4; k++) {
+        if (quirks_by_name(names[k]) == quirks)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Can a machine be run without reading or writing out of bounds? The
+ * stack, PC and I index memory, the key FX0A waits for indexes V, the
+ * timer carry-overs are less than a frame and the mirror repeats the
+ * start of memory. DT and ST are bytes, so any value is valid.
+ */
+static int
+is_consistent(const struct machine_t* src)
+{
+    if (src->pc >= MEMSIZ || src->i >= MEMSIZ || src->sp < 0 || src->sp > 16
+            || (src->esm != 0 && src->esm != 1) || !is_profile(src->quirks))
+        return 0;
+    for (int k = 0; k < 16; k++) {
+        if (src->stack[k] >= MEMSIZ)
+            return 0;
+    }
+    if (src->wait_key < -1 || src->wait_key > 15)
+        return 0;
+    if (src->delta < 0 || src->delta > 1000 / 60
+            || src->cycles < 0 || src->cycles > VIP_FRAME_CYCLES)
+        return 0;
+    if (memcmp(src->mem + MEMSIZ, src->mem, MEMGUARD) != 0)
+        return 0;
+    for (int k = 0; k < (int) sizeof(src->screen); k++) {
+        if (src->screen[k] != 0 && src->screen[k] != 1)
+            return 0;
+    }
+    return 1;
+}
+
+struct chip8_t*
+chip8_create(uint32_t seed)
+{
+    struct chip8_t* chip8 = malloc(sizeof(struct chip8_t));
+    if (chip8 == NULL)
+        return NULL;
+    if ((chip8->input = input_create(CHIP8_KEY_EVENTS)) == NULL) {
+        free(chip8);
+        return NULL;
+    }
+    init_machine(&chip8->machine);
+    chip8->machine.input = chip8->input;
+    seed_machine(&chip8->machine, seed);
+    chip8->shown_key = 0;
+    chip8->shown_esm = -1;
+    return chip8;
+}
+
+void
+chip8_destroy(struct chip8_t* chip8)
+{
+    input_destroy(chip8->input);
+    free(chip8);
+}
+
+int
+chip8_set_quirks(struct chip8_t* chip8, const char* profile)
+{
+    int quirks = quirks_by_name(profile);
+    return quirks == -1 || set_quirks(&chip8->machine, quirks);
+}
+
+int
+chip8_load(struct chip8_t* chip8, const void* rom, size_t size)
+{
+    if (size > MEMSIZ - 0x200)
+        return 1;
+    memcpy(chip8->machine.mem + 0x200, rom, size);
+    return 0;
+}
+
+void
+chip8_set_keypad(struct chip8_t* chip8, uint16_t keys)
+{
+    chip8->machine.keypad = keys;
+}
+
+int
+chip8_push_keys(struct chip8_t* chip8,
+        const struct chip8_key_event_t* events, int n)
+{
+    struct input_event_t batch[32];
+    int pushed = 0;
+    while (pushed < n) {
+        int count = n - pushed < 32 ? n - pushed : 32;
+        for (int k = 0; k < count; k++) {
+            batch[k].at = events[pushed + k].at;
+            batch[k].key = events[pushed + k].key & 0xF;
+            batch[k].down = events[pushed + k].down != 0;
+        }
+        int queued = input_push(chip8->input, batch, count);
+        pushed += queued;
+        if (queued < count)
+            break;
+    }
+    return pushed;
+}
+
+uint64_t
+chip8_clock(const struct chip8_t* chip8)
+{
+    return chip8->machine.clock;
+}
+
+int
+chip8_run(struct chip8_t* chip8, int frames, int steps)
+{
+    struct machine_t* cpu = &chip8->machine;
+    for (int frame = 0; frame < frames && !cpu->exit; frame++) {
+        if (steps > 0)
+            run_machine(cpu, steps);
+        else
+            run_vip_frame(cpu, steps == CHIP8_VIP_VBLANK);
+        tick_timers(cpu);
+    }
+    return cpu->exit != 0;
+}
+
+int
+chip8_sound(const struct chip8_t* chip8)
+{
+    return chip8->machine.st > 0;
+}
+
+const uint8_t*
+chip8_framebuffer(struct chip8_t* chip8, int* width, int* height, int* dirty)
+{
+    const struct machine_t* cpu = &chip8->machine;
+    if (width)
+        *width = cpu->esm ? 128 : 64;
+    if (height)
+        *height = cpu->esm ? 64 : 32;
+    if (dirty) {
+        *dirty = cpu->screen_key != chip8->shown_key
+            || cpu->esm != chip8->shown_esm;
+        chip8->shown_key = cpu->screen_key;
+        chip8->shown_esm = cpu->esm;
+    }
+    return (const uint8_t *) cpu->screen;
+}
+
+size_t
+chip8_snapshot_size(void)
+{
+    return sizeof(struct snapshot_t);
+}
+
+int
+chip8_snapshot(const struct chip8_t* chip8, void* buffer, size_t size)
+{
+    if (size < sizeof(struct snapshot_t))
+        return 1;
+    struct snapshot_t* snapshot = buffer;
+    snapshot->magic = SNAPSHOT_MAGIC;
+    snapshot->version = SNAPSHOT_VERSION;
+    snapshot->size = sizeof(struct machine_t);
+    memcpy(&snapshot->machine, &chip8->machine, sizeof(struct machine_t));
+    return 0;
+}
+
+int
+chip8_restore(struct chip8_t* chip8, const void* buffer, size_t size)
+{
+    const struct snapshot_t* snapshot = buffer;
+    if (size < sizeof(struct snapshot_t)
+            || snapshot->magic != SNAPSHOT_MAGIC
+            || snapshot->version != SNAPSHOT_VERSION
+            || snapshot->size != sizeof(struct machine_t))
+        return 1;
+
+    /* Reject states the interpreter assumes never happen. */
+    const struct machine_t* src = &snapshot->machine;
+    if (!is_consistent(src))
+        return 1;
+
+    /* Opcode tables may live elsewhere in the process that saved it. */
+    struct machine_t* cpu = &chip8->machine;
+    snapshot_machine(cpu, src);
+    set_quirks(cpu, cpu->quirks);
+    return 0;
+}
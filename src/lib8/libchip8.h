@@ -0,0 +1,153 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBCHIP8_H_
+#define LIBCHIP8_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Embedding interface of libchip8. Machines are only reached through an
+ * opaque handle, so the layout of the emulator can change between
+ * releases without breaking programs linked against the library. Every
+ * exported function is versioned; functions added later get a new version
+ * node and existing ones keep their behaviour.
+ */
+struct chip8_t;
+
+/**
+ * Create a machine with nothing loaded and the default quirk profile.
+ * @param seed seed of the random number generator used by CXKK.
+ * @return the machine, or NULL if out of memory.
+ */
+struct chip8_t* chip8_create(uint32_t seed);
+
+void chip8_destroy(struct chip8_t* chip8);
+
+/**
+ * Select the quirk profile: default, chip8, schip or xochip.
+ * @return 0 on success, != 0 if the profile is unknown.
+ */
+int chip8_set_quirks(struct chip8_t* chip8, const char* profile);
+
+/**
+ * Load a binary ROM at 0x200.
+ * @param rom the ROM, up to 3584 bytes.
+ * @return 0 on success, != 0 if the ROM is too large.
+ */
+int chip8_load(struct chip8_t* chip8, const void* rom, size_t size);
+
+/**
+ * Set the keys held down from now on.
+ * @param keys bit K is key K.
+ */
+void chip8_set_keypad(struct chip8_t* chip8, uint16_t keys);
+
+/**
+ * A key pressed or released at an exact instruction.
+ */
+struct chip8_key_event_t
+{
+    uint64_t at;                // Value of chip8_clock to apply it at.
+    uint8_t key;                // Key, 0 to 15.
+    uint8_t down;               // 1 if pressed, 0 if released.
+};
+
+/**
+ * Queue key events. Each one is applied right before the instruction run
+ * when chip8_clock reaches its time, wherever that falls in a frame, so
+ * a script of events replays exactly. Events are applied in the order
+ * they are queued, and those whose time has passed at the next
+ * instruction. Another thread may queue events while chip8_run runs.
+ * @return how many events were queued, fewer than n once the queue of
+ *     CHIP8_KEY_EVENTS pending events is full.
+ */
+int chip8_push_keys(struct chip8_t* chip8,
+        const struct chip8_key_event_t* events, int n);
+
+/* Pending key events a machine can hold. */
+#define CHIP8_KEY_EVENTS 256
+
+/**
+ * Instructions run by a machine since it was created, the time base of
+ * key events. Restoring a snapshot brings back its clock.
+ */
+uint64_t chip8_clock(const struct chip8_t* chip8);
+
+/* Values of steps for chip8_run that select the COSMAC VIP timing. */
+#define CHIP8_VIP 0
+#define CHIP8_VIP_VBLANK -1
+
+/**
+ * Run a number of frames, each one made of some instructions followed by
+ * a tick of the timers.
+ * @param steps how many instructions make a frame, or CHIP8_VIP to run as
+ *     many as the original COSMAC VIP would, or CHIP8_VIP_VBLANK to also
+ *     end the frame after every sprite drawn, as the VIP waits for vblank.
+ * @return 0 while running, 1 once the ROM has exited with 00FD.
+ */
+int chip8_run(struct chip8_t* chip8, int frames, int steps);
+
+/**
+ * Is the sound timer running, so the speaker should beep?
+ */
+int chip8_sound(const struct chip8_t* chip8);
+
+/**
+ * Get the framebuffer without copying it: one byte per pixel, 0 or 1,
+ * row after row. The pointer stays valid while the machine exists, but
+ * the pixels change on every chip8_run and chip8_restore.
+ * @param width where to store the width, 64 or 128, or NULL.
+ * @param height where to store the height, 32 or 64, or NULL.
+ * @param dirty where to store whether the pixels or the size changed
+ *     since the last call that asked for it, or NULL.
+ */
+const uint8_t* chip8_framebuffer(struct chip8_t* chip8, int* width,
+        int* height, int* dirty);
+
+/**
+ * Bytes needed by a snapshot of a machine.
+ */
+size_t chip8_snapshot_size(void);
+
+/**
+ * Save the state of a machine. Snapshots can only be restored by the same
+ * version of the library.
+ * @param buffer chip8_snapshot_size() bytes, aligned as malloc does.
+ * @return 0 on success, != 0 if the buffer is too small.
+ */
+int chip8_snapshot(const struct chip8_t* chip8, void* buffer, size_t size);
+
+/**
+ * Restore a snapshot taken with chip8_snapshot. The machine is left as it
+ * was if the snapshot is not valid.
+ * @param buffer the snapshot, aligned as malloc does.
+ * @return 0 on success, != 0 if the snapshot is not valid.
+ */
+int chip8_restore(struct chip8_t* chip8, const void* buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBCHIP8_H_
@@ -0,0 +1,210 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rollback.h"
+#include <stdlib.h>
+
+/* Inputs are kept for frames from the window behind to the window ahead. */
+#define INPUTS (2 * ROLLBACK_WINDOW)
+
+/* Local hashes kept to be compared with the remote ones. */
+#define HASHES 8
+
+struct rollback_t
+{
+    struct machine_t* cpu;          // Machine being run.
+    int steps;                      // Instructions per frame.
+    long frame;                     // Next frame to run.
+    long rerun;                     // First mispredicted frame, or -1.
+    long remote_known;              // Remote keys known before this frame.
+    word remote_keys;               // Last remote keys received.
+    word local[INPUTS];             // Local keys of frame f at f % INPUTS.
+    word remote[INPUTS];            // Remote keys, known or predicted.
+    struct machine_t* snaps;        // State before frame f at f % WINDOW.
+
+    long hashed;                    // Next frame to hash.
+    long hash_frame[HASHES];        // Frames of the local hashes.
+    uint64_t hash[HASHES];          // Local hashes.
+    int new_hash;                   // Has a hash not been taken yet?
+};
+
+struct rollback_t*
+rollback_create(struct machine_t* cpu, int steps)
+{
+    struct rollback_t* rb = calloc(1, sizeof(struct rollback_t));
+    if (rb == NULL)
+        return NULL;
+    rb->snaps = calloc(ROLLBACK_WINDOW, sizeof(struct machine_t));
+    if (rb->snaps == NULL) {
+        free(rb);
+        return NULL;
+    }
+    rb->cpu = cpu;
+    rb->steps = steps;
+    rb->rerun = -1;
+    for (int k = 0; k < HASHES; k++)
+        rb->hash_frame[k] = -1;
+    return rb;
+}
+
+/* Run a frame whose input is in the rings, after saving the state. */
+static void
+run_frame(struct rollback_t* rb, long frame)
+{
+    snapshot_machine(&rb->snaps[frame % ROLLBACK_WINDOW], rb->cpu);
+    rb->cpu->keypad = rb->local[frame % INPUTS] | rb->remote[frame % INPUTS];
+    run_frames(rb->cpu, 1, rb->steps);
+}
+
+/* Hash the states whose input is all known. */
+static void
+update_hashes(struct rollback_t* rb)
+{
+    long confirmed = rb->remote_known < rb->frame ? rb->remote_known : rb->frame;
+    for (; rb->hashed <= confirmed; rb->hashed++) {
+        long frame = rb->hashed;
+        if (frame % ROLLBACK_HASH_PERIOD)
+            continue;
+        const struct machine_t* state = frame == rb->frame ? rb->cpu
+            : &rb->snaps[frame % ROLLBACK_WINDOW];
+        int slot = (frame / ROLLBACK_HASH_PERIOD) % HASHES;
+        rb->hash_frame[slot] = frame;
+        rb->hash[slot] = rollback_state_hash(state);
+        rb->new_hash = 1;
+    }
+}
+
+int
+rollback_frame(struct rollback_t* rb, word keys)
+{
+    if (rb->frame - rb->remote_known >= ROLLBACK_WINDOW)
+        return -1;
+
+    int reruns = 0;
+    if (rb->rerun >= 0) {
+        snapshot_machine(rb->cpu, &rb->snaps[rb->rerun % ROLLBACK_WINDOW]);
+        for (long frame = rb->rerun; frame < rb->frame; frame++) {
+            run_frame(rb, frame);
+            reruns++;
+        }
+        rb->rerun = -1;
+    }
+
+    rb->local[rb->frame % INPUTS] = keys;
+    if (rb->frame >= rb->remote_known)
+        rb->remote[rb->frame % INPUTS] = rb->remote_keys;
+    run_frame(rb, rb->frame);
+    rb->frame++;
+    update_hashes(rb);
+    return reruns;
+}
+
+long
+rollback_current(const struct rollback_t* rb)
+{
+    return rb->frame;
+}
+
+int
+rollback_remote(struct rollback_t* rb, long frame, word keys)
+{
+    if (frame < rb->remote_known || frame >= rb->frame + ROLLBACK_WINDOW)
+        return -1;
+
+    /* Up to the frame the keys were the previous ones, then these. */
+    for (long f = rb->remote_known; f <= frame; f++) {
+        word real = f < frame ? rb->remote_keys : keys;
+        if (f < rb->frame && rb->remote[f % INPUTS] != real
+                && (rb->rerun < 0 || f < rb->rerun)) {
+            rb->rerun = f;
+        }
+        rb->remote[f % INPUTS] = real;
+    }
+
+    /* Later frames already run were predicted with the previous keys. */
+    for (long f = frame + 1; f < rb->frame; f++) {
+        if (rb->remote[f % INPUTS] != keys && (rb->rerun < 0 || f < rb->rerun))
+            rb->rerun = f;
+        rb->remote[f % INPUTS] = keys;
+    }
+    rb->remote_keys = keys;
+    rb->remote_known = frame + 1;
+    if (rb->rerun < 0)
+        update_hashes(rb);
+    return 0;
+}
+
+int
+rollback_new_hash(struct rollback_t* rb, long* frame, uint64_t* hash)
+{
+    if (!rb->new_hash)
+        return 0;
+    long last = rb->hashed - 1;
+    last -= last % ROLLBACK_HASH_PERIOD;
+    int slot = (last / ROLLBACK_HASH_PERIOD) % HASHES;
+    *frame = rb->hash_frame[slot];
+    *hash = rb->hash[slot];
+    rb->new_hash = 0;
+    return 1;
+}
+
+int
+rollback_check(const struct rollback_t* rb, long frame, uint64_t hash)
+{
+    int slot = (frame / ROLLBACK_HASH_PERIOD) % HASHES;
+    if (rb->hash_frame[slot] == frame)
+        return rb->hash[slot] != hash;
+    return rb->hash_frame[slot] < frame ? -1 : 0;
+}
+
+/* FNV-1a. */
+static uint64_t
+hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+    const byte* bytes = data;
+    for (size_t k = 0; k < size; k++) {
+        hash ^= bytes[k];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+uint64_t
+rollback_state_hash(const struct machine_t* cpu)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    hash = hash_bytes(hash, &cpu->pc, sizeof(cpu->pc));
+    hash = hash_bytes(hash, &cpu->i, sizeof(cpu->i));
+    hash = hash_bytes(hash, cpu->stack, sizeof(cpu->stack));
+    hash = hash_bytes(hash, &cpu->sp, sizeof(cpu->sp));
+    hash = hash_bytes(hash, cpu->v, sizeof(cpu->v));
+    hash = hash_bytes(hash, &cpu->dt, sizeof(cpu->dt));
+    hash = hash_bytes(hash, &cpu->st, sizeof(cpu->st));
+    hash = hash_bytes(hash, &cpu->rng, sizeof(cpu->rng));
+    hash = hash_bytes(hash, &cpu->esm, sizeof(cpu->esm));
+    hash = hash_bytes(hash, &cpu->screen_key, sizeof(cpu->screen_key));
+    hash = hash_bytes(hash, cpu->r, sizeof(cpu->r));
+    return hash_bytes(hash, cpu->mem, MEMSIZ);
+}
+
+void
+rollback_destroy(struct rollback_t* rb)
+{
+    free(rb->snaps);
+    free(rb);
+}
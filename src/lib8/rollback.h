@@ -0,0 +1,113 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ROLLBACK_H_
+#define ROLLBACK_H_
+
+#include "cpu.h"
+
+/* Frames that can be run ahead of the remote input. */
+#define ROLLBACK_WINDOW 16
+
+/* Frames between state hashes. */
+#define ROLLBACK_HASH_PERIOD 60
+
+/**
+ * Rollback for two players sharing a machine. Every side runs the same
+ * machine; the keypad seen by the machine is the keys held by the local
+ * player or-ed with the keys held by the remote one.
+ *
+ * Frames are run as soon as the local input is known. Remote keys that
+ * have not arrived yet are predicted to be the last ones received. When
+ * the real remote keys of a frame differ from the prediction, the machine
+ * is restored to the state it had before that frame and run again up to
+ * the present. A snapshot of the state before each of the last
+ * ROLLBACK_WINDOW frames is kept for that, so a side cannot get more than
+ * ROLLBACK_WINDOW frames ahead of the remote input it has received.
+ *
+ * Input travels in frame order as (frame, keys) pairs meaning "keys held
+ * from this frame on": a pair is only needed when the keys change, plus
+ * now and then to let the other side know the keys did not. Both sides
+ * hash the state every ROLLBACK_HASH_PERIOD frames once the input of
+ * those frames is known, so that a desync can be told.
+ *
+ * The library does not move any data; the caller carries the keys and
+ * hashes between the sides any way it likes.
+ */
+struct rollback_t;
+
+/**
+ * Start a session on a machine. The machine must use its keypad instead
+ * of a keyboard poller and both sides must start from the same state,
+ * random number generator included.
+ *
+ * @param cpu machine to run. It is owned by the caller.
+ * @param steps how many instructions make a frame.
+ * @return the session, or NULL if out of memory.
+ */
+struct rollback_t* rollback_create(struct machine_t* cpu, int steps);
+
+/**
+ * Run the next frame with the keys held by the local player. Frames run
+ * with mispredicted remote keys are run again first.
+ *
+ * @param keys keys held by the local player, bit K is key K.
+ * @return how many frames were run again, or -1 if the frame cannot be
+ *         run until more remote input arrives.
+ */
+int rollback_frame(struct rollback_t* rb, word keys);
+
+/**
+ * Number of the next frame to run. Once rollback_frame succeeds, the
+ * frame it ran is this minus one.
+ */
+long rollback_current(const struct rollback_t* rb);
+
+/**
+ * Receive remote keys. Pairs must come in frame order.
+ * @param frame first frame the keys are held on.
+ * @param keys keys held by the remote player.
+ * @return 0, or -1 if the frame is too far in the future to be from a
+ *         remote side following the protocol.
+ */
+int rollback_remote(struct rollback_t* rb, long frame, word keys);
+
+/**
+ * Get a state hash computed since the last call, if any.
+ * @param frame set to the frame the state is from (the state before it).
+ * @param hash set to the hash.
+ * @return 1 if there was a new hash, 0 otherwise.
+ */
+int rollback_new_hash(struct rollback_t* rb, long* frame, uint64_t* hash);
+
+/**
+ * Compare a state hash received from the remote side to the local one.
+ * @return 0 if they match or the local one is long gone, 1 if they
+ *         differ, -1 if the local one is not known yet.
+ */
+int rollback_check(const struct rollback_t* rb, long frame, uint64_t hash);
+
+/**
+ * Hash the state of a machine: registers, timers, stack, memory and
+ * screen, but not the bindings nor the keypad.
+ */
+uint64_t rollback_state_hash(const struct machine_t* cpu);
+
+void rollback_destroy(struct rollback_t* rb);
+
+#endif // ROLLBACK_H_
@@ -0,0 +1,96 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rom.h"
+#include "hex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int
+load_hex(struct machine_t* machine, const char* file)
+{
+    FILE* fp = fopen(file, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot open ROM file.\n");
+        return 1;
+    }
+
+    // Use the fseek/ftell/fseek trick to retrieve file size.
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    // Create a temporal buffer where to store the data.
+    char* hexfile = malloc(length);
+    if (hexfile == NULL) {
+        fclose(fp);
+        return 1;
+    }
+    length = fread(hexfile, 1, length, fp);
+    fclose(fp);
+
+    size_t offset;
+    int status = hex_decode(hexfile, length, machine->mem + 0x200,
+            MEMSIZ - 0x200, NULL, &offset);
+    switch (status) {
+        case HEX_INVALID:
+            fprintf(stderr, "Invalid character 0x%02x at offset %zu.\n",
+                    (unsigned char) hexfile[offset], offset);
+            break;
+        case HEX_ODD:
+            fprintf(stderr, "Incomplete byte at offset %zu.\n", offset);
+            break;
+        case HEX_OVERFLOW:
+            fprintf(stderr, "ROM too large.\n");
+            break;
+    }
+
+    free(hexfile);
+    return status != HEX_OK;
+}
+
+int
+load_rom(struct machine_t* machine, const char* file)
+{
+    FILE* fp = fopen(file, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot open ROM file.\n");
+        return 1;
+    }
+
+    // Use the fseek/ftell/fseek trick to retrieve file size.
+    fseek(fp, 0, SEEK_END);
+    int length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    // Check the length of the rom. Must be as much 3584 bytes long, which
+    // is 4096 - 512. Since first 512 bytes of memory are reserved, program
+    // code can only allocate up to 3584 bytes. Must check for bounds in
+    // order to avoid buffer overflows.
+    if (length > 3584) {
+        fprintf(stderr, "ROM too large.\n");
+        fclose(fp);
+        return 1;
+    }
+
+    // Everything is OK, read the ROM.
+    fread(machine->mem + 0x200, length, 1, fp);
+    fclose(fp);
+    return 0;
+}
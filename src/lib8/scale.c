@@ -0,0 +1,220 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scale.h"
+#include <string.h>
+
+/* Words in a packed row of the widest screen. */
+#define WORDS 2
+
+/* Rows of the tallest screen. */
+#define ROWS 64
+
+static const struct {
+    const char* name;
+    int filter;
+    int factor;
+} filters[] = {
+    { "none", SCALE_NONE, 1 },
+    { "scale2x", SCALE_2X, 2 },
+    { "scale3x", SCALE_3X, 3 },
+    { "eagle", SCALE_EAGLE, 2 },
+};
+
+#define FILTERS (int) (sizeof(filters) / sizeof(filters[0]))
+
+int
+scale_by_name(const char* name)
+{
+    for (int k = 0; k < FILTERS; k++) {
+        if (strcmp(filters[k].name, name) == 0)
+            return filters[k].filter;
+    }
+    return -1;
+}
+
+int
+scale_factor(int filter)
+{
+    for (int k = 0; k < FILTERS; k++) {
+        if (filters[k].filter == filter)
+            return filters[k].factor;
+    }
+    return 1;
+}
+
+/* A row with its neighbours on the left and on the right. */
+struct row_t
+{
+    uint64_t left[WORDS], mid[WORDS], right[WORDS];
+};
+
+/* Pack a row, bit x of the row is pixel x. */
+static void
+pack_row(const char* px, int words, uint64_t* row)
+{
+    for (int w = 0; w < words; w++) {
+        uint64_t bits = 0;
+        for (int x = 0; x < 64; x++)
+            bits |= (uint64_t) (px[64 * w + x] & 1) << x;
+        row[w] = bits;
+    }
+}
+
+/* Shift a row so that every pixel sees its neighbours, edges repeated. */
+static void
+shift_row(struct row_t* row, int words)
+{
+    for (int w = 0; w < words; w++) {
+        uint64_t before = w > 0 ? row->mid[w - 1] >> 63 : row->mid[0] & 1;
+        uint64_t after = w + 1 < words ? row->mid[w + 1] << 63
+            : row->mid[words - 1] & (1ULL << 63);
+        row->left[w] = row->mid[w] << 1 | before;
+        row->right[w] = row->mid[w] >> 1 | after;
+    }
+}
+
+/* Pick a where the mask is set and b elsewhere. */
+static inline uint64_t
+select_bits(uint64_t mask, uint64_t a, uint64_t b)
+{
+    return (mask & a) | (~mask & b);
+}
+
+/*
+ * Unpack an output row made of factor interleaved bit sets. It is inlined
+ * for every factor so that the loop over the parts is unrolled.
+ */
+#ifdef __GNUC__
+#define SPECIALIZED static inline __attribute__((always_inline)) void
+#else
+#define SPECIALIZED static inline void
+#endif
+
+SPECIALIZED
+emit_row(uint32_t* out, uint64_t (*parts)[WORDS], int factor, int words)
+{
+    for (int w = 0; w < words; w++) {
+        uint64_t b0 = parts[0][w];
+        uint64_t b1 = factor > 1 ? parts[1][w] : 0;
+        uint64_t b2 = factor > 2 ? parts[2][w] : 0;
+        for (int x = 0; x < 64; x++) {
+            out[0] = -(uint32_t) ((b0 >> x) & 1);
+            if (factor > 1)
+                out[1] = -(uint32_t) ((b1 >> x) & 1);
+            if (factor > 2)
+                out[2] = -(uint32_t) ((b2 >> x) & 1);
+            out += factor;
+        }
+    }
+}
+
+static void
+emit_rows(uint32_t* out, int pitch, uint64_t (*parts)[3][WORDS], int factor,
+        int words)
+{
+    switch (factor) {
+        case 1:
+            emit_row(out, parts[0], 1, words);
+            break;
+        case 2:
+            emit_row(out, parts[0], 2, words);
+            emit_row(out + pitch, parts[1], 2, words);
+            break;
+        case 3:
+            emit_row(out, parts[0], 3, words);
+            emit_row(out + pitch, parts[1], 3, words);
+            emit_row(out + 2 * pitch, parts[2], 3, words);
+            break;
+    }
+}
+
+void
+scale_screen(int filter, const char* screen, int esm, uint32_t* out,
+        int pitch)
+{
+    int words = esm ? 2 : 1;
+    int height = esm ? 64 : 32;
+    int factor = scale_factor(filter);
+
+    struct row_t rows[ROWS];
+    for (int y = 0; y < height; y++) {
+        pack_row(screen + 64 * words * y, words, rows[y].mid);
+        shift_row(&rows[y], words);
+    }
+
+    /*
+     * Neighbours are named after their place around the pixel E:
+     *   A B C
+     *   D E F
+     *   G H I
+     */
+    uint64_t parts[3][3][WORDS];
+    for (int y = 0; y < height; y++) {
+        const struct row_t* up = &rows[y > 0 ? y - 1 : 0];
+        const struct row_t* row = &rows[y];
+        const struct row_t* down = &rows[y + 1 < height ? y + 1 : y];
+        for (int w = 0; w < words; w++) {
+            uint64_t a = up->left[w], b = up->mid[w], c = up->right[w];
+            uint64_t d = row->left[w], e = row->mid[w], f = row->right[w];
+            uint64_t g = down->left[w], h = down->mid[w], i = down->right[w];
+            uint64_t edge = (b ^ h) & (d ^ f);
+            uint64_t db = ~(d ^ b), bf = ~(b ^ f);
+            uint64_t dh = ~(d ^ h), hf = ~(h ^ f);
+
+            switch (filter) {
+                case SCALE_2X:
+                    parts[0][0][w] = select_bits(edge & db, d, e);
+                    parts[0][1][w] = select_bits(edge & bf, f, e);
+                    parts[1][0][w] = select_bits(edge & dh, d, e);
+                    parts[1][1][w] = select_bits(edge & hf, f, e);
+                    break;
+                case SCALE_3X:
+                    parts[0][0][w] = select_bits(edge & db, d, e);
+                    parts[0][1][w] = select_bits(edge
+                            & ((db & (e ^ c)) | (bf & (e ^ a))), b, e);
+                    parts[0][2][w] = select_bits(edge & bf, f, e);
+                    parts[1][0][w] = select_bits(edge
+                            & ((db & (e ^ g)) | (dh & (e ^ a))), d, e);
+                    parts[1][1][w] = e;
+                    parts[1][2][w] = select_bits(edge
+                            & ((bf & (e ^ i)) | (hf & (e ^ c))), f, e);
+                    parts[2][0][w] = select_bits(edge & dh, d, e);
+                    parts[2][1][w] = select_bits(edge
+                            & ((dh & (e ^ i)) | (hf & (e ^ g))), h, e);
+                    parts[2][2][w] = select_bits(edge & hf, f, e);
+                    break;
+                case SCALE_EAGLE:
+                    /*
+                     * Eagle only lights corners here. Darkening them too,
+                     * as the original does, would erase the lone pixels
+                     * games use for balls and bullets.
+                     */
+                    parts[0][0][w] = e | (a & b & d);
+                    parts[0][1][w] = e | (c & b & f);
+                    parts[1][0][w] = e | (g & d & h);
+                    parts[1][1][w] = e | (i & f & h);
+                    break;
+                default:
+                    parts[0][0][w] = e;
+                    break;
+            }
+        }
+        emit_rows(out + factor * y * pitch, pitch, parts, factor, words);
+    }
+}
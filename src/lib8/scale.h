@@ -0,0 +1,66 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCALE_H_
+#define SCALE_H_
+
+#include "cpu.h"
+
+/* Filters. */
+#define SCALE_NONE 0    // Every pixel becomes a square.
+#define SCALE_2X 1      // Scale2x: edges are smoothed at twice the size.
+#define SCALE_3X 2      // Scale3x: edges are smoothed at three times the size.
+#define SCALE_EAGLE 3   // Eagle: corners are filled at twice the size.
+
+/* Largest output: a 128x64 screen at three times the size. */
+#define SCALE_MAX_WIDTH (128 * 3)
+#define SCALE_MAX_HEIGHT (64 * 3)
+
+/**
+ * Pixel art upscalers. Screens are monochrome, so every row is packed as
+ * a bit set of 64 pixels per word and the rules of each filter become
+ * bitwise operations applied to 64 pixels at once: neighbours are the
+ * rows above and below and the row shifted by one bit.
+ */
+
+/**
+ * Get a filter by name: "none", "scale2x", "scale3x" or "eagle".
+ * @return the filter, or -1 if there is no filter with that name.
+ */
+int scale_by_name(const char* name);
+
+/**
+ * How many times a filter scales a screen up.
+ */
+int scale_factor(int filter);
+
+/**
+ * Filter a screen into 32-bit pixels, 0xFFFFFFFF for a lit pixel and 0
+ * for a dark one. The output is 64x32 or 128x64, as the screen, times
+ * scale_factor. Pixels outside of the screen are taken to be the same as
+ * the closest pixel on the edge.
+ *
+ * @param screen screen bitmap, as machine_t.screen.
+ * @param esm != 0 if the screen is in Extended Screen Mode.
+ * @param out where to write the pixels.
+ * @param pitch distance between rows of out, in pixels.
+ */
+void scale_screen(int filter, const char* screen, int esm, uint32_t* out,
+        int pitch);
+
+#endif // SCALE_H_
@@ -0,0 +1,431 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "sched.h"
+#include "input.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+struct session_t
+{
+    struct machine_t* cpu;
+    int steps;                      // Instructions per frame.
+    session_input_t input;
+    session_output_t output;
+    void* data;
+    int state;                      // SESSION_* value.
+    address loop;                   // Start of the delay timer loop.
+    int pos;                        // Next instruction of the loop.
+};
+
+/**
+ * Work stealing queue. Queues are windows of the order array that are
+ * filled before a frame starts and only shrink while it runs: the owner
+ * pops from the bottom and thieves take from the top, as in a Chase-Lev
+ * deque without pushes.
+ */
+struct queue_t
+{
+    int top;
+    int bottom;
+};
+
+struct worker_t
+{
+    struct sched_t* sched;
+    int id;
+    pthread_t thread;
+    struct queue_t queue;
+};
+
+struct sched_t
+{
+    int nthreads;
+    struct worker_t* workers;       // nthreads workers, 0 is the caller.
+    struct session_t** sessions;
+    int nsessions;
+    int capacity;
+    struct session_t** order;       // Sessions to run this frame.
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;           // A frame has started.
+    pthread_cond_t done;            // Every helper is done.
+    long generation;                // Frames started.
+    int busy;                       // Helpers still running the frame.
+    int quit;
+};
+
+static struct session_t*
+queue_pop(struct sched_t* sched, struct queue_t* queue)
+{
+    int b = __atomic_load_n(&queue->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&queue->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int t = __atomic_load_n(&queue->top, __ATOMIC_RELAXED);
+    if (t > b) {
+        __atomic_store_n(&queue->bottom, b + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    struct session_t* session = sched->order[b];
+    if (t == b) {
+        /* Last one: race the thieves for it. */
+        if (!__atomic_compare_exchange_n(&queue->top, &t, t + 1, 0,
+                    __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            session = NULL;
+        __atomic_store_n(&queue->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return session;
+}
+
+/* Steal a session, or return NULL if the queue is empty or the race lost. */
+static struct session_t*
+queue_steal(struct sched_t* sched, struct queue_t* queue)
+{
+    int t = __atomic_load_n(&queue->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int b = __atomic_load_n(&queue->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b)
+        return NULL;
+    struct session_t* session = sched->order[t];
+    if (!__atomic_compare_exchange_n(&queue->top, &t, t + 1, 0,
+                __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return NULL;
+    return session;
+}
+
+static int
+queue_size(struct queue_t* queue)
+{
+    return __atomic_load_n(&queue->bottom, __ATOMIC_ACQUIRE)
+        - __atomic_load_n(&queue->top, __ATOMIC_ACQUIRE);
+}
+
+static word
+fetch(const byte* mem, address at)
+{
+    return mem[at] << 8 | mem[at + 1];
+}
+
+/**
+ * Is the machine spinning in a FX07, 3X00, 1NNN loop waiting for DT?
+ * Remembers where the loop is and where in the loop the machine is.
+ */
+static int
+find_dt_loop(struct session_t* session)
+{
+    const struct machine_t* cpu = session->cpu;
+    for (int pos = 0; pos < 3; pos++) {
+        address start = (cpu->pc - 2 * pos) & ADDRESS_MASK;
+        word first = fetch(cpu->mem, start);
+        word x = first & 0x0F00;
+        if ((first & 0xF0FF) == 0xF007
+                && fetch(cpu->mem, (start + 2) & ADDRESS_MASK) == (0x3000 | x)
+                && fetch(cpu->mem, (start + 4) & ADDRESS_MASK) == (0x1000 | start)) {
+            session->loop = start;
+            session->pos = pos;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Leave the machine as a frame of the delay timer loop would, in constant
+ * time: steps instructions of the loop go by, and at least one of them is
+ * the FX07, which reads DT as it is during the whole frame.
+ */
+static void
+skip_dt_loop(struct session_t* session)
+{
+    struct machine_t* cpu = session->cpu;
+    session->pos = (session->pos + session->steps) % 3;
+    cpu->pc = (session->loop + 2 * session->pos) & ADDRESS_MASK;
+    cpu->v[cpu->mem[session->loop] & 0xF] = cpu->dt;
+}
+
+/**
+ * Let the instructions of a parked frame go by: the clock advances as if
+ * they ran and the key events due meanwhile are applied in time.
+ */
+static void
+skip_steps(struct machine_t* cpu, int steps)
+{
+    while (steps > 0) {
+        int chunk = cpu->input ? input_apply(cpu->input, cpu, steps) : steps;
+        cpu->clock += chunk;
+        steps -= chunk;
+    }
+}
+
+/**
+ * Is a key down, or going down during the frame, for a session waiting for
+ * a key? Any key event due during the frame wakes the session, so that it
+ * is applied right at its instruction.
+ */
+static int
+key_coming(struct session_t* session)
+{
+    struct machine_t* cpu = session->cpu;
+    if (cpu->input && input_apply(cpu->input, cpu, session->steps) < session->steps)
+        return 1;
+    return cpu->keypad != 0;
+}
+
+/* Run a frame of a session and park it if it is going to spin. */
+static void
+run_session(struct session_t* session)
+{
+    struct machine_t* cpu = session->cpu;
+    run_machine(cpu, session->steps);
+    tick_timers(cpu);
+    if (session->output)
+        session->output(session->data, cpu);
+
+    if (cpu->exit)
+        session->state = SESSION_EXITED;
+    else if (cpu->wait_key != -1 && cpu->keydown == NULL)
+        session->state = SESSION_WAIT_KEY;
+    else if (session->steps >= 3 && cpu->dt > 0 && find_dt_loop(session))
+        session->state = SESSION_WAIT_DT;
+}
+
+/**
+ * Get a session ready for the frame. Parked sessions that cannot wake up
+ * get their timers counted down here.
+ * @return != 0 if the session has to be run.
+ */
+static int
+prepare_session(struct session_t* session)
+{
+    struct machine_t* cpu = session->cpu;
+    if (session->state == SESSION_EXITED)
+        return 0;
+    if (session->input)
+        cpu->keypad = session->input(session->data);
+
+    switch (session->state) {
+    case SESSION_WAIT_KEY:
+        if (!key_coming(session))
+            break;
+        session->state = SESSION_RUNNING;
+        return 1;
+    case SESSION_WAIT_DT:
+        skip_dt_loop(session);
+        break;
+    default:
+        return 1;
+    }
+
+    skip_steps(cpu, session->steps);
+    tick_timers(cpu);
+    if (session->state == SESSION_WAIT_DT && cpu->dt == 0)
+        session->state = SESSION_RUNNING;
+    if (session->output)
+        session->output(session->data, cpu);
+    return 0;
+}
+
+/* Run the own queue, then steal until every queue is empty. */
+static void
+work(struct worker_t* worker)
+{
+    struct sched_t* sched = worker->sched;
+    for (;;) {
+        struct session_t* session = queue_pop(sched, &worker->queue);
+        if (session) {
+            run_session(session);
+            continue;
+        }
+        for (int k = 1; k < sched->nthreads && session == NULL; k++) {
+            struct queue_t* victim = &sched->workers[(worker->id + k) % sched->nthreads].queue;
+            while (session == NULL && queue_size(victim) > 0) {
+                session = queue_steal(sched, victim);
+            }
+        }
+        if (session == NULL)
+            return;
+        run_session(session);
+    }
+}
+
+static void*
+worker_main(void* data)
+{
+    struct worker_t* worker = data;
+    struct sched_t* sched = worker->sched;
+    long seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&sched->lock);
+        while (sched->generation == seen && !sched->quit) {
+            pthread_cond_wait(&sched->start, &sched->lock);
+        }
+        if (sched->quit) {
+            pthread_mutex_unlock(&sched->lock);
+            return NULL;
+        }
+        seen = sched->generation;
+        pthread_mutex_unlock(&sched->lock);
+
+        work(worker);
+
+        pthread_mutex_lock(&sched->lock);
+        if (--sched->busy == 0)
+            pthread_cond_signal(&sched->done);
+        pthread_mutex_unlock(&sched->lock);
+    }
+}
+
+struct sched_t*
+sched_create(int threads)
+{
+    if (threads < 1)
+        return NULL;
+    struct sched_t* sched = calloc(1, sizeof(struct sched_t));
+    if (sched == NULL)
+        return NULL;
+    sched->workers = calloc(threads, sizeof(struct worker_t));
+    if (sched->workers == NULL) {
+        free(sched);
+        return NULL;
+    }
+    pthread_mutex_init(&sched->lock, NULL);
+    pthread_cond_init(&sched->start, NULL);
+    pthread_cond_init(&sched->done, NULL);
+
+    for (int k = 0; k < threads; k++) {
+        sched->workers[k].sched = sched;
+        sched->workers[k].id = k;
+    }
+    sched->nthreads = 1;
+    for (int k = 1; k < threads; k++) {
+        if (pthread_create(&sched->workers[k].thread, NULL, worker_main,
+                    &sched->workers[k])) {
+            sched_destroy(sched);
+            return NULL;
+        }
+        sched->nthreads++;
+    }
+    return sched;
+}
+
+struct session_t*
+sched_add(struct sched_t* sched, struct machine_t* cpu, int steps,
+        session_input_t input, session_output_t output, void* data)
+{
+    if (sched->nsessions == sched->capacity) {
+        int capacity = sched->capacity ? 2 * sched->capacity : 64;
+        struct session_t** sessions = realloc(sched->sessions,
+                capacity * sizeof(struct session_t*));
+        if (sessions == NULL)
+            return NULL;
+        sched->sessions = sessions;
+        struct session_t** order = realloc(sched->order,
+                capacity * sizeof(struct session_t*));
+        if (order == NULL)
+            return NULL;
+        sched->order = order;
+        sched->capacity = capacity;
+    }
+
+    struct session_t* session = calloc(1, sizeof(struct session_t));
+    if (session == NULL)
+        return NULL;
+    session->cpu = cpu;
+    session->steps = steps;
+    session->input = input;
+    session->output = output;
+    session->data = data;
+    session->state = cpu->exit ? SESSION_EXITED : SESSION_RUNNING;
+    sched->sessions[sched->nsessions++] = session;
+    return session;
+}
+
+void
+sched_remove(struct sched_t* sched, struct session_t* session)
+{
+    for (int k = 0; k < sched->nsessions; k++) {
+        if (sched->sessions[k] == session) {
+            sched->sessions[k] = sched->sessions[--sched->nsessions];
+            free(session);
+            return;
+        }
+    }
+}
+
+int
+sched_run_frame(struct sched_t* sched)
+{
+    int count = 0;
+    for (int k = 0; k < sched->nsessions; k++) {
+        if (prepare_session(sched->sessions[k]))
+            sched->order[count++] = sched->sessions[k];
+    }
+    if (count == 0)
+        return 0;
+
+    /* Split the sessions evenly; stealing takes care of the rest. */
+    for (int k = 0; k < sched->nthreads; k++) {
+        sched->workers[k].queue.top = (long) count * k / sched->nthreads;
+        sched->workers[k].queue.bottom = (long) count * (k + 1) / sched->nthreads;
+    }
+
+    pthread_mutex_lock(&sched->lock);
+    sched->busy = sched->nthreads - 1;
+    sched->generation++;
+    pthread_cond_broadcast(&sched->start);
+    pthread_mutex_unlock(&sched->lock);
+
+    work(&sched->workers[0]);
+
+    pthread_mutex_lock(&sched->lock);
+    while (sched->busy > 0) {
+        pthread_cond_wait(&sched->done, &sched->lock);
+    }
+    pthread_mutex_unlock(&sched->lock);
+    return count;
+}
+
+int
+session_state(const struct session_t* session)
+{
+    return session->state;
+}
+
+void
+sched_destroy(struct sched_t* sched)
+{
+    pthread_mutex_lock(&sched->lock);
+    sched->quit = 1;
+    pthread_cond_broadcast(&sched->start);
+    pthread_mutex_unlock(&sched->lock);
+    for (int k = 1; k < sched->nthreads; k++) {
+        pthread_join(sched->workers[k].thread, NULL);
+    }
+    for (int k = 0; k < sched->nsessions; k++) {
+        free(sched->sessions[k]);
+    }
+    pthread_mutex_destroy(&sched->lock);
+    pthread_cond_destroy(&sched->start);
+    pthread_cond_destroy(&sched->done);
+    free(sched->sessions);
+    free(sched->order);
+    free(sched->workers);
+    free(sched);
+}
@@ -0,0 +1,117 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include "cpu.h"
+
+/**
+ * Session scheduler. Runs many machine sessions on a pool of threads, one
+ * emulated frame at a time: sched_run_frame runs a frame of every session
+ * and returns when all of them are done, so every session advances at the
+ * same pace and a frame takes as long as the busiest worker needs.
+ *
+ * Runnable sessions are split among the per-worker queues at the start of
+ * every frame. A worker runs the sessions of its own queue and, when it is
+ * empty, steals sessions from the other queues, so slow sessions do not
+ * leave the rest of the workers idle.
+ *
+ * Sessions that would only spin are parked and cost no emulation until
+ * they can make progress again:
+ * - Waiting for a key (FX0A) with no key down: woken by any key, or by
+ *   any event of the input queue bound to the machine due in the frame.
+ * - Busy waiting for the delay timer with the loop FX07, 3X00, 1NNN back
+ *   to the FX07: woken when DT reaches 0. The registers and PC are kept
+ *   exactly as if the loop was running.
+ * Timers keep counting down, the clock keeps advancing, queued key events
+ * keep being applied in time and outputs keep being called while parked.
+ */
+struct sched_t;
+
+struct session_t;
+
+/* Session states. */
+#define SESSION_RUNNING 0       // Runs every frame.
+#define SESSION_WAIT_KEY 1      // Parked until a key is down.
+#define SESSION_WAIT_DT 2       // Parked until DT is 0.
+#define SESSION_EXITED 3        // Ran 00FD, never runs again.
+
+/**
+ * Input source of a session. Called once per frame, on the thread calling
+ * sched_run_frame, before the frame is run.
+ * @param data pointer given to sched_add.
+ * @return keys down for the frame, bit K is key K.
+ */
+typedef word (*session_input_t)(void* data);
+
+/**
+ * Output sink of a session. Called once per frame after the frame has
+ * been run and the timers have ticked. It may be called from any thread
+ * of the scheduler, but never at the same time for the same session.
+ * @param data pointer given to sched_add.
+ * @param cpu machine of the session.
+ */
+typedef void (*session_output_t)(void* data, const struct machine_t* cpu);
+
+/**
+ * Create a scheduler. The thread calling sched_run_frame works too, so
+ * threads - 1 more threads are started.
+ * @param threads how many threads run sessions, at least 1.
+ * @return the scheduler, or NULL if it cannot be created.
+ */
+struct sched_t* sched_create(int threads);
+
+/**
+ * Add a session. The machine is not copied and must outlive the session.
+ * Keys come from input into the keypad, so the machine must not have a
+ * keyboard poller.
+ *
+ * @param cpu machine, usually one that has just loaded a ROM.
+ * @param steps clock rate, as instructions per frame.
+ * @param input input source, or NULL to leave the keypad alone.
+ * @param output output sink, or NULL.
+ * @param data given to input and output.
+ * @return the session, or NULL if out of memory.
+ */
+struct session_t* sched_add(struct sched_t* sched, struct machine_t* cpu,
+        int steps, session_input_t input, session_output_t output, void* data);
+
+/**
+ * Remove a session. Must not be called while a frame is running.
+ */
+void sched_remove(struct sched_t* sched, struct session_t* session);
+
+/**
+ * Run a frame of every session.
+ * @return how many sessions were actually emulated, not parked.
+ */
+int sched_run_frame(struct sched_t* sched);
+
+/**
+ * Get the state of a session, one of the SESSION_* values.
+ */
+int session_state(const struct session_t* session);
+
+/**
+ * Stop the threads and free the scheduler and its sessions. Machines are
+ * left alone.
+ */
+void sched_destroy(struct sched_t* sched);
+
+#endif // SCHED_H_
@@ -0,0 +1,155 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "share.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Map a shared memory object, creating it if asked to. */
+static struct share_segment_t*
+map_segment(const char* name, int create)
+{
+    int fd = create ? shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600)
+        : shm_open(name, O_RDWR, 0);
+    if (fd == -1)
+        return NULL;
+    if (create && ftruncate(fd, sizeof(struct share_segment_t))) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    if (!create) {
+        off_t size = lseek(fd, 0, SEEK_END);
+        if (size < (off_t) sizeof(struct share_segment_t)) {
+            close(fd);
+            return NULL;
+        }
+    }
+    void* addr = mmap(NULL, sizeof(struct share_segment_t),
+            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        if (create)
+            shm_unlink(name);
+        return NULL;
+    }
+    return addr;
+}
+
+struct share_segment_t*
+share_create(const char* name)
+{
+    struct share_segment_t* share = map_segment(name, 1);
+    if (share == NULL)
+        return NULL;
+    memset(share, 0, sizeof(struct share_segment_t));
+    share->version = SHARE_VERSION;
+    share->latest = 0;
+
+    /* Consumers check the magic last, when everything else is set. */
+    __atomic_store_n(&share->magic, SHARE_MAGIC, __ATOMIC_RELEASE);
+    return share;
+}
+
+void
+share_publish(struct share_segment_t* share, const struct machine_t* cpu)
+{
+    int latest = __atomic_load_n(&share->latest, __ATOMIC_RELAXED);
+    struct share_frame_t* prev = &share->frames[latest];
+    struct share_frame_t* next = &share->frames[latest ^ 1];
+
+    word keypad = 0;
+    for (int key = 0; key < 16; key++) {
+        int down = cpu->keydown ? cpu->keydown(key) : (cpu->keypad >> key) & 1;
+        keypad |= down << key;
+    }
+
+    uint32_t seq = next->seq;
+    __atomic_store_n(&next->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    next->esm = cpu->esm;
+    next->frame = prev->frame + 1;
+    next->keypad = keypad | share_keys(share);
+    memcpy(next->screen, cpu->screen, sizeof(next->screen));
+    __atomic_store_n(&next->seq, seq + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&share->latest, latest ^ 1, __ATOMIC_RELEASE);
+}
+
+word
+share_keys(const struct share_segment_t* share)
+{
+    return __atomic_load_n(&share->keys, __ATOMIC_RELAXED);
+}
+
+void
+share_destroy(struct share_segment_t* share, const char* name)
+{
+    munmap(share, sizeof(struct share_segment_t));
+    shm_unlink(name);
+}
+
+struct share_segment_t*
+share_attach(const char* name)
+{
+    struct share_segment_t* share = map_segment(name, 0);
+    if (share == NULL)
+        return NULL;
+    if (__atomic_load_n(&share->magic, __ATOMIC_ACQUIRE) != SHARE_MAGIC
+            || share->version != SHARE_VERSION) {
+        share_detach(share);
+        return NULL;
+    }
+    return share;
+}
+
+void
+share_detach(struct share_segment_t* share)
+{
+    munmap(share, sizeof(struct share_segment_t));
+}
+
+uint32_t
+share_read_begin(const struct share_segment_t* share, int* slot)
+{
+    uint32_t seq;
+    do {
+        *slot = __atomic_load_n(&share->latest, __ATOMIC_ACQUIRE);
+        seq = __atomic_load_n(&share->frames[*slot].seq, __ATOMIC_ACQUIRE);
+    } while (seq & 1);
+    return seq;
+}
+
+int
+share_read_end(const struct share_segment_t* share, int slot, uint32_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&share->frames[slot].seq, __ATOMIC_RELAXED) == seq;
+}
+
+void
+share_set_keys(struct share_segment_t* share, word mask, int down)
+{
+    if (down)
+        __atomic_fetch_or(&share->keys, mask, __ATOMIC_RELAXED);
+    else
+        __atomic_fetch_and(&share->keys, ~(uint32_t) mask, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,114 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHARE_H_
+#define SHARE_H_
+
+#include "cpu.h"
+
+/**
+ * Frames and keys shared with other processes. A running machine can be
+ * published in a POSIX shared memory segment, so that any local process
+ * can map it and read the screen without copies, sockets or knowing about
+ * SDL, and press keys on the machine.
+ *
+ * The layout of the segment is fixed and given below, so consumers may map
+ * it by themselves. There are two frame slots. The publisher always writes
+ * the slot that is not the latest one and then flips latest, so readers of
+ * the latest frame are only disturbed if they take longer than a frame.
+ * Every slot is guarded by a seqlock: seq is odd while the slot is being
+ * written, and a read is only valid if seq was even and did not change.
+ */
+
+#define SHARE_MAGIC 0x38504843      // "CHP8" read as little endian.
+#define SHARE_VERSION 1
+
+struct share_frame_t
+{
+    uint32_t seq;               // Seqlock, odd while being written.
+    uint32_t esm;               // Is the screen 128x64 instead of 64x32?
+    uint64_t frame;             // Frame sequence number, from 1.
+    uint32_t keypad;            // Keys down during the frame, bit K is key K.
+    char screen[8192];          // Screen bitmap, as machine_t.screen.
+};
+
+struct share_segment_t
+{
+    uint32_t magic;             // SHARE_MAGIC.
+    uint32_t version;           // SHARE_VERSION.
+    uint32_t latest;            // Slot with the newest complete frame.
+    uint32_t keys;              // Keys pressed by consumers, bit K is key K.
+    struct share_frame_t frames[2];
+};
+
+/**
+ * Create a segment and publish to it.
+ * @param name shared memory object name, such as "/chip8".
+ * @return the mapped segment, or NULL if it cannot be created.
+ */
+struct share_segment_t* share_create(const char* name);
+
+/**
+ * Publish a frame of a machine. The keypad published is the one the
+ * machine sees, including the keys pressed by consumers.
+ */
+void share_publish(struct share_segment_t* share, const struct machine_t* cpu);
+
+/**
+ * Get the keys currently pressed by consumers.
+ */
+word share_keys(const struct share_segment_t* share);
+
+/**
+ * Unmap and remove a segment made with share_create. Consumers that have
+ * it mapped keep their mapping until they detach.
+ */
+void share_destroy(struct share_segment_t* share, const char* name);
+
+/**
+ * Map an existing segment as a consumer.
+ * @return the segment, or NULL if it does not exist or is not compatible.
+ */
+struct share_segment_t* share_attach(const char* name);
+
+/**
+ * Unmap a segment mapped with share_attach.
+ */
+void share_detach(struct share_segment_t* share);
+
+/**
+ * Start reading the latest frame in place.
+ * @param slot set to the slot to read from share->frames.
+ * @return the sequence to give to share_read_end.
+ */
+uint32_t share_read_begin(const struct share_segment_t* share, int* slot);
+
+/**
+ * Finish reading a frame started with share_read_begin.
+ * @return != 0 if the frame was consistent, 0 if it must be read again.
+ */
+int share_read_end(const struct share_segment_t* share, int slot, uint32_t seq);
+
+/**
+ * Press or release keys on the machine as a consumer.
+ * @param mask keys to change, bit K is key K.
+ * @param down != 0 to press them, 0 to release them.
+ */
+void share_set_keys(struct share_segment_t* share, word mask, int down);
+
+#endif // SHARE_H_
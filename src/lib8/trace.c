@@ -0,0 +1,136 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct event_t
+{
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+struct trace_t
+{
+    int tid;
+    const char* thread;
+    struct event_t* events;
+    long count;                 // Events recorded, overwritten ones included.
+    long capacity;              // Events that fit in the ring.
+};
+
+struct trace_t*
+trace_create(int tid, const char* thread, long capacity)
+{
+    if (capacity < 1)
+        return NULL;
+    struct trace_t* trace = malloc(sizeof(struct trace_t));
+    if (trace == NULL)
+        return NULL;
+    trace->events = malloc(capacity * sizeof(struct event_t));
+    if (trace->events == NULL) {
+        free(trace);
+        return NULL;
+    }
+
+    /* Fault the pages in now rather than in the middle of a frame. */
+    memset(trace->events, 0, capacity * sizeof(struct event_t));
+    trace->tid = tid;
+    trace->thread = thread;
+    trace->count = 0;
+    trace->capacity = capacity;
+    return trace;
+}
+
+void
+trace_event(struct trace_t* trace, const char* name, uint64_t begin,
+        uint64_t end)
+{
+    struct event_t* event = &trace->events[trace->count++ % trace->capacity];
+    event->name = name;
+    event->begin = begin;
+    event->end = end;
+}
+
+long
+trace_dropped(const struct trace_t* trace)
+{
+    return trace->count > trace->capacity ? trace->count - trace->capacity : 0;
+}
+
+/* The k-th oldest event kept. */
+static const struct event_t*
+kept_event(const struct trace_t* trace, long k)
+{
+    return &trace->events[(trace_dropped(trace) + k) % trace->capacity];
+}
+
+/* How many events the ring holds. */
+static long
+kept_events(const struct trace_t* trace)
+{
+    return trace->count - trace_dropped(trace);
+}
+
+int
+trace_save(const char* file, struct trace_t* const* traces, int n)
+{
+    FILE* out = fopen(file, "w");
+    if (out == NULL)
+        return 1;
+
+    uint64_t origin = UINT64_MAX;
+    long dropped = 0;
+    for (int t = 0; t < n; t++) {
+        for (long k = 0; k < kept_events(traces[t]); k++) {
+            if (kept_event(traces[t], k)->begin < origin)
+                origin = kept_event(traces[t], k)->begin;
+        }
+        dropped += trace_dropped(traces[t]);
+    }
+
+    fprintf(out, "{\"traceEvents\":[\n");
+    for (int t = 0; t < n; t++) {
+        const struct trace_t* trace = traces[t];
+        fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                t ? ",\n" : "", trace->tid, trace->thread);
+        for (long k = 0; k < kept_events(trace); k++) {
+            const struct event_t* event = kept_event(trace, k);
+            fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                    "\"tid\":%d,\"ts\":%llu,\"dur\":%llu}",
+                    event->name, trace->tid,
+                    (unsigned long long) (event->begin - origin),
+                    (unsigned long long) (event->end - event->begin));
+        }
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ms\","
+            "\"otherData\":{\"dropped\":%ld}}\n", dropped);
+    int error = ferror(out);
+    return (fclose(out) != 0) | error;
+}
+
+void
+trace_destroy(struct trace_t* trace)
+{
+    free(trace->events);
+    free(trace);
+}
@@ -0,0 +1,72 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+
+/* Events kept by default: over 40 seconds of the emulation thread. */
+#define TRACE_EVENTS (1 << 18)
+
+/**
+ * Timeline of the phases a thread goes through. Events are kept in memory,
+ * in a ring allocated and touched when the timeline is created, and only
+ * written when the timeline is saved, so recording an event is a couple
+ * of stores that never allocate nor fault. Once the ring is full, new
+ * events overwrite the oldest ones. Every thread has its own timeline, so
+ * no locking is needed.
+ */
+struct trace_t;
+
+/**
+ * Create the timeline of a thread.
+ * @param tid thread identifier shown in the trace.
+ * @param thread name shown for the thread. It is not copied.
+ * @param capacity most recent events kept, usually TRACE_EVENTS.
+ * @return the timeline, or NULL if out of memory or capacity < 1.
+ */
+struct trace_t* trace_create(int tid, const char* thread, long capacity);
+
+/**
+ * Record a phase, overwriting the oldest one if the ring is full.
+ * @param name name of the phase, plain text without quotes nor
+ *     backslashes. It is not copied, so it is usually a literal.
+ * @param begin when the phase began, in microseconds.
+ * @param end when the phase ended, in microseconds.
+ */
+void trace_event(struct trace_t* trace, const char* name, uint64_t begin,
+        uint64_t end);
+
+/**
+ * Write timelines as Chrome trace-event JSON, which trace viewers such as
+ * chrome://tracing and Perfetto open. Times are made relative to the
+ * earliest event kept. Events overwritten are counted in otherData.
+ * @param traces n timelines.
+ * @return 0 on success, != 0 if the file cannot be written.
+ */
+int trace_save(const char* file, struct trace_t* const* traces, int n);
+
+/**
+ * How many events were overwritten because the ring wrapped.
+ */
+long trace_dropped(const struct trace_t* trace);
+
+void trace_destroy(struct trace_t* trace);
+
+#endif // TRACE_H_
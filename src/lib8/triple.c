@@ -0,0 +1,77 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "triple.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Set in middle when it holds a frame the reader has not taken. */
+#define FRESH 4
+
+struct triple_t
+{
+    struct frame_t frames[3];
+    int back;                   // Frame owned by the writer.
+    int middle;                 // Frame being handed over, plus FRESH.
+    int front;                  // Frame owned by the reader.
+    long published;             // Frames published so far.
+};
+
+struct triple_t*
+triple_create(void)
+{
+    struct triple_t* triple = calloc(1, sizeof(struct triple_t));
+    if (triple == NULL)
+        return NULL;
+    triple->back = 0;
+    triple->middle = 1;
+    triple->front = 2;
+    return triple;
+}
+
+void
+triple_publish(struct triple_t* triple, const struct machine_t* cpu)
+{
+    struct frame_t* frame = &triple->frames[triple->back];
+    memcpy(frame->screen, cpu->screen, sizeof(frame->screen));
+    frame->esm = cpu->esm;
+    frame->key = cpu->screen_key;
+    frame->number = triple->published++;
+
+    /* Releases the frame to the reader and takes back whatever it left. */
+    int old = __atomic_exchange_n(&triple->middle, triple->back | FRESH,
+            __ATOMIC_ACQ_REL);
+    triple->back = old & ~FRESH;
+}
+
+const struct frame_t*
+triple_latest(struct triple_t* triple)
+{
+    if (!(__atomic_load_n(&triple->middle, __ATOMIC_RELAXED) & FRESH))
+        return NULL;
+    int old = __atomic_exchange_n(&triple->middle, triple->front,
+            __ATOMIC_ACQ_REL);
+    triple->front = old & ~FRESH;
+    return &triple->frames[triple->front];
+}
+
+void
+triple_destroy(struct triple_t* triple)
+{
+    free(triple);
+}
@@ -0,0 +1,64 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRIPLE_H_
+#define TRIPLE_H_
+
+#include "cpu.h"
+
+/**
+ * A frame handed from the thread running a machine to the one showing it.
+ */
+struct frame_t
+{
+    char screen[8192];          // Screen bitmap, as machine_t.screen.
+    int esm;                    // Is in Extended Screen Mode?
+    uint64_t key;               // Zobrist hash of the screen.
+    long number;                // Frames published before this one.
+};
+
+/**
+ * Lock-free triple buffer of frames for a single writer and a single
+ * reader. The writer fills a back frame and swaps it with the middle one;
+ * the reader swaps its front frame with the middle one when there is a new
+ * frame there. Neither side ever waits for the other: a slow reader only
+ * skips frames and a slow writer only leaves the reader on the same frame.
+ */
+struct triple_t;
+
+/**
+ * Create a triple buffer.
+ * @return the buffer, or NULL if out of memory.
+ */
+struct triple_t* triple_create(void);
+
+/**
+ * Publish the screen of a machine. Only the writer thread may call this.
+ */
+void triple_publish(struct triple_t* triple, const struct machine_t* cpu);
+
+/**
+ * Take the latest frame published. Only the reader thread may call this.
+ * The frame stays valid until the next call.
+ * @return the frame, or NULL if nothing was published since last call.
+ */
+const struct frame_t* triple_latest(struct triple_t* triple);
+
+void triple_destroy(struct triple_t* triple);
+
+#endif // TRIPLE_H_
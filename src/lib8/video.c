@@ -0,0 +1,212 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "video.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FRAME_SIZE (VIDEO_WIDTH * VIDEO_HEIGHT)
+
+/**
+ * Single producer, single consumer ring of buffer indices. The producer
+ * only writes tail and the consumer only writes head, so acquire/release
+ * ordering on them is enough.
+ */
+struct ring_t
+{
+    int slot[VIDEO_POOL + 1];
+    int head;   // Next slot to pop.
+    int tail;   // Next slot to push.
+};
+
+struct video_t
+{
+    FILE* out;
+    int format;
+    int close_out;                          // Close out when done?
+    pthread_t writer;
+    byte* pool;                             // VIDEO_POOL frames.
+    struct ring_t pending;                  // Captured, not yet written.
+    struct ring_t free;                     // Ready to be captured into.
+    int done;                               // No more frames are coming.
+    int error;                              // Writer failed.
+    byte rgba[FRAME_SIZE * 4];              // Writer scratch buffer.
+};
+
+static void
+ring_push(struct ring_t* ring, int value)
+{
+    int tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    ring->slot[tail] = value;
+    __atomic_store_n(&ring->tail, (tail + 1) % (VIDEO_POOL + 1), __ATOMIC_RELEASE);
+}
+
+/* Pop a value, or return -1 if the ring is empty. */
+static int
+ring_pop(struct ring_t* ring)
+{
+    int head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    if (head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))
+        return -1;
+    int value = ring->slot[head];
+    __atomic_store_n(&ring->head, (head + 1) % (VIDEO_POOL + 1), __ATOMIC_RELEASE);
+    return value;
+}
+
+static void
+nap(void)
+{
+    struct timespec ts = { 0, 1000000 };
+    nanosleep(&ts, NULL);
+}
+
+static int
+write_frame(struct video_t* video, const byte* frame)
+{
+    if (video->format == VIDEO_Y4M) {
+        if (fputs("FRAME\n", video->out) == EOF)
+            return 1;
+        return fwrite(frame, FRAME_SIZE, 1, video->out) != 1;
+    }
+    for (int k = 0; k < FRAME_SIZE; k++) {
+        memset(video->rgba + 4 * k, frame[k], 3);
+        video->rgba[4 * k + 3] = 255;
+    }
+    return fwrite(video->rgba, FRAME_SIZE * 4, 1, video->out) != 1;
+}
+
+static void*
+writer_main(void* data)
+{
+    struct video_t* video = data;
+    for (;;) {
+        int slot = ring_pop(&video->pending);
+        if (slot == -1) {
+            /* Check done before popping again so no frame is left. */
+            if (__atomic_load_n(&video->done, __ATOMIC_ACQUIRE)
+                    && (slot = ring_pop(&video->pending)) == -1)
+                break;
+            if (slot == -1) {
+                nap();
+                continue;
+            }
+        }
+        if (!video->error && write_frame(video, video->pool + slot * FRAME_SIZE))
+            __atomic_store_n(&video->error, 1, __ATOMIC_RELEASE);
+        ring_push(&video->free, slot);
+    }
+    if (fflush(video->out))
+        video->error = 1;
+    return NULL;
+}
+
+static int
+has_suffix(const char* file, const char* suffix)
+{
+    size_t len = strlen(file), slen = strlen(suffix);
+    return len >= slen && strcmp(file + len - slen, suffix) == 0;
+}
+
+struct video_t*
+video_open(const char* file, int format)
+{
+    struct video_t* video = calloc(1, sizeof(struct video_t));
+    if (video == NULL)
+        return NULL;
+    video->pool = malloc(VIDEO_POOL * FRAME_SIZE);
+    if (video->pool == NULL) {
+        free(video);
+        return NULL;
+    }
+    if (format == -1)
+        format = has_suffix(file, ".y4m") ? VIDEO_Y4M : VIDEO_RGBA;
+    video->format = format;
+
+    if (strcmp(file, "-") == 0) {
+        video->out = stdout;
+    } else {
+        video->out = fopen(file, "wb");
+        video->close_out = 1;
+    }
+    if (video->out == NULL) {
+        free(video->pool);
+        free(video);
+        return NULL;
+    }
+    if (format == VIDEO_Y4M) {
+        fprintf(video->out, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 Cmono\n",
+                VIDEO_WIDTH, VIDEO_HEIGHT);
+    }
+
+    for (int k = 0; k < VIDEO_POOL; k++) {
+        ring_push(&video->free, k);
+    }
+    if (pthread_create(&video->writer, NULL, writer_main, video)) {
+        if (video->close_out)
+            fclose(video->out);
+        free(video->pool);
+        free(video);
+        return NULL;
+    }
+    return video;
+}
+
+int
+video_frame(struct video_t* video, const struct machine_t* cpu)
+{
+    if (__atomic_load_n(&video->error, __ATOMIC_ACQUIRE))
+        return 1;
+
+    /* Only when the writer is a whole pool behind there is no choice. */
+    int slot;
+    while ((slot = ring_pop(&video->free)) == -1) {
+        nap();
+    }
+
+    byte* frame = video->pool + slot * FRAME_SIZE;
+    if (cpu->esm) {
+        for (int k = 0; k < FRAME_SIZE; k++) {
+            frame[k] = cpu->screen[k] ? 255 : 0;
+        }
+    } else for (int y = 0; y < VIDEO_HEIGHT; y++) {
+        const char* row = cpu->screen + 64 * (y / 2);
+        for (int x = 0; x < VIDEO_WIDTH; x++) {
+            frame[VIDEO_WIDTH * y + x] = row[x / 2] ? 255 : 0;
+        }
+    }
+    ring_push(&video->pending, slot);
+    return 0;
+}
+
+int
+video_close(struct video_t* video)
+{
+    __atomic_store_n(&video->done, 1, __ATOMIC_RELEASE);
+    pthread_join(video->writer, NULL);
+    int error = video->error;
+    if (video->close_out && fclose(video->out))
+        error = 1;
+    free(video->pool);
+    free(video);
+    return error;
+}
@@ -0,0 +1,65 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VIDEO_H_
+#define VIDEO_H_
+
+#include "cpu.h"
+
+/* Every frame is 128x64. Low resolution frames are scaled up 2x. */
+#define VIDEO_WIDTH 128
+#define VIDEO_HEIGHT 64
+
+/* How many captured frames can be waiting to be written. */
+#define VIDEO_POOL 64
+
+/* Output formats. */
+#define VIDEO_RGBA 0 // Raw 32-bit RGBA pixels, no header.
+#define VIDEO_Y4M 1  // YUV4MPEG2, monochrome, 60 fps.
+
+/**
+ * Video dump. Frames are copied into a pool of preallocated buffers and
+ * handed to a writer thread through a lock free queue, so capturing a
+ * frame never waits for the disk unless the whole pool is pending.
+ */
+struct video_t;
+
+/**
+ * Start a video dump. The format is Y4M when the file name ends in .y4m,
+ * raw RGBA otherwise. The file name "-" writes to the standard output,
+ * as raw RGBA unless y4m is forced with format.
+ *
+ * @param file path of the output file.
+ * @param format VIDEO_RGBA or VIDEO_Y4M, or -1 to guess from the name.
+ * @return the video, or NULL on error.
+ */
+struct video_t* video_open(const char* file, int format);
+
+/**
+ * Capture the current screen of a machine as the next frame.
+ * @return 0 on success, != 0 if the video cannot be written anymore.
+ */
+int video_frame(struct video_t* video, const struct machine_t* cpu);
+
+/**
+ * Write every pending frame, stop the writer thread and close the file.
+ * @return 0 if every frame was written, != 0 on error.
+ */
+int video_close(struct video_t* video);
+
+#endif // VIDEO_H_
@@ -0,0 +1,142 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lib8/cpu.h>
+#include <lib8/rom.h>
+#include <lib8/analyze.h>
+#include <config.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Flag set by '--hex' */
+static int use_hexloader;
+
+/* getopt parameter structure. */
+static struct option long_options[] = {
+    { "help", no_argument, 0, 'h' },
+    { "version", no_argument, 0, 'v' },
+    { "hex", no_argument, &use_hexloader, 1 },
+    { "output", required_argument, 0, 'o' },
+    { 0, 0, 0, 0 }
+};
+
+static const char* block_kinds[] = {
+    "fall", "jump", "call", "ret", "skip", "exit", "indirect"
+};
+
+static void
+usage(const char* name)
+{
+    printf("Usage: %s [-h | --help] [-v | --version]\n", name);
+    printf("       %s [--hex] [-o | --output <analysis>] <file>\n", name);
+}
+
+/**
+ * Print a summary of the analysis followed by the control flow graph,
+ * one line per basic block.
+ */
+static void
+print_analysis(const struct analysis_t* an, const byte* mem)
+{
+    int code = 0, sprite = 0, data = 0, smc = 0, indirect = 0, last = 0x1FF;
+    for (int addr = 0x200; addr < MEMSIZ; addr++) {
+        if (mem[addr] || an->map[addr] & (AN_CODE | AN_SPRITE))
+            last = addr;
+    }
+    for (int addr = 0x200; addr <= last; addr++) {
+        byte flags = an->map[addr];
+        if (flags & AN_CODE)
+            code++;
+        else if (flags & AN_SPRITE)
+            sprite++;
+        else
+            data++;
+        smc += (flags & AN_SMC) != 0;
+        indirect += (flags & AN_INDIRECT) != 0;
+    }
+
+    printf("Code: %d bytes, sprites: %d bytes, data: %d bytes\n",
+            code, sprite, data);
+    printf("Basic blocks: %d\n", an->nblocks);
+    printf("Self-modifying stores: %d\n", smc);
+    printf("Unresolved BNNN jumps: %d\n\n", indirect);
+
+    for (int k = 0; k < an->nblocks; k++) {
+        const struct an_block_t* b = &an->blocks[k];
+        printf("0x%03x-0x%03x %-8s", b->start, b->end - 2,
+                block_kinds[b->kind]);
+        for (int s = 0; s < b->nsucc; s++) {
+            printf(" 0x%03x", b->succ[s]);
+        }
+        if (an->map[b->start] & AN_CALL)
+            printf(" (subroutine)");
+        printf("\n");
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    struct machine_t mac;
+    struct analysis_t an;
+    const char* output = NULL;
+
+    int indexptr, c;
+    while ((c = getopt_long(argc, argv, "hvo:", long_options, &indexptr)) != -1) {
+        switch (c) {
+            case 'h':
+                usage(argv[0]);
+                exit(0);
+            case 'v':
+                printf("%s\n", PACKAGE_STRING);
+                exit(0);
+            case 'o':
+                output = optarg;
+                break;
+            case 0:
+                break;
+            default:
+                exit(1);
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "%1$s: no file given. '%1$s -h' for help.\n", argv[0]);
+        exit(1);
+    }
+
+    init_machine(&mac);
+    if (use_hexloader ? load_hex(&mac, argv[optind])
+            : load_rom(&mac, argv[optind])) {
+        return 1;
+    }
+    if (analyze_memory(&an, mac.mem)) {
+        fprintf(stderr, "Not enough memory to analyze the ROM.\n");
+        return 1;
+    }
+
+    print_analysis(&an, mac.mem);
+    if (output && save_analysis(&an, output)) {
+        fprintf(stderr, "Cannot write analysis to %s.\n", output);
+        free_analysis(&an);
+        return 1;
+    }
+    free_analysis(&an);
+    return 0;
+}
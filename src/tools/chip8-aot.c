@@ -0,0 +1,158 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <lib8/cpu.h>
+#include <lib8/rom.h>
+#include <lib8/analyze.h>
+#include <lib8/aot.h>
+#include <config.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Flag set by '--hex' */
+static int use_hexloader;
+
+/* getopt parameter structure. */
+static struct option long_options[] = {
+    { "help", no_argument, 0, 'h' },
+    { "version", no_argument, 0, 'v' },
+    { "hex", no_argument, &use_hexloader, 1 },
+    { "output", required_argument, 0, 'o' },
+    { "source", required_argument, 0, 's' },
+    { "cc", required_argument, 0, 'c' },
+    { "quirks", required_argument, 0, 'q' },
+    { 0, 0, 0, 0 }
+};
+
+static void
+usage(const char* name)
+{
+    printf("Usage: %s [-h | --help] [-v | --version]\n", name);
+    printf("       %s [--hex] [-o | --output <module.so>] [-s | --source <file.c>]\n",
+            name);
+    printf("       %*c [--cc <compiler>] [--quirks <profile>] <file>\n",
+            (int) strlen(name), ' ');
+}
+
+/**
+ * Build the generated source into a shared object with the system C
+ * compiler. The compiler is taken from --cc, then $CC, then 'cc'.
+ */
+static int
+compile_module(const char* cc, const char* source, const char* output)
+{
+    size_t len = strlen(cc) + strlen(source) + strlen(output) + 64;
+    char* cmd = malloc(len);
+    if (cmd == NULL)
+        return 1;
+    snprintf(cmd, len, "%s -O2 -shared -fPIC -o '%s' '%s'", cc, output, source);
+    int status = system(cmd);
+    free(cmd);
+    return status != 0;
+}
+
+int
+main(int argc, char** argv)
+{
+    struct machine_t mac;
+    struct analysis_t an;
+    const char* output = "a.so";
+    const char* source = NULL;
+    const char* cc = getenv("CC");
+    char tmpsource[] = "/tmp/chip8-aot-XXXXXX.c";
+    int quirks = QUIRKS_DEFAULT;
+
+    int indexptr, c;
+    while ((c = getopt_long(argc, argv, "hvo:s:", long_options, &indexptr)) != -1) {
+        switch (c) {
+            case 'h':
+                usage(argv[0]);
+                exit(0);
+            case 'v':
+                printf("%s\n", PACKAGE_STRING);
+                exit(0);
+            case 'o':
+                output = optarg;
+                break;
+            case 's':
+                source = optarg;
+                break;
+            case 'c':
+                cc = optarg;
+                break;
+            case 'q':
+                if ((quirks = quirks_by_name(optarg)) == -1) {
+                    fprintf(stderr, "Unknown quirk profile %s.\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 0:
+                break;
+            default:
+                exit(1);
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "%1$s: no file given. '%1$s -h' for help.\n", argv[0]);
+        exit(1);
+    }
+    if (cc == NULL || *cc == 0)
+        cc = "cc";
+
+    init_machine(&mac);
+    if (use_hexloader ? load_hex(&mac, argv[optind])
+            : load_rom(&mac, argv[optind])) {
+        return 1;
+    }
+    if (analyze_memory(&an, mac.mem)) {
+        fprintf(stderr, "Not enough memory to analyze the ROM.\n");
+        return 1;
+    }
+
+    /* Keep the C source only if it was asked for. */
+    FILE* out;
+    if (source) {
+        out = fopen(source, "w");
+    } else {
+        int fd = mkstemps(tmpsource, 2);
+        out = fd == -1 ? NULL : fdopen(fd, "w");
+    }
+    if (out == NULL) {
+        fprintf(stderr, "Cannot write C source.\n");
+        free_analysis(&an);
+        return 1;
+    }
+    int blocks = aot_generate(out, mac.mem, &an, quirks);
+    fclose(out);
+    printf("Compiled %d of %d basic blocks.\n", blocks, an.nblocks);
+    free_analysis(&an);
+
+    int status = compile_module(cc, source ? source : tmpsource, output);
+    if (!source)
+        remove(tmpsource);
+    if (status) {
+        fprintf(stderr, "Cannot build %s with %s.\n", output, cc);
+        return 1;
+    }
+    return 0;
+}
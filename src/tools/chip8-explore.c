@@ -0,0 +1,221 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <lib8/cpu.h>
+#include <lib8/rom.h>
+#include <lib8/expr.h>
+#include <lib8/explore.h>
+#include <config.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Flag set by '--hex' */
+static int use_hexloader;
+
+/* getopt parameter structure. */
+static struct option long_options[] = {
+    { "help", no_argument, 0, 'h' },
+    { "version", no_argument, 0, 'v' },
+    { "hex", no_argument, &use_hexloader, 1 },
+    { "goal", required_argument, 0, 'g' },
+    { "score", required_argument, 0, 'o' },
+    { "order", required_argument, 0, 'b' },
+    { "keys", required_argument, 0, 'k' },
+    { "frames", required_argument, 0, 'f' },
+    { "steps", required_argument, 0, 's' },
+    { "depth", required_argument, 0, 'd' },
+    { "max-states", required_argument, 0, 'n' },
+    { "threads", required_argument, 0, 't' },
+    { "seed", required_argument, 0, 'r' },
+    { "quirks", required_argument, 0, 'q' },
+    { 0, 0, 0, 0 }
+};
+
+static void
+usage(const char* name)
+{
+    int pad = (int) strlen(name);
+    printf("Usage: %s [-h | --help] [-v | --version]\n", name);
+    printf("       %s --goal <expr> [--score <expr>] [--order bfs|best]\n", name);
+    printf("       %*c [--keys <hex digits>] [--frames <n>] [--steps <n>]\n", pad, ' ');
+    printf("       %*c [--depth <n>] [--max-states <n>] [--threads <n>]\n", pad, ' ');
+    printf("       %*c [--seed <n>] [--quirks <profile>] [--hex] <file>\n", pad, ' ');
+    printf("\nSearches the keys that take the ROM to a state where the goal\n");
+    printf("expression is not 0, such as 'mem[0x3F0] >= 10 && v3 == 7'. The\n");
+    printf("solution is printed as a key script for chip8-run --keys.\n");
+}
+
+static struct expr_t*
+compile(const char* text)
+{
+    size_t offset;
+    struct expr_t* expr = expr_parse(text, &offset);
+    if (expr == NULL) {
+        fprintf(stderr, "Syntax error in '%s' at offset %zu.\n", text, offset);
+        exit(1);
+    }
+    return expr;
+}
+
+/* Choices are no key, and every key of the list held alone. */
+static int
+parse_keys(const char* list, word* choices)
+{
+    int n = 0;
+    choices[n++] = 0;
+    for (; *list; list++) {
+        char digit[2] = { *list, 0 };
+        char* end;
+        long key = strtol(digit, &end, 16);
+        if (*end || n == 17)
+            return -1;
+        choices[n++] = 1 << key;
+    }
+    return n;
+}
+
+int
+main(int argc, char** argv)
+{
+    static struct machine_t machine;
+    static word choices[17];
+    struct explore_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.order = EXPLORE_BFS;
+    config.threads = sysconf(_SC_NPROCESSORS_ONLN);
+    config.frames = 6;
+    config.steps = 16;
+    config.max_states = 200000;
+    config.max_depth = 100;
+    config.choices = choices;
+    config.nchoices = parse_keys("0123456789ABCDEF", choices);
+    unsigned long seed = 0;
+    int quirks = QUIRKS_DEFAULT;
+    const char* goal_text = NULL;
+
+    int indexptr, c;
+    while ((c = getopt_long(argc, argv, "hv", long_options, &indexptr)) != -1) {
+        switch (c) {
+            case 'h':
+                usage(argv[0]);
+                exit(0);
+            case 'v':
+                printf("%s\n", PACKAGE_STRING);
+                exit(0);
+            case 'g':
+                goal_text = optarg;
+                config.goal = compile(optarg);
+                break;
+            case 'o':
+                config.score = compile(optarg);
+                break;
+            case 'b':
+                if (strcmp(optarg, "bfs") && strcmp(optarg, "best")) {
+                    fprintf(stderr, "Unknown search order %s.\n", optarg);
+                    exit(1);
+                }
+                config.order = strcmp(optarg, "best") ? EXPLORE_BFS : EXPLORE_BEST;
+                break;
+            case 'k':
+                if ((config.nchoices = parse_keys(optarg, choices)) < 0) {
+                    fprintf(stderr, "Keys must be hex digits, such as 2468.\n");
+                    exit(1);
+                }
+                break;
+            case 'f':
+                config.frames = strtol(optarg, NULL, 0);
+                break;
+            case 's':
+                config.steps = strtol(optarg, NULL, 0);
+                break;
+            case 'd':
+                config.max_depth = strtol(optarg, NULL, 0);
+                break;
+            case 'n':
+                config.max_states = strtol(optarg, NULL, 0);
+                break;
+            case 't':
+                config.threads = strtol(optarg, NULL, 0);
+                break;
+            case 'r':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'q':
+                if ((quirks = quirks_by_name(optarg)) == -1) {
+                    fprintf(stderr, "Unknown quirk profile %s.\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 0:
+                break;
+            default:
+                exit(1);
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "%1$s: no file given. '%1$s -h' for help.\n", argv[0]);
+        exit(1);
+    }
+    if (config.goal == NULL) {
+        fprintf(stderr, "%1$s: no goal given. '%1$s -h' for help.\n", argv[0]);
+        exit(1);
+    }
+    if (config.max_depth < 1 || config.max_depth > 65535 || config.frames < 1) {
+        fprintf(stderr, "Depth must be 1-65535 and frames at least 1.\n");
+        exit(1);
+    }
+
+    /* Boot exactly as chip8-run does, so the solution replays there. */
+    init_machine(&machine);
+    set_quirks(&machine, quirks);
+    seed_machine(&machine, seed);
+    if (use_hexloader ? load_hex(&machine, argv[optind])
+            : load_rom(&machine, argv[optind])) {
+        return 1;
+    }
+
+    word* path = malloc(config.max_depth * sizeof(word));
+    struct explore_result_t result;
+    if (path == NULL || explore_run(&machine, &config, path, &result)) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+    fprintf(stderr, "%ld states, %ld expanded, %ld duplicates pruned.\n",
+            result.states, result.expanded, result.duplicates);
+    if (!result.found) {
+        fprintf(stderr, "No state meets the goal%s.\n",
+                result.states >= config.max_states ? " within --max-states" : "");
+        return 1;
+    }
+
+    printf("# %s, seed %lu: '%s' after %d decisions, at frame %d.\n",
+            argv[optind], seed, goal_text, result.depth,
+            result.depth * config.frames);
+    for (int k = 0; k < result.depth; k++) {
+        if (k == 0 || path[k] != path[k - 1])
+            printf("%d %04x\n", k * config.frames, path[k]);
+    }
+    free(path);
+    return 0;
+}
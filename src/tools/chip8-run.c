@@ -0,0 +1,247 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <lib8/cpu.h>
+#include <lib8/rom.h>
+#include <lib8/aot.h>
+#include <lib8/video.h>
+#include <lib8/guard.h>
+#include <lib8/share.h>
+#include <config.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_INPUTS 1024
+
+/* Flag set by '--hex' */
+static int use_hexloader;
+
+/* Flag set by '--guard' */
+static int use_guard;
+
+/* getopt parameter structure. */
+static struct option long_options[] = {
+    { "help", no_argument, 0, 'h' },
+    { "version", no_argument, 0, 'v' },
+    { "hex", no_argument, &use_hexloader, 1 },
+    { "guard", no_argument, &use_guard, 1 },
+    { "frames", required_argument, 0, 'f' },
+    { "steps", required_argument, 0, 's' },
+    { "seed", required_argument, 0, 'r' },
+    { "keys", required_argument, 0, 'k' },
+    { "aot", required_argument, 0, 'c' },
+    { "dump-video", required_argument, 0, 'd' },
+    { "quirks", required_argument, 0, 'q' },
+    { "share", required_argument, 0, 'm' },
+    { "timing", required_argument, 0, 't' },
+    { 0, 0, 0, 0 }
+};
+
+/* Keys held down from a frame on. */
+struct input_t
+{
+    long frame;
+    word keys;
+};
+
+static struct input_t inputs[MAX_INPUTS];
+static int ninputs;
+
+static void
+usage(const char* name)
+{
+    printf("Usage: %s [-h | --help] [-v | --version]\n", name);
+    printf("       %s [--hex] [--frames <n>] [--steps <n>] [--seed <n>]\n", name);
+    printf("       %*c [--keys <script>] [--aot <module>] [--dump-video <file>]\n",
+            (int) strlen(name), ' ');
+    printf("       %*c [--quirks <profile>] [--guard] [--share <name>]\n",
+            (int) strlen(name), ' ');
+    printf("       %*c [--timing <model>] <file>\n", (int) strlen(name), ' ');
+}
+
+/**
+ * Read a key script. Every line is a frame number and the keys, as a
+ * 16-bit hex mask, held down from that frame on. Lines starting with '#'
+ * are comments.
+ */
+static int
+read_inputs(const char* file)
+{
+    FILE* in = fopen(file, "r");
+    if (in == NULL)
+        return 1;
+    char line[128];
+    while (fgets(line, sizeof(line), in) && ninputs < MAX_INPUTS) {
+        long frame;
+        unsigned int keys;
+        if (line[0] == '#' || sscanf(line, "%ld %x", &frame, &keys) != 2)
+            continue;
+        inputs[ninputs].frame = frame;
+        inputs[ninputs].keys = keys;
+        ninputs++;
+    }
+    fclose(in);
+    return 0;
+}
+
+int
+main(int argc, char** argv)
+{
+    static struct machine_t machine;
+    long frames = 600, steps = 16;
+    unsigned long seed = 0;
+    const char* keys_file = NULL;
+    const char* aot_file = NULL;
+    const char* video_file = NULL;
+    const char* share_name = NULL;
+    int quirks = QUIRKS_DEFAULT;
+    int timing = TIMING_FIXED;
+
+    int indexptr, c;
+    while ((c = getopt_long(argc, argv, "hv", long_options, &indexptr)) != -1) {
+        switch (c) {
+            case 'h':
+                usage(argv[0]);
+                exit(0);
+            case 'v':
+                printf("%s\n", PACKAGE_STRING);
+                exit(0);
+            case 'f':
+                frames = strtol(optarg, NULL, 0);
+                break;
+            case 's':
+                steps = strtol(optarg, NULL, 0);
+                break;
+            case 'r':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                keys_file = optarg;
+                break;
+            case 'c':
+                aot_file = optarg;
+                break;
+            case 'd':
+                video_file = optarg;
+                break;
+            case 'm':
+                share_name = optarg;
+                break;
+            case 'q':
+                if ((quirks = quirks_by_name(optarg)) == -1) {
+                    fprintf(stderr, "Unknown quirk profile %s.\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 't':
+                if ((timing = timing_by_name(optarg)) == -1) {
+                    fprintf(stderr, "Unknown timing model %s.\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 0:
+                break;
+            default:
+                exit(1);
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "%1$s: no file given. '%1$s -h' for help.\n", argv[0]);
+        exit(1);
+    }
+    if (keys_file && read_inputs(keys_file)) {
+        fprintf(stderr, "Cannot read key script %s.\n", keys_file);
+        return 1;
+    }
+
+    /* A guard page makes stray memory accesses crash right away. */
+    struct machine_t* mac = &machine;
+    if (use_guard && (mac = guard_create()) == NULL) {
+        fprintf(stderr, "Cannot allocate a guarded machine.\n");
+        return 1;
+    }
+    if (!use_guard)
+        init_machine(mac);
+    set_quirks(mac, quirks);
+    seed_machine(mac, seed);
+    if (use_hexloader ? load_hex(mac, argv[optind])
+            : load_rom(mac, argv[optind])) {
+        return 1;
+    }
+    if (aot_file && aot_load(mac, aot_file)) {
+        fprintf(stderr, "Cannot use native module %s, interpreting.\n", aot_file);
+    }
+
+    struct video_t* video = NULL;
+    if (video_file && (video = video_open(video_file, -1)) == NULL) {
+        fprintf(stderr, "Cannot write video to %s.\n", video_file);
+        aot_unload(mac);
+        return 1;
+    }
+
+    struct share_segment_t* share = NULL;
+    if (share_name && (share = share_create(share_name)) == NULL) {
+        fprintf(stderr, "Cannot share frames in %s.\n", share_name);
+        if (video)
+            video_close(video);
+        aot_unload(mac);
+        return 1;
+    }
+
+    int input = 0, status = 0;
+    word keys = 0;
+    long frame;
+    for (frame = 0; frame < frames && !mac->exit; frame++) {
+        while (input < ninputs && inputs[input].frame <= frame) {
+            keys = inputs[input++].keys;
+        }
+        mac->keypad = share ? keys | share_keys(share) : keys;
+        if (timing == TIMING_FIXED)
+            run_machine(mac, steps);
+        else
+            run_vip_frame(mac, timing == TIMING_VIP_VBLANK);
+        tick_timers(mac);
+        if (share)
+            share_publish(share, mac);
+        if (video && video_frame(video, mac)) {
+            fprintf(stderr, "Error writing video to %s.\n", video_file);
+            status = 1;
+            break;
+        }
+    }
+    if (video && video_close(video)) {
+        fprintf(stderr, "Error writing video to %s.\n", video_file);
+        status = 1;
+    }
+    if (share)
+        share_destroy(share, share_name);
+    aot_unload(mac);
+
+    /* Keep stdout clean when the video goes there. */
+    FILE* report = video_file && strcmp(video_file, "-") == 0 ? stderr : stdout;
+    fprintf(report, "Frames: %ld\n", frame);
+    fprintf(report, "PC: 0x%03x, I: 0x%03x\n", mac->pc, mac->i);
+    fprintf(report, "Screen hash: %016llx\n",
+            (unsigned long long) screen_hash(mac));
+    if (use_guard)
+        guard_destroy(mac);
+    return status;
+}
@@ -0,0 +1,261 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File: tests/analyze.c
+ * Description: Unit test related to the static ROM analyzer.
+ */
+
+#include <check.h>
+#include <stdio.h>
+#include <string.h>
+#include <lib8/analyze.h>
+#include "program.h"
+
+static struct machine_t cpu;
+static struct analysis_t an;
+
+/*
+ * 0x200: A20E  LD I, 0x20E
+ * 0x202: 6000  LD V0, 0
+ * 0x204: 7001  ADD V0, 1
+ * 0x206: 2210  CALL 0x210
+ * 0x208: B20B  JP V0, 0x20B
+ * 0x20A: 0000  (data)
+ * 0x20C: D011  DRW V0, V1, 1
+ * 0x20E: 00FD  EXIT (also the sprite drawn above)
+ * 0x210: A202  LD I, 0x202
+ * 0x212: F033  LD B, V0 (overwrites 0x202..0x204)
+ * 0x214: 00EE  RET
+ */
+static word program[] = {
+    0xA20E, 0x6000, 0x7001, 0x2210, 0xB20B, 0x0000, 0xD011, 0x00FD,
+    0xA202, 0xF033, 0x00EE
+};
+
+static void
+setup_analysis(void)
+{
+    init_machine(&cpu);
+    load_program(&cpu, program, 11);
+    ck_assert_int_eq(0, analyze_memory(&an, cpu.mem));
+}
+
+static void
+teardown_analysis(void)
+{
+    free_analysis(&an);
+}
+
+static TCase*
+setup_tcase(char* name)
+{
+    TCase* tcase = tcase_create(name);
+    tcase_add_checked_fixture(tcase, setup_analysis, teardown_analysis);
+    return tcase;
+}
+
+/* Bytes should be classified as code, sprite or data. */
+START_TEST(test_analyze_map)
+{
+    ck_assert_int_ne(0, an.map[0x200] & AN_CODE);
+    ck_assert_int_ne(0, an.map[0x214] & AN_CODE);
+    ck_assert_int_eq(0, an.map[0x20A] & (AN_CODE | AN_SPRITE));
+    ck_assert_int_eq(0, an.map[0x20C] & AN_CODE);
+    ck_assert_int_ne(0, an.map[0x210] & AN_CALL);
+}
+END_TEST
+
+/* Stores into code should be flagged, as well as the code they hit. */
+START_TEST(test_analyze_smc)
+{
+    ck_assert_int_ne(0, an.map[0x212] & AN_SMC);
+    ck_assert_int_ne(0, an.map[0x202] & AN_WRITTEN);
+    ck_assert_int_ne(0, an.map[0x204] & AN_WRITTEN);
+    ck_assert_int_eq(0, an.map[0x205] & AN_WRITTEN);
+}
+END_TEST
+
+static TCase*
+tcase_analyze_map()
+{
+    TCase* tcase = setup_tcase("Map");
+    tcase_add_test(tcase, test_analyze_map);
+    tcase_add_test(tcase, test_analyze_smc);
+    return tcase;
+}
+
+/* The control flow graph should follow calls, returns and BNNN. */
+START_TEST(test_analyze_blocks)
+{
+    const struct an_block_t* b = find_block(&an, 0x200);
+    ck_assert_ptr_ne(NULL, b);
+    ck_assert_int_eq(AN_END_CALL, b->kind);
+    ck_assert_int_eq(0x208, b->end);
+    ck_assert_int_eq(2, b->nsucc);
+    ck_assert_int_eq(0x210, b->succ[0]);
+    ck_assert_int_eq(0x208, b->succ[1]);
+
+    /* V0 is unknown after the call, so BNNN cannot be resolved. */
+    b = find_block(&an, 0x208);
+    ck_assert_int_eq(AN_END_INDIRECT, b->kind);
+    ck_assert_int_ne(0, an.map[0x208] & AN_INDIRECT);
+    ck_assert_ptr_eq(NULL, find_block(&an, 0x20C));
+
+    b = find_block(&an, 0x210);
+    ck_assert_int_eq(AN_END_RET, b->kind);
+    ck_assert_int_eq(0x216, b->end);
+}
+END_TEST
+
+/* Conditional skips should end a block with two successors. */
+START_TEST(test_analyze_skip)
+{
+    cpu.mem[0x204] = 0x30;      /* 0x204: SE V0, 0 */
+    cpu.mem[0x205] = 0x00;
+    free_analysis(&an);
+    ck_assert_int_eq(0, analyze_memory(&an, cpu.mem));
+    const struct an_block_t* b = find_block(&an, 0x200);
+    ck_assert_int_eq(AN_END_SKIP, b->kind);
+    ck_assert_int_eq(0x206, b->succ[0]);
+    ck_assert_int_eq(0x208, b->succ[1]);
+    ck_assert_int_ne(0, an.map[0x208] & AN_LEADER);
+}
+END_TEST
+
+/* BNNN with a constant V0 should be followed, finding the sprite. */
+START_TEST(test_analyze_bnnn)
+{
+    cpu.mem[0x206] = 0x12;      /* 0x206: JP 0x208 instead of the call. */
+    cpu.mem[0x207] = 0x08;
+    free_analysis(&an);
+    ck_assert_int_eq(0, analyze_memory(&an, cpu.mem));
+    const struct an_block_t* b = find_block(&an, 0x208);
+    ck_assert_int_eq(AN_END_JUMP, b->kind);
+    ck_assert_int_eq(0x20C, b->succ[0]);
+    ck_assert_int_ne(0, an.map[0x20C] & AN_CODE);
+    ck_assert_int_ne(0, an.map[0x20E] & AN_SPRITE);
+    ck_assert_int_eq(0, an.map[0x20F] & AN_SPRITE);
+}
+END_TEST
+
+/* Replace the program and analyze it again. */
+static void
+reanalyze(const word* code, int n)
+{
+    memset(cpu.mem + 0x200, 0, 0x20);
+    load_program(&cpu, code, n);
+    free_analysis(&an);
+    ck_assert_int_eq(0, analyze_memory(&an, cpu.mem));
+}
+
+/* A BNNN reached with two values of V0 should be left unresolved. */
+START_TEST(test_analyze_bnnn_paths)
+{
+    /*
+     * 0x200: 6000  LD V0, 0
+     * 0x202: 3100  SE V1, 0
+     * 0x204: 6002  LD V0, 2
+     * 0x206: B20A  JP V0, 0x20A (0x20A or 0x20C)
+     * 0x208: 0000  (data)
+     * 0x20A: 00FD  EXIT
+     * 0x20C: 00FD  EXIT
+     */
+    static const word code[] = {
+        0x6000, 0x3100, 0x6002, 0xB20A, 0x0000, 0x00FD, 0x00FD
+    };
+    reanalyze(code, 7);
+    ck_assert_int_ne(0, an.map[0x206] & AN_INDIRECT);
+    const struct an_block_t* b = find_block(&an, 0x206);
+    ck_assert_ptr_ne(NULL, b);
+    ck_assert_int_eq(AN_END_INDIRECT, b->kind);
+}
+END_TEST
+
+/* A store should be checked against the I of every path reaching it. */
+START_TEST(test_analyze_smc_paths)
+{
+    /*
+     * 0x200: A300  LD I, 0x300
+     * 0x202: 3100  SE V1, 0
+     * 0x204: A20C  LD I, 0x20C
+     * 0x206: F033  LD B, V0 (overwrites 0x300 or 0x20C..0x20E)
+     * 0x208: 120C  JP 0x20C
+     * 0x20A: 0000  (data)
+     * 0x20C: 00FD  EXIT
+     */
+    static const word code[] = {
+        0xA300, 0x3100, 0xA20C, 0xF033, 0x120C, 0x0000, 0x00FD
+    };
+    reanalyze(code, 7);
+    ck_assert_int_ne(0, an.map[0x206] & AN_SMC);
+    ck_assert_int_ne(0, an.map[0x20C] & AN_WRITTEN);
+    ck_assert_int_eq(0, an.map[0x300] & AN_WRITTEN);
+}
+END_TEST
+
+static TCase*
+tcase_analyze_blocks()
+{
+    TCase* tcase = setup_tcase("Blocks");
+    tcase_add_test(tcase, test_analyze_blocks);
+    tcase_add_test(tcase, test_analyze_skip);
+    tcase_add_test(tcase, test_analyze_bnnn);
+    tcase_add_test(tcase, test_analyze_bnnn_paths);
+    tcase_add_test(tcase, test_analyze_smc_paths);
+    return tcase;
+}
+
+/* An analysis should survive a round trip through a file. */
+START_TEST(test_analyze_file)
+{
+    struct analysis_t loaded;
+    ck_assert_int_eq(0, save_analysis(&an, "analysis.tmp"));
+    ck_assert_int_eq(0, load_analysis(&loaded, "analysis.tmp"));
+    remove("analysis.tmp");
+    ck_assert_int_eq(an.checksum, loaded.checksum);
+    ck_assert_int_eq(analysis_checksum(cpu.mem), loaded.checksum);
+    ck_assert_int_eq(0, memcmp(an.map, loaded.map, MEMSIZ));
+    ck_assert_int_eq(an.nblocks, loaded.nblocks);
+    for (int k = 0; k < an.nblocks; k++) {
+        ck_assert_int_eq(an.blocks[k].start, loaded.blocks[k].start);
+        ck_assert_int_eq(an.blocks[k].end, loaded.blocks[k].end);
+        ck_assert_int_eq(an.blocks[k].kind, loaded.blocks[k].kind);
+        ck_assert_int_eq(an.blocks[k].succ[1], loaded.blocks[k].succ[1]);
+    }
+    free_analysis(&loaded);
+}
+END_TEST
+
+static TCase*
+tcase_analyze_file()
+{
+    TCase* tcase = setup_tcase("File");
+    tcase_add_test(tcase, test_analyze_file);
+    return tcase;
+}
+
+Suite*
+create_analyze_suite()
+{
+    Suite* suite = suite_create("Analyzer");
+    suite_add_tcase(suite, tcase_analyze_map());
+    suite_add_tcase(suite, tcase_analyze_blocks());
+    suite_add_tcase(suite, tcase_analyze_file());
+    return suite;
+}
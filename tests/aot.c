@@ -0,0 +1,179 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File: tests/aot.c
+ * Description: Unit test related to the ahead of time compiler.
+ */
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <lib8/aot.h>
+#include <lib8/compact.h>
+#include "program.h"
+
+static struct machine_t cpu, ref;
+static struct analysis_t an;
+
+/*
+ * 0x200: 6000  LD V0, 0
+ * 0x202: 7001  ADD V0, 1
+ * 0x204: A300  LD I, 0x300
+ * 0x206: F055  LD [I], V0
+ * 0x208: 3040  SE V0, 0x40
+ * 0x20A: 1202  JP 0x202
+ * 0x20C: 00FD  EXIT
+ */
+static word program[] = {
+    0x6000, 0x7001, 0xA300, 0xF055, 0x3040, 0x1202, 0x00FD
+};
+
+/* Build the program into aot.tmp.so. Returns != 0 if there is no cc. */
+static int
+build_program(void)
+{
+    FILE* out = fopen("aot.tmp.c", "w");
+    ck_assert_ptr_ne(NULL, out);
+    ck_assert_int_eq(an.nblocks, aot_generate(out, cpu.mem, &an, cpu.quirks));
+    fclose(out);
+    int status = system("cc -O2 -shared -fPIC -o aot.tmp.so aot.tmp.c");
+    remove("aot.tmp.c");
+    return status;
+}
+
+static void
+setup_aot(void)
+{
+    init_machine(&cpu);
+    load_program(&cpu, program, 7);
+    init_machine(&ref);
+    load_program(&ref, program, 7);
+    ck_assert_int_eq(0, analyze_memory(&an, cpu.mem));
+}
+
+static void
+teardown_aot(void)
+{
+    aot_unload(&cpu);
+    free_analysis(&an);
+    remove("aot.tmp.so");
+}
+
+/* Blocks overwritten by the program itself should not be compiled. */
+START_TEST(test_aot_written)
+{
+    FILE* out = tmpfile();
+    an.map[0x208] |= AN_WRITTEN;
+    ck_assert_int_eq(an.nblocks - 1, aot_generate(out, cpu.mem, &an, cpu.quirks));
+    fclose(out);
+}
+END_TEST
+
+/* Native code should leave the machine as the interpreter does. */
+START_TEST(test_aot_run)
+{
+    if (build_program())
+        return;
+    ck_assert_int_eq(0, aot_load(&cpu, "./aot.tmp.so"));
+    for (int k = 0; k < 300; k++) {
+        step_machine(&ref);
+    }
+    for (int k = 0; k < 30; k++) {
+        run_machine(&cpu, 10);
+    }
+    ck_assert_int_eq(ref.pc, cpu.pc);
+    ck_assert_int_eq(ref.i, cpu.i);
+    ck_assert_int_eq(ref.v[0], cpu.v[0]);
+    ck_assert_int_eq(ref.mem[0x300], cpu.mem[0x300]);
+    ck_assert_int_eq(ref.exit, cpu.exit);
+}
+END_TEST
+
+/* Invalidated blocks should go back to the interpreter. */
+START_TEST(test_aot_invalidate)
+{
+    if (build_program())
+        return;
+    ck_assert_int_eq(0, aot_load(&cpu, "./aot.tmp.so"));
+    cpu.pc = 0x202;
+    ck_assert_int_lt(aot_run(&cpu, 10), 10);
+    cpu.pc = 0x202;
+    aot_invalidate(&cpu, 0x208, 1);
+    ck_assert_int_eq(10, aot_run(&cpu, 10));
+}
+END_TEST
+
+/* A module built for another ROM should be rejected. */
+START_TEST(test_aot_checksum)
+{
+    if (build_program())
+        return;
+    cpu.mem[0x20C] = 0x12;
+    ck_assert_int_ne(0, aot_load(&cpu, "./aot.tmp.so"));
+    ck_assert_ptr_eq(NULL, cpu.aot);
+}
+END_TEST
+
+/* A pool booted from a machine with native code should leave it alone. */
+START_TEST(test_aot_pool)
+{
+    if (build_program())
+        return;
+    ck_assert_int_eq(0, aot_load(&cpu, "./aot.tmp.so"));
+    struct pool_t* pool = pool_create(2, &cpu, 10, 0);
+    ck_assert_ptr_ne(NULL, pool);
+    for (int k = 0; k < 30; k++) {
+        pool_run_frame(pool, NULL);
+        run_machine(&ref, 10);
+        tick_timers(&ref);
+    }
+    for (int k = 0; k < 2; k++) {
+        struct compact_t* mac = pool_machine(pool, k);
+        ck_assert_int_eq(ref.pc, mac->regs.pc);
+        ck_assert_int_eq(ref.v[0], mac->regs.v[0]);
+        ck_assert_int_eq(ref.mem[0x300], mac->mem[0x300]);
+    }
+    pool_destroy(pool);
+
+    ck_assert_int_eq(0x200, cpu.pc);
+    ck_assert_int_eq(0, cpu.v[0]);
+    ck_assert_int_eq(0, cpu.mem[0x300]);
+}
+END_TEST
+
+static TCase*
+tcase_aot()
+{
+    TCase* tcase = tcase_create("AOT");
+    tcase_add_checked_fixture(tcase, setup_aot, teardown_aot);
+    tcase_add_test(tcase, test_aot_written);
+    tcase_add_test(tcase, test_aot_run);
+    tcase_add_test(tcase, test_aot_invalidate);
+    tcase_add_test(tcase, test_aot_checksum);
+    tcase_add_test(tcase, test_aot_pool);
+    return tcase;
+}
+
+Suite*
+create_aot_suite()
+{
+    Suite* suite = suite_create("AOT");
+    suite_add_tcase(suite, tcase_aot());
+    return suite;
+}
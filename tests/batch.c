@@ -0,0 +1,170 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File: tests/batch.c
+ * Description: Unit test related to batches of machines.
+ */
+
+#include <check.h>
+#include <string.h>
+#include <lib8/batch.h>
+#include "program.h"
+
+#define MACHINES 4
+
+static struct machine_t boot, single;
+static struct batch_t* batch;
+static byte obs[MACHINES * BATCH_OBS_SIZE];
+static byte done[MACHINES];
+
+/*
+ * 0x200: 6000  LD V0, 0
+ * 0x202: 6100  LD V1, 0
+ * 0x204: A050  LD I, 0x050 (font for 0)
+ * 0x206: E09E  SKP V0
+ * 0x208: 1204  JP 0x204
+ * 0x20A: D015  DRW V0, V1, 5
+ * 0x20C: 00FD  EXIT
+ */
+static word program[] = {
+    0x6000, 0x6100, 0xA050, 0xE09E, 0x1204, 0xD015, 0x00FD
+};
+
+static void
+setup_batch(void)
+{
+    init_machine(&boot);
+    load_program(&boot, program, 7);
+    batch = batch_create(MACHINES, &boot, 5, 0);
+    ck_assert_ptr_ne(NULL, batch);
+}
+
+static void
+teardown_batch(void)
+{
+    batch_destroy(batch);
+}
+
+/* Only the machine holding key 0 should reach the end. */
+START_TEST(test_batch_keys)
+{
+    word keys[MACHINES] = { 0, 1, 0, 0 };
+    ck_assert_int_eq(0, batch_run_frame(batch, keys, obs, done));
+    ck_assert_int_eq(0, batch_machine(batch, 0)->exit);
+    ck_assert_int_eq(1, batch_machine(batch, 1)->screen[0]);
+    ck_assert_int_eq(0, batch_machine(batch, 0)->screen[0]);
+
+    /* Upper left corner of a 0 is 1111 scaled to 11111111. */
+    ck_assert_int_eq(0xFF, obs[BATCH_OBS_SIZE]);
+    ck_assert_int_eq(0xFF, obs[BATCH_OBS_SIZE + 16]);
+    ck_assert_int_eq(0x00, obs[BATCH_OBS_SIZE + 1]);
+    ck_assert_int_eq(0x00, obs[0]);
+}
+END_TEST
+
+/* Machines that run 00FD should be reset to the boot state. */
+START_TEST(test_batch_reset)
+{
+    word keys[MACHINES] = { 0, 1, 0, 1 };
+    batch_run_frame(batch, keys, obs, done);
+    ck_assert_int_eq(2, batch_run_frame(batch, keys, obs, done));
+    ck_assert_int_eq(0, done[0]);
+    ck_assert_int_eq(1, done[1]);
+    ck_assert_int_eq(1, done[3]);
+    ck_assert_int_eq(0x200, batch_machine(batch, 1)->pc);
+    ck_assert_int_eq(0, batch_machine(batch, 1)->exit);
+    ck_assert_int_eq(0, obs[BATCH_OBS_SIZE]);
+}
+END_TEST
+
+static int
+drawn(const struct machine_t* cpu, void* data)
+{
+    (void) data;
+    return cpu->screen[0] != 0;
+}
+
+/* A terminal condition should reset machines too. */
+START_TEST(test_batch_terminal)
+{
+    word keys[MACHINES] = { 0, 1, 0, 0 };
+    batch_set_terminal(batch, drawn, NULL);
+    ck_assert_int_eq(1, batch_run_frame(batch, keys, NULL, done));
+    ck_assert_int_eq(1, done[1]);
+}
+END_TEST
+
+/* A batch should behave as machines run one at a time. */
+START_TEST(test_batch_single)
+{
+    word keys[MACHINES] = { 0, 0, 0, 0 };
+    memcpy(&single, &boot, sizeof(struct machine_t));
+    seed_machine(&single, 2);
+    for (int frame = 0; frame < 10; frame++) {
+        batch_run_frame(batch, keys, obs, done);
+        run_machine(&single, 5);
+        tick_timers(&single);
+    }
+    struct machine_t* cpu = batch_machine(batch, 2);
+    ck_assert_int_eq(single.pc, cpu->pc);
+    ck_assert_int_eq(single.rng, cpu->rng);
+    ck_assert_int_eq(0, memcmp(single.v, cpu->v, 16));
+
+    byte expected[BATCH_OBS_SIZE];
+    batch_observe(&single, expected);
+    ck_assert_int_eq(0, memcmp(expected, obs + 2 * BATCH_OBS_SIZE, BATCH_OBS_SIZE));
+}
+END_TEST
+
+/* High resolution screens should be packed as they are. */
+START_TEST(test_batch_observe_hires)
+{
+    byte packed[BATCH_OBS_SIZE];
+    single.esm = 1;
+    memset(single.screen, 0, sizeof(single.screen));
+    single.screen[0] = 1;
+    single.screen[9] = 1;
+    single.screen[128 * 63 + 127] = 1;
+    batch_observe(&single, packed);
+    ck_assert_int_eq(0x80, packed[0]);
+    ck_assert_int_eq(0x40, packed[1]);
+    ck_assert_int_eq(0x01, packed[BATCH_OBS_SIZE - 1]);
+}
+END_TEST
+
+static TCase*
+tcase_batch()
+{
+    TCase* tcase = tcase_create("Frames");
+    tcase_add_checked_fixture(tcase, setup_batch, teardown_batch);
+    tcase_add_test(tcase, test_batch_keys);
+    tcase_add_test(tcase, test_batch_reset);
+    tcase_add_test(tcase, test_batch_terminal);
+    tcase_add_test(tcase, test_batch_single);
+    tcase_add_test(tcase, test_batch_observe_hires);
+    return tcase;
+}
+
+Suite*
+create_batch_suite()
+{
+    Suite* suite = suite_create("Batch");
+    suite_add_tcase(suite, tcase_batch());
+    return suite;
+}
@@ -0,0 +1,169 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * File: tests/compact.c
+ * Description: Unit test related to compact machines.
+ */
+
+#include <check.h>
+#include <string.h>
+#include <lib8/compact.h>
+#include "program.h"
+
+#define MACHINES 4
+
+static struct machine_t boot, single[MACHINES], unpacked;
+static struct compact_t packed;
+
+/*
+ * 0x200: 00FF  HIGH
+ * 0x202: 6005  LD V0, 5
+ * 0x204: F015  LD DT, V0
+ * 0x206: C0FF  RND V0, 0xFF
+ * 0x208: A300  LD I, 0x300
+ * 0x20A: F033  LD B, V0
+ * 0x20C: A050  LD I, 0x050 (font for 0)
+ * 0x20E: D015  DRW V0, V1, 5
+ * 0x210: 7101  ADD V1, 1
+ * 0x212: 1206  JP 0x206
+ */
+static word program[] = {
+    0x00FF, 0x6005, 0xF015, 0xC0FF, 0xA300, 0xF033, 0xA050, 0xD015,
+    0x7101, 0x1206
+};
+
+static int
+always_down(char key)
+{
+    return 1;
+}
+
+static void
+setup_compact(void)
+{
+    init_machine(&boot);
+    load_program(&boot, program, 10);
+}
+
+/* Registers should fit a cache line and the whole machine half of one. */
+START_TEST(test_compact_size)
+{
+    ck_assert_int_eq(64, sizeof(struct compact_regs_t));
+    ck_assert_int_eq(0, sizeof(struct compact_t) % 64);
+    ck_assert(2 * sizeof(struct compact_t) < sizeof(struct machine_t));
+}
+END_TEST
+
+/* Packing and unpacking should keep every bit of state. */
+START_TEST(test_compact_roundtrip)
+{
+    memcpy(&single[0], &boot, sizeof(struct machine_t));
+    run_machine(&single[0], 40);
+    single[0].keypad = 0x1234;
+    single[0].wait_key = 3;
+    compact_pack(&packed, &single[0]);
+
+    struct host_t host = { always_down, NULL, NULL, NULL, QUIRKS_SCHIP };
+    memset(&unpacked, 0xAA, sizeof(struct machine_t));
+    compact_unpack(&unpacked, &packed, &host);
+    ck_assert_int_eq(single[0].pc, unpacked.pc);
+    ck_assert_int_eq(single[0].i, unpacked.i);
+    ck_assert_int_eq(single[0].dt, unpacked.dt);
+    ck_assert_int_eq(single[0].esm, unpacked.esm);
+    ck_assert_int_eq(single[0].rng, unpacked.rng);
+    ck_assert_int_eq(0x1234, unpacked.keypad);
+    ck_assert_int_eq(3, unpacked.wait_key);
+    ck_assert_int_eq(0, memcmp(single[0].v, unpacked.v, 16));
+    ck_assert_int_eq(0, memcmp(single[0].screen, unpacked.screen, 8192));
+    ck_assert_int_eq(0, memcmp(single[0].mem, unpacked.mem, MEMSIZ + MEMGUARD));
+    ck_assert(single[0].screen_key == unpacked.screen_key);
+    ck_assert_ptr_eq(always_down, unpacked.keydown);
+    ck_assert_int_eq(QUIRKS_SCHIP, unpacked.quirks);
+}
+END_TEST
+
+/* A pool should run as machines run one at a time. */
+START_TEST(test_compact_pool)
+{
+    struct pool_t* pool = pool_create(MACHINES, &boot, 7, 100);
+    ck_assert_ptr_ne(NULL, pool);
+    for (int k = 0; k < MACHINES; k++) {
+        memcpy(&single[k], &boot, sizeof(struct machine_t));
+        seed_machine(&single[k], 100 + k);
+    }
+    for (int frame = 0; frame < 30; frame++) {
+        pool_run_frame(pool, NULL);
+        for (int k = 0; k < MACHINES; k++) {
+            run_machine(&single[k], 7);
+            tick_timers(&single[k]);
+        }
+    }
+    for (int k = 0; k < MACHINES; k++) {
+        compact_unpack(&unpacked, pool_machine(pool, k), pool_host(pool));
+        ck_assert_int_eq(single[k].pc, unpacked.pc);
+        ck_assert_int_eq(single[k].dt, unpacked.dt);
+        ck_assert_int_eq(0, memcmp(single[k].v, unpacked.v, 16));
+        ck_assert_int_eq(0, memcmp(single[k].screen, unpacked.screen, 8192));
+        ck_assert_int_eq(0, memcmp(single[k].mem, unpacked.mem, MEMSIZ));
+    }
+    pool_destroy(pool);
+}
+END_TEST
+
+/* The hash should follow the state but not the keypad. */
+START_TEST(test_compact_hash)
+{
+    static struct compact_t other;
+    memcpy(&single[0], &boot, sizeof(struct machine_t));
+    run_machine(&single[0], 40);
+    compact_pack(&packed, &single[0]);
+
+    single[0].keypad = 0x0010;
+    compact_pack(&other, &single[0]);
+    ck_assert(compact_hash(&packed) == compact_hash(&other));
+
+    single[0].mem[0x301]++;
+    compact_pack(&other, &single[0]);
+    ck_assert(compact_hash(&packed) != compact_hash(&other));
+    single[0].mem[0x301]--;
+
+    run_machine(&single[0], 1);
+    compact_pack(&other, &single[0]);
+    ck_assert(compact_hash(&packed) != compact_hash(&other));
+}
+END_TEST
+
+static TCase*
+tcase_compact()
+{
+    TCase* tcase = tcase_create("Compact machines");
+    tcase_add_checked_fixture(tcase, setup_compact, NULL);
+    tcase_add_test(tcase, test_compact_size);
+    tcase_add_test(tcase, test_compact_roundtrip);
+    tcase_add_test(tcase, test_compact_pool);
+    tcase_add_test(tcase, test_compact_hash);
+    return tcase;
+}
+
+Suite*
+create_compact_suite()
+{
+    Suite* suite = suite_create("Compact");
+    suite_add_tcase(suite, tcase_compact());
+    return suite;
+}
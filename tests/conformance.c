@@ -0,0 +1,343 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File: tests/conformance.c
+ * Description: Run every ROM in examples/ headless and compare the state
+ * of the machine at fixed frames against the files in tests/golden.
+ *
+ * Usage: conformance [--update] [examples dir] [golden dir]
+ *
+ * Every ROM is run with the same seed and the keys given by golden/input.
+ * At each checkpoint the screen hash and the registers are hashed. With
+ * --update the golden files are written instead of checked. Machines are
+ * allocated with a guard page, so stray memory accesses crash the run.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <lib8/cpu.h>
+#include <lib8/rom.h>
+#include <lib8/guard.h>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STEPS_PER_FRAME 16  // About 1000 instructions per second.
+#define CHECKPOINT 60       // Frames between checkpoints.
+#define FRAMES 3600         // Frames run per ROM, one minute.
+#define CHECKPOINTS (FRAMES / CHECKPOINT)
+#define MAX_INPUTS 256
+#define SEED 0xC8
+
+/* Keys held down from a frame on. */
+struct input_t
+{
+    int frame;
+    word keys;
+};
+
+/* A ROM to run and what came out of it. */
+struct job_t
+{
+    char name[256];
+    uint64_t hash[CHECKPOINTS];
+    int failed;
+    char message[128];
+};
+
+static const char* examples_dir = "../examples";
+static const char* golden_dir = "golden";
+static int update;
+
+static struct input_t inputs[MAX_INPUTS];
+static int ninputs;
+
+static struct job_t* jobs;
+static int njobs;
+static int next_job;
+static pthread_mutex_t next_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* FNV-1a, 64 bit. */
+static uint64_t
+hash_bytes(uint64_t hash, const void* data, size_t len)
+{
+    const byte* bytes = data;
+    for (size_t k = 0; k < len; k++) {
+        hash ^= bytes[k];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static uint64_t
+hash_machine(const struct machine_t* cpu)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL ^ screen_hash(cpu);
+    hash = hash_bytes(hash, cpu->v, sizeof(cpu->v));
+    hash = hash_bytes(hash, cpu->stack, sizeof(cpu->stack));
+    hash = hash_bytes(hash, &cpu->pc, sizeof(cpu->pc));
+    hash = hash_bytes(hash, &cpu->i, sizeof(cpu->i));
+    hash = hash_bytes(hash, &cpu->sp, sizeof(cpu->sp));
+    hash = hash_bytes(hash, &cpu->dt, sizeof(cpu->dt));
+    hash = hash_bytes(hash, &cpu->st, sizeof(cpu->st));
+    hash = hash_bytes(hash, &cpu->esm, sizeof(cpu->esm));
+    return hash;
+}
+
+/**
+ * Read the input script. Every line is a frame number and the keys, as a
+ * 16-bit hex mask, held down from that frame on. Lines starting with '#'
+ * are comments.
+ */
+static int
+read_inputs(const char* file)
+{
+    FILE* in = fopen(file, "r");
+    if (in == NULL)
+        return 1;
+    char line[128];
+    while (fgets(line, sizeof(line), in) && ninputs < MAX_INPUTS) {
+        unsigned int frame, keys;
+        if (line[0] == '#' || sscanf(line, "%u %x", &frame, &keys) != 2)
+            continue;
+        inputs[ninputs].frame = frame;
+        inputs[ninputs].keys = keys;
+        ninputs++;
+    }
+    fclose(in);
+    return 0;
+}
+
+static void
+run_job(struct job_t* job)
+{
+    char path[512];
+    struct machine_t* cpu = guard_create();
+    if (cpu == NULL) {
+        job->failed = 1;
+        strcpy(job->message, "out of memory");
+        return;
+    }
+
+    seed_machine(cpu, SEED);
+    snprintf(path, sizeof(path), "%s/%s", examples_dir, job->name);
+    if (load_rom(cpu, path)) {
+        job->failed = 1;
+        strcpy(job->message, "cannot load ROM");
+        guard_destroy(cpu);
+        return;
+    }
+
+    int input = 0;
+    for (int frame = 0; frame < FRAMES; frame++) {
+        while (input < ninputs && inputs[input].frame <= frame) {
+            cpu->keypad = inputs[input++].keys;
+        }
+        run_machine(cpu, STEPS_PER_FRAME);
+        tick_timers(cpu);
+        if ((frame + 1) % CHECKPOINT == 0)
+            job->hash[frame / CHECKPOINT] = hash_machine(cpu);
+    }
+
+    /* The screen hash is kept incrementally, make sure it is right. */
+    uint64_t hash = screen_hash(cpu);
+    screen_rehash(cpu);
+    if (hash != screen_hash(cpu)) {
+        job->failed = 1;
+        strcpy(job->message, "screen hash out of date");
+    }
+    guard_destroy(cpu);
+}
+
+static void*
+worker(void* data)
+{
+    (void) data;
+    for (;;) {
+        pthread_mutex_lock(&next_lock);
+        int k = next_job++;
+        pthread_mutex_unlock(&next_lock);
+        if (k >= njobs)
+            return NULL;
+        run_job(&jobs[k]);
+    }
+}
+
+/* Compare a job against its golden file, or write it with --update. */
+static void
+check_job(struct job_t* job)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", golden_dir, job->name);
+    if (update) {
+        FILE* out = fopen(path, "w");
+        if (out == NULL) {
+            job->failed = 1;
+            strcpy(job->message, "cannot write golden file");
+            return;
+        }
+        fprintf(out, "# frame hash\n");
+        for (int k = 0; k < CHECKPOINTS; k++) {
+            fprintf(out, "%d %016llx\n", (k + 1) * CHECKPOINT,
+                    (unsigned long long) job->hash[k]);
+        }
+        fclose(out);
+        return;
+    }
+
+    FILE* in = fopen(path, "r");
+    if (in == NULL) {
+        job->failed = 1;
+        strcpy(job->message, "no golden file");
+        return;
+    }
+    char line[128];
+    int checked = 0;
+    while (fgets(line, sizeof(line), in)) {
+        int frame;
+        unsigned long long hash;
+        if (line[0] == '#' || sscanf(line, "%d %llx", &frame, &hash) != 2)
+            continue;
+        int k = frame / CHECKPOINT - 1;
+        if (k < 0 || k >= CHECKPOINTS || frame % CHECKPOINT)
+            continue;
+        if (job->hash[k] != hash) {
+            job->failed = 1;
+            snprintf(job->message, sizeof(job->message),
+                    "differs at frame %d", frame);
+            break;
+        }
+        checked++;
+    }
+    fclose(in);
+    if (!job->failed && checked != CHECKPOINTS) {
+        job->failed = 1;
+        strcpy(job->message, "incomplete golden file");
+    }
+}
+
+static int
+compare_names(const void* a, const void* b)
+{
+    return strcmp(((const struct job_t*) a)->name,
+            ((const struct job_t*) b)->name);
+}
+
+/* Make a job for every regular file in the examples directory. */
+static int
+list_roms(void)
+{
+    DIR* dir = opendir(examples_dir);
+    if (dir == NULL)
+        return 1;
+    struct dirent* entry;
+    int capacity = 0;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.')
+            continue;
+        if (njobs == capacity) {
+            capacity = capacity ? 2 * capacity : 32;
+            struct job_t* more = realloc(jobs, capacity * sizeof(struct job_t));
+            if (more == NULL) {
+                closedir(dir);
+                return 1;
+            }
+            jobs = more;
+        }
+        memset(&jobs[njobs], 0, sizeof(struct job_t));
+        snprintf(jobs[njobs].name, sizeof(jobs[njobs].name), "%s", entry->d_name);
+        njobs++;
+    }
+    closedir(dir);
+    qsort(jobs, njobs, sizeof(struct job_t), compare_names);
+    return 0;
+}
+
+int
+main(int argc, char** argv)
+{
+    char path[512];
+    int arg = 1;
+    if (arg < argc && strcmp(argv[arg], "--update") == 0) {
+        update = 1;
+        arg++;
+    }
+
+    /* Under 'make check' the sources may be somewhere else. */
+    static char srcdir_examples[512], srcdir_golden[512];
+    const char* srcdir = getenv("srcdir");
+    if (srcdir) {
+        snprintf(srcdir_examples, sizeof(srcdir_examples), "%s/../examples", srcdir);
+        snprintf(srcdir_golden, sizeof(srcdir_golden), "%s/golden", srcdir);
+        examples_dir = srcdir_examples;
+        golden_dir = srcdir_golden;
+    }
+    if (arg < argc)
+        examples_dir = argv[arg++];
+    if (arg < argc)
+        golden_dir = argv[arg++];
+
+    if (list_roms()) {
+        fprintf(stderr, "Cannot read ROMs from %s, skipping.\n", examples_dir);
+        return 77;
+    }
+    snprintf(path, sizeof(path), "%s/input", golden_dir);
+    if (read_inputs(path)) {
+        fprintf(stderr, "Cannot read input script %s.\n", path);
+        return 1;
+    }
+
+    /* Spread the ROMs over every core. */
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int nthreads = ncpu < 1 ? 1 : ncpu > njobs ? njobs : ncpu;
+    pthread_t* threads = malloc(nthreads * sizeof(pthread_t));
+    if (threads == NULL)
+        return 1;
+    for (int t = 0; t < nthreads; t++) {
+        if (pthread_create(&threads[t], NULL, worker, NULL)) {
+            nthreads = t;
+            break;
+        }
+    }
+    if (nthreads == 0)
+        worker(NULL);
+    for (int t = 0; t < nthreads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    free(threads);
+
+    int failed = 0;
+    for (int k = 0; k < njobs; k++) {
+        if (!jobs[k].failed)
+            check_job(&jobs[k]);
+        if (jobs[k].failed) {
+            printf("FAIL: %s: %s\n", jobs[k].name, jobs[k].message);
+            failed++;
+        } else {
+            printf("%s: %s\n", update ? "UPDATED" : "PASS", jobs[k].name);
+        }
+    }
+    printf("%d ROMs, %d failed\n", njobs, failed);
+    free(jobs);
+    return failed ? 1 : 0;
+}
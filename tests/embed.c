@@ -0,0 +1,208 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * File: tests/embed.c
+ * Description: Unit test related to the embedding interface.
+ */
+
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <lib8/libchip8.h>
+#include <lib8/cpu.h>
+
+/* Draws the 0 glyph at (0, 0), then loops forever. */
+static const uint8_t rom[] = {
+    0x60, 0x00,     // V0 = 0
+    0xF0, 0x29,     // I = sprite of V0
+    0xD0, 0x05,     // draw 5 rows at (V0, V0)
+    0x12, 0x06      // jump to itself
+};
+
+static struct chip8_t* chip8;
+
+static void
+setup_embed(void)
+{
+    chip8 = chip8_create(1);
+    ck_assert_ptr_ne(NULL, chip8);
+    ck_assert_int_eq(0, chip8_load(chip8, rom, sizeof(rom)));
+}
+
+static void
+teardown_embed(void)
+{
+    chip8_destroy(chip8);
+}
+
+/* The framebuffer should show what was drawn and flag it once. */
+START_TEST(test_embed_framebuffer)
+{
+    int width, height, dirty;
+    chip8_framebuffer(chip8, NULL, NULL, &dirty);
+    ck_assert_int_eq(0, chip8_run(chip8, 1, 16));
+
+    const uint8_t* pixels = chip8_framebuffer(chip8, &width, &height, &dirty);
+    ck_assert_int_eq(64, width);
+    ck_assert_int_eq(32, height);
+    ck_assert_int_ne(0, dirty);
+    ck_assert_int_eq(1, pixels[0]);
+    ck_assert_int_eq(0, pixels[4]);
+
+    chip8_run(chip8, 1, 16);
+    ck_assert_ptr_eq(pixels, chip8_framebuffer(chip8, NULL, NULL, &dirty));
+    ck_assert_int_eq(0, dirty);
+}
+END_TEST
+
+/* A restored snapshot should bring back the pixels it was taken with. */
+START_TEST(test_embed_snapshot)
+{
+    size_t size = chip8_snapshot_size();
+    void* before = malloc(size);
+    ck_assert_int_eq(0, chip8_snapshot(chip8, before, size));
+    ck_assert_int_ne(0, chip8_snapshot(chip8, before, size - 1));
+
+    chip8_run(chip8, 1, 16);
+    ck_assert_int_eq(1, chip8_framebuffer(chip8, NULL, NULL, NULL)[0]);
+    ck_assert_int_eq(0, chip8_restore(chip8, before, size));
+    ck_assert_int_eq(0, chip8_framebuffer(chip8, NULL, NULL, NULL)[0]);
+    free(before);
+}
+END_TEST
+
+/* Damaged snapshots and unknown profiles should be rejected. */
+START_TEST(test_embed_invalid)
+{
+    size_t size = chip8_snapshot_size();
+    uint8_t* snapshot = malloc(size);
+    chip8_snapshot(chip8, snapshot, size);
+    snapshot[0] ^= 0xFF;
+    ck_assert_int_ne(0, chip8_restore(chip8, snapshot, size));
+    ck_assert_int_ne(0, chip8_restore(chip8, snapshot, size / 2));
+    free(snapshot);
+
+    ck_assert_int_ne(0, chip8_set_quirks(chip8, "nonsense"));
+    ck_assert_int_eq(0, chip8_set_quirks(chip8, "schip"));
+
+    uint8_t large[4096] = { 0 };
+    ck_assert_int_ne(0, chip8_load(chip8, large, sizeof(large)));
+}
+END_TEST
+
+/* Key events should reach the machine at the instruction they are for. */
+START_TEST(test_embed_keys)
+{
+    static const uint8_t wait[] = {
+        0xF5, 0x0A,     // V5 = next key
+        0xF5, 0x29,     // I = sprite of V5
+        0xD0, 0x05,     // draw 5 rows at (V0, V0)
+        0x12, 0x06      // jump to itself
+    };
+    ck_assert_int_eq(0, chip8_load(chip8, wait, sizeof(wait)));
+    struct chip8_key_event_t events[] = {
+        { 40, 9, 1 },
+        { 41, 9, 0 }
+    };
+    ck_assert_int_eq(2, chip8_push_keys(chip8, events, 2));
+
+    chip8_run(chip8, 1, 30);
+    ck_assert(chip8_clock(chip8) == 30);
+    ck_assert_int_eq(0, chip8_framebuffer(chip8, NULL, NULL, NULL)[0]);
+    size_t size = chip8_snapshot_size();
+    void* waiting = malloc(size);
+    ck_assert_int_eq(0, chip8_snapshot(chip8, waiting, size));
+
+    /* Row 3 of the 9 glyph is 0x10. */
+    chip8_run(chip8, 1, 30);
+    ck_assert(chip8_clock(chip8) == 60);
+    const uint8_t* pixels = chip8_framebuffer(chip8, NULL, NULL, NULL);
+    ck_assert_int_eq(1, pixels[0]);
+    ck_assert_int_eq(0, pixels[64 * 3]);
+    ck_assert_int_eq(1, pixels[64 * 3 + 3]);
+
+    ck_assert_int_eq(0, chip8_restore(chip8, waiting, size));
+    ck_assert(chip8_clock(chip8) == 30);
+    ck_assert_int_eq(0, chip8_framebuffer(chip8, NULL, NULL, NULL)[0]);
+    free(waiting);
+}
+END_TEST
+
+/*
+ * Snapshots that would make the machine index memory, the stack or the
+ * registers out of bounds should be rejected. The machine is the last
+ * field of a snapshot, so it sits at its end.
+ */
+START_TEST(test_embed_corrupted)
+{
+    static const uint8_t ret[] = { 0x00, 0xEE };
+    ck_assert_int_eq(0, chip8_load(chip8, ret, sizeof(ret)));
+    size_t size = chip8_snapshot_size();
+    uint8_t* good = malloc(size);
+    uint8_t* bad = malloc(size);
+    ck_assert_int_eq(0, chip8_snapshot(chip8, good, size));
+    size_t base = size - sizeof(struct machine_t);
+    struct machine_t machine;
+
+    /* RET to an address past memory. */
+    memcpy(bad, good, size);
+    memcpy(&machine, bad + base, sizeof(machine));
+    machine.stack[0] = 0xFFF0;
+    machine.sp = 1;
+    memcpy(bad + base, &machine, sizeof(machine));
+    ck_assert_int_ne(0, chip8_restore(chip8, bad, size));
+
+    /* Waiting for a key that is not one. */
+    memcpy(bad, good, size);
+    bad[base + offsetof(struct machine_t, wait_key)] = 20;
+    ck_assert_int_ne(0, chip8_restore(chip8, bad, size));
+
+    /* Memory and its mirror disagree. */
+    memcpy(bad, good, size);
+    bad[base + offsetof(struct machine_t, mem) + MEMSIZ] ^= 0xFF;
+    ck_assert_int_ne(0, chip8_restore(chip8, bad, size));
+
+    /* The machine is left as it was and still runs. */
+    ck_assert_int_eq(0, chip8_run(chip8, 1, 16));
+    ck_assert_int_eq(0, chip8_restore(chip8, good, size));
+    free(good);
+    free(bad);
+}
+END_TEST
+
+static TCase*
+tcase_embed()
+{
+    TCase* tcase = tcase_create("Embedding");
+    tcase_add_checked_fixture(tcase, setup_embed, teardown_embed);
+    tcase_add_test(tcase, test_embed_framebuffer);
+    tcase_add_test(tcase, test_embed_snapshot);
+    tcase_add_test(tcase, test_embed_invalid);
+    tcase_add_test(tcase, test_embed_corrupted);
+    tcase_add_test(tcase, test_embed_keys);
+    return tcase;
+}
+
+Suite*
+create_embed_suite()
+{
+    Suite* suite = suite_create("Embed");
+    suite_add_tcase(suite, tcase_embed());
+    return suite;
+}
@@ -0,0 +1,246 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * File: tests/explore.c
+ * Description: Unit test related to expressions and state exploration.
+ */
+
+#include <check.h>
+#include <pthread.h>
+#include <string.h>
+#include <lib8/explore.h>
+#include "program.h"
+
+#define INSERTED 20000
+
+static struct machine_t boot;
+static word choices[17];
+
+/*
+ * A combination lock: key 5, then key 9.
+ * 0x200: 6105  LD V1, 5
+ * 0x202: E1A1  SKNP V1
+ * 0x204: 6201  LD V2, 1
+ * 0x206: 3201  SE V2, 1
+ * 0x208: 1202  JP 0x202
+ * 0x20A: 6109  LD V1, 9
+ * 0x20C: E1A1  SKNP V1
+ * 0x20E: 6302  LD V3, 2
+ * 0x210: 3302  SE V3, 2
+ * 0x212: 120C  JP 0x20C
+ * 0x214: 1214  JP 0x214
+ */
+static word program[] = {
+    0x6105, 0xE1A1, 0x6201, 0x3201, 0x1202, 0x6109, 0xE1A1, 0x6302,
+    0x3302, 0x120C, 0x1214
+};
+
+static void
+setup_explore(void)
+{
+    init_machine(&boot);
+    load_program(&boot, program, 11);
+    choices[0] = 0;
+    for (int k = 0; k < 16; k++)
+        choices[k + 1] = 1 << k;
+}
+
+static long
+eval(const char* text)
+{
+    struct expr_t* expr = expr_parse(text, NULL);
+    ck_assert_ptr_ne(NULL, expr);
+    long value = expr_eval(expr, &boot);
+    expr_free(expr);
+    return value;
+}
+
+/* Expressions should read the machine with C precedence. */
+START_TEST(test_expr_eval)
+{
+    boot.v[3] = 7;
+    boot.mem[0x3F0] = 12;
+    ck_assert_int_eq(0x61, eval("mem[0x200]"));
+    ck_assert_int_eq(7, eval("v3"));
+    ck_assert_int_eq(7, eval("v[1 + 2]"));
+    ck_assert_int_eq(1, eval("mem[0x3F0] >= 10 && v3 == 7"));
+    ck_assert_int_eq(0, eval("mem[0x3F0] >= 10 && !(v3 == 7)"));
+    ck_assert_int_eq(7, eval("1 + 2 * 3"));
+    ck_assert_int_eq(1, eval("1 || 0 && 0"));
+    ck_assert_int_eq(4, eval("mem[0x3F0] & 6"));
+    ck_assert_int_eq(-5, eval("-5"));
+    ck_assert_int_eq(0x200, eval("pc"));
+}
+END_TEST
+
+/* Syntax errors should be reported where they are. */
+START_TEST(test_expr_errors)
+{
+    size_t offset;
+    ck_assert_ptr_eq(NULL, expr_parse("v[3", &offset));
+    ck_assert_int_eq(3, offset);
+    ck_assert_ptr_eq(NULL, expr_parse("1 +", &offset));
+    ck_assert_ptr_eq(NULL, expr_parse("score > 3", &offset));
+    ck_assert_int_eq(0, offset);
+    ck_assert_ptr_eq(NULL, expr_parse("pc == 1 2", &offset));
+    ck_assert_int_eq(8, offset);
+
+    static char deep[120002];
+    memset(deep, '(', 120000);
+    strcpy(deep + 120000, "1");
+    ck_assert_ptr_eq(NULL, expr_parse(deep, &offset));
+    ck_assert_int_eq(64, offset);
+}
+END_TEST
+
+static struct stateset_t* set;
+static long fresh[2];
+
+static void*
+insert_range(void* data)
+{
+    long* count = data;
+    for (uint64_t k = 0; k < INSERTED; k++)
+        *count += stateset_insert(set, k * 0x9E3779B97F4A7C15ULL) == 1;
+    return NULL;
+}
+
+/* Two threads inserting the same hashes should insert each one once. */
+START_TEST(test_stateset)
+{
+    set = stateset_create(INSERTED);
+    ck_assert_ptr_ne(NULL, set);
+    pthread_t other;
+    fresh[0] = fresh[1] = 0;
+    pthread_create(&other, NULL, insert_range, &fresh[1]);
+    insert_range(&fresh[0]);
+    pthread_join(other, NULL);
+    ck_assert_int_eq(INSERTED, fresh[0] + fresh[1]);
+    ck_assert_int_eq(0, stateset_insert(set, 0x9E3779B97F4A7C15ULL));
+    stateset_destroy(set);
+}
+END_TEST
+
+static struct explore_config_t
+lock_config(int order)
+{
+    static struct expr_t* goal;
+    static struct expr_t* score;
+    if (goal == NULL) {
+        goal = expr_parse("v3 == 2", NULL);
+        score = expr_parse("v2 + v3", NULL);
+    }
+    struct explore_config_t config = {
+        order, 2, 2, 16, choices, 17, goal, score, 1000, 10
+    };
+    return config;
+}
+
+/* Breadth first should find the shortest combination. */
+START_TEST(test_explore_bfs)
+{
+    struct explore_config_t config = lock_config(EXPLORE_BFS);
+    struct explore_result_t result;
+    word path[10];
+    ck_assert_int_eq(0, explore_run(&boot, &config, path, &result));
+    ck_assert_int_eq(1, result.found);
+    ck_assert_int_eq(2, result.depth);
+    ck_assert_int_eq(1 << 5, path[0]);
+    ck_assert_int_eq(1 << 9, path[1]);
+    ck_assert(result.duplicates > 0);
+}
+END_TEST
+
+/* Hold the keys of a path from the boot state, is the lock open then? */
+static int
+opens_lock(const struct explore_config_t* config, const word* path, int depth)
+{
+    struct machine_t cpu;
+    memcpy(&cpu, &boot, sizeof(struct machine_t));
+    for (int k = 0; k < depth; k++) {
+        cpu.keypad = path[k];
+        run_frames(&cpu, config->frames, config->steps);
+    }
+    return cpu.v[3] == 2;
+}
+
+/* Best first should follow the score to the combination. */
+START_TEST(test_explore_best)
+{
+    /* A single thread, since racing threads may take a longer path. */
+    struct explore_config_t config = lock_config(EXPLORE_BEST);
+    config.threads = 1;
+    struct explore_result_t result;
+    word path[10];
+    ck_assert_int_eq(0, explore_run(&boot, &config, path, &result));
+    ck_assert_int_eq(1, result.found);
+    ck_assert_int_eq(2, result.depth);
+    ck_assert(result.expanded <= 3);
+    ck_assert(opens_lock(&config, path, result.depth));
+
+    config.threads = 2;
+    ck_assert_int_eq(0, explore_run(&boot, &config, path, &result));
+    ck_assert_int_eq(1, result.found);
+    ck_assert(opens_lock(&config, path, result.depth));
+}
+END_TEST
+
+/* A goal that cannot be met should end the search empty handed. */
+START_TEST(test_explore_exhaust)
+{
+    struct explore_config_t config = lock_config(EXPLORE_BFS);
+    config.goal = expr_parse("v3 == 3", NULL);
+    struct explore_result_t result;
+    word path[10];
+    ck_assert_int_eq(0, explore_run(&boot, &config, path, &result));
+    ck_assert_int_eq(0, result.found);
+    ck_assert(result.states > 3 && result.states < config.max_states);
+    expr_free((struct expr_t*) config.goal);
+}
+END_TEST
+
+static TCase*
+tcase_expr()
+{
+    TCase* tcase = tcase_create("Expressions");
+    tcase_add_checked_fixture(tcase, setup_explore, NULL);
+    tcase_add_test(tcase, test_expr_eval);
+    tcase_add_test(tcase, test_expr_errors);
+    return tcase;
+}
+
+static TCase*
+tcase_explore()
+{
+    TCase* tcase = tcase_create("Exploration");
+    tcase_add_checked_fixture(tcase, setup_explore, NULL);
+    tcase_add_test(tcase, test_stateset);
+    tcase_add_test(tcase, test_explore_bfs);
+    tcase_add_test(tcase, test_explore_best);
+    tcase_add_test(tcase, test_explore_exhaust);
+    return tcase;
+}
+
+Suite*
+create_explore_suite()
+{
+    Suite* suite = suite_create("Explore");
+    suite_add_tcase(suite, tcase_expr());
+    suite_add_tcase(suite, tcase_explore());
+    return suite;
+}
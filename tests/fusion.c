@@ -0,0 +1,126 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File: tests/fusion.c
+ * Description: Unit test related to superinstructions in run_machine.
+ */
+
+#include <check.h>
+#include <string.h>
+#include <lib8/cpu.h>
+#include "program.h"
+
+static struct machine_t cpu, ref;
+
+/* Load a program on both the machine to fuse and the reference. */
+static void
+load_both(const word* program, int len)
+{
+    init_machine(&cpu);
+    load_program(&cpu, program, len);
+    cpu.v[2] = 0x11;
+    cpu.v[3] = 0x11;
+    memcpy(&ref, &cpu, sizeof(struct machine_t));
+}
+
+/* Run both machines and expect the same state. */
+static void
+assert_same(int steps)
+{
+    for (int k = 0; k < steps; k++) {
+        step_machine(&ref);
+    }
+    run_machine(&cpu, steps);
+    ck_assert_int_eq(ref.pc, cpu.pc);
+    ck_assert_int_eq(ref.i, cpu.i);
+    ck_assert_int_eq(0, memcmp(ref.v, cpu.v, 16));
+    ck_assert_int_eq(0, memcmp(ref.screen, cpu.screen, 2048));
+}
+
+/* 6XKK 6YKK and ANNN DXYN should draw the same sprite. */
+START_TEST(test_fusion_draw)
+{
+    word program[] = { 0x6008, 0x6104, 0xA050, 0xD015, 0xD015 };
+    load_both(program, 5);
+    assert_same(4);
+    ck_assert_int_eq(1, cpu.screen[64 * 4 + 8]);
+    assert_same(1);
+    ck_assert_int_eq(1, cpu.v[15]);
+}
+END_TEST
+
+/* A budget of one should never run both halves of a pair. */
+START_TEST(test_fusion_budget)
+{
+    word program[] = { 0x6008, 0x6104 };
+    load_both(program, 2);
+    assert_same(1);
+    ck_assert_int_eq(0x202, cpu.pc);
+    ck_assert_int_eq(0, cpu.v[1]);
+}
+END_TEST
+
+/* Skip and jump pairs should follow the branch either way. */
+START_TEST(test_fusion_branch)
+{
+    word taken[] = { 0x3011, 0x1300, 0x5230, 0x1300, 0x1200 };
+    load_both(taken, 5);
+    cpu.v[0] = ref.v[0] = 0x11;
+    assert_same(2);
+    ck_assert_int_eq(0x208, cpu.pc);
+
+    word fallen[] = { 0x4011, 0x1206, 0x0000, 0x9230, 0x120A, 0x1300 };
+    load_both(fallen, 6);
+    cpu.v[0] = ref.v[0] = 0x11;
+    assert_same(5);
+    ck_assert_int_eq(0x300, cpu.pc);
+}
+END_TEST
+
+/* 7XKK 3XKK loop counters should exit the loop at the right time. */
+START_TEST(test_fusion_counter)
+{
+    word program[] = { 0x7001, 0x3005, 0x1200, 0x00FD };
+    load_both(program, 4);
+    for (int k = 1; k < 20; k++) {
+        assert_same(k);
+    }
+    ck_assert_int_eq(1, cpu.exit);
+    ck_assert_int_eq(5, cpu.v[0]);
+}
+END_TEST
+
+static TCase*
+tcase_fusion()
+{
+    TCase* tcase = tcase_create("Pairs");
+    tcase_add_test(tcase, test_fusion_draw);
+    tcase_add_test(tcase, test_fusion_budget);
+    tcase_add_test(tcase, test_fusion_branch);
+    tcase_add_test(tcase, test_fusion_counter);
+    return tcase;
+}
+
+Suite*
+create_fusion_suite()
+{
+    Suite* suite = suite_create("Superinstructions");
+    suite_add_tcase(suite, tcase_fusion());
+    return suite;
+}
@@ -0,0 +1,145 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * File: tests/guard.c
+ * Description: Unit test related to memory accesses at the end of memory.
+ */
+
+#include <check.h>
+#include <string.h>
+#include <lib8/guard.h>
+
+static struct machine_t* cpu;
+
+static void
+setup_guard(void)
+{
+    cpu = guard_create();
+    ck_assert_ptr_ne(NULL, cpu);
+}
+
+static void
+teardown_guard(void)
+{
+    guard_destroy(cpu);
+}
+
+static void
+put_opcode(word opcode, address pos)
+{
+    cpu->mem[pos] = opcode >> 8;
+    cpu->mem[pos + 1] = opcode & 0xFF;
+}
+
+/* Guarded machines should be initialized like any other machine. */
+START_TEST(test_guard_init)
+{
+    ck_assert_int_eq(0x200, cpu->pc);
+    ck_assert_int_eq(0xF0, cpu->mem[0x50]);
+    ck_assert_int_eq(0, cpu->mem[MEMSIZ + MEMGUARD - 1]);
+}
+END_TEST
+
+/* Storing registers past the end should wrap to the beginning. */
+START_TEST(test_guard_store_wraps)
+{
+    for (int reg = 0; reg < 16; reg++) {
+        cpu->v[reg] = reg + 1;
+    }
+    cpu->i = 0xFFC;
+    put_opcode(0xFF55, 0x200);
+    step_machine(cpu);
+    ck_assert_int_eq(4, cpu->mem[0xFFF]);
+    ck_assert_int_eq(5, cpu->mem[0x000]);
+    ck_assert_int_eq(16, cpu->mem[0x00B]);
+    ck_assert_int_eq(0, memcmp(cpu->mem, cpu->mem + MEMSIZ, MEMGUARD));
+}
+END_TEST
+
+/* Loading registers past the end should read the beginning. */
+START_TEST(test_guard_load_wraps)
+{
+    cpu->v[0] = 123;
+    cpu->i = 0x000;
+    put_opcode(0xF033, 0x200);
+    step_machine(cpu);
+    cpu->i = 0xFFE;
+    put_opcode(0xF365, 0x202);
+    step_machine(cpu);
+    ck_assert_int_eq(1, cpu->v[2]);
+    ck_assert_int_eq(2, cpu->v[3]);
+}
+END_TEST
+
+/* A 16x16 sprite at the very end should be read without faulting. */
+START_TEST(test_guard_draw_end)
+{
+    set_screen_mode(cpu, 1);
+    cpu->i = 0xFFF;
+    put_opcode(0xD000, 0x200);
+    step_machine(cpu);
+    ck_assert_int_eq(0x202, cpu->pc);
+}
+END_TEST
+
+/* Adding to I should wrap instead of leaving memory. */
+START_TEST(test_guard_add_i_wraps)
+{
+    cpu->i = 0xFF0;
+    cpu->v[3] = 0x20;
+    put_opcode(0xF31E, 0x200);
+    step_machine(cpu);
+    ck_assert_int_eq(0x010, cpu->i);
+}
+END_TEST
+
+/* Fetching the last word should wrap the second byte. */
+START_TEST(test_guard_fetch_end)
+{
+    cpu->v[0] = 0x34;
+    cpu->i = 0x000;
+    put_opcode(0xF055, 0x200);
+    step_machine(cpu);
+    cpu->mem[0xFFF] = 0x12;
+    cpu->pc = 0xFFF;
+    step_machine(cpu);
+    ck_assert_int_eq(0x234, cpu->pc);
+}
+END_TEST
+
+static TCase*
+tcase_guard()
+{
+    TCase* tcase = tcase_create("Guard");
+    tcase_add_checked_fixture(tcase, setup_guard, teardown_guard);
+    tcase_add_test(tcase, test_guard_init);
+    tcase_add_test(tcase, test_guard_store_wraps);
+    tcase_add_test(tcase, test_guard_load_wraps);
+    tcase_add_test(tcase, test_guard_draw_end);
+    tcase_add_test(tcase, test_guard_add_i_wraps);
+    tcase_add_test(tcase, test_guard_fetch_end);
+    return tcase;
+}
+
+Suite*
+create_guard_suite()
+{
+    Suite* suite = suite_create("Guard");
+    suite_add_tcase(suite, tcase_guard());
+    return suite;
+}
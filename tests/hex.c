@@ -0,0 +1,147 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File: tests/hex.c
+ * Description: Unit test related to the hexadecimal ROM decoder.
+ */
+
+#include <check.h>
+#include <stdio.h>
+#include <string.h>
+#include <lib8/hex.h>
+
+static byte out[256];
+static size_t written, offset;
+
+static int
+decode(const char* src)
+{
+    memset(out, 0, sizeof (out));
+    written = offset = 0;
+    return hex_decode(src, strlen(src), out, sizeof (out), &written, &offset);
+}
+
+/* A plain listing should be decoded two characters per byte. */
+START_TEST(test_hex_plain)
+{
+    ck_assert_int_eq(HEX_OK, decode("6A026b0CA2eaDAB6"));
+    ck_assert_int_eq(8, written);
+    byte expected[] = { 0x6A, 0x02, 0x6B, 0x0C, 0xA2, 0xEA, 0xDA, 0xB6 };
+    ck_assert_int_eq(0, memcmp(expected, out, 8));
+}
+END_TEST
+
+/* Long runs go through the bulk decoder and must match the scalar path. */
+START_TEST(test_hex_long)
+{
+    char src[401];
+    for (int i = 0; i < 200; i++) {
+        sprintf(src + 2 * i, (i & 1) ? "%02x" : "%02X", (i * 37) & 0xFF);
+    }
+    ck_assert_int_eq(HEX_OK, decode(src));
+    ck_assert_int_eq(200, written);
+    for (int i = 0; i < 200; i++) {
+        ck_assert_int_eq((i * 37) & 0xFF, out[i]);
+    }
+}
+END_TEST
+
+static TCase*
+tcase_hex_decode()
+{
+    TCase* tcase = tcase_create("Decode");
+    tcase_add_test(tcase, test_hex_plain);
+    tcase_add_test(tcase, test_hex_long);
+    return tcase;
+}
+
+/* Whitespace and comments should be skipped anywhere in the listing. */
+START_TEST(test_hex_comments)
+{
+    const char* src =
+        "# PONG, first bytes\n"
+        "6A02 6B0C\t6C3F  # set up paddles\r\n"
+        "  6 D0C\n"
+        "#A2EA";
+    ck_assert_int_eq(HEX_OK, decode(src));
+    ck_assert_int_eq(8, written);
+    byte expected[] = { 0x6A, 0x02, 0x6B, 0x0C, 0x6C, 0x3F, 0x6D, 0x0C };
+    ck_assert_int_eq(0, memcmp(expected, out, 8));
+}
+END_TEST
+
+static TCase*
+tcase_hex_comments()
+{
+    TCase* tcase = tcase_create("Comments");
+    tcase_add_test(tcase, test_hex_comments);
+    return tcase;
+}
+
+/* Invalid characters should be reported with their offset. */
+START_TEST(test_hex_invalid)
+{
+    ck_assert_int_eq(HEX_INVALID, decode("00112233445566778899AABBCCDDEEFFG0"));
+    ck_assert_int_eq(32, offset);
+    ck_assert_int_eq(16, written);
+    ck_assert_int_eq(HEX_INVALID, decode("12 3x"));
+    ck_assert_int_eq(4, offset);
+}
+END_TEST
+
+/* A trailing lone digit should be reported as an incomplete byte. */
+START_TEST(test_hex_odd)
+{
+    ck_assert_int_eq(HEX_ODD, decode("1234 5\n"));
+    ck_assert_int_eq(5, offset);
+    ck_assert_int_eq(2, written);
+}
+END_TEST
+
+/* Data not fitting in the output buffer should be reported. */
+START_TEST(test_hex_overflow)
+{
+    byte small[4];
+    const char* src = "0011223344";
+    ck_assert_int_eq(HEX_OVERFLOW,
+            hex_decode(src, strlen(src), small, 4, &written, &offset));
+    ck_assert_int_eq(4, written);
+    ck_assert_int_eq(8, offset);
+}
+END_TEST
+
+static TCase*
+tcase_hex_errors()
+{
+    TCase* tcase = tcase_create("Errors");
+    tcase_add_test(tcase, test_hex_invalid);
+    tcase_add_test(tcase, test_hex_odd);
+    tcase_add_test(tcase, test_hex_overflow);
+    return tcase;
+}
+
+Suite*
+create_hex_suite()
+{
+    Suite* suite = suite_create("HEX Decoder");
+    suite_add_tcase(suite, tcase_hex_decode());
+    suite_add_tcase(suite, tcase_hex_comments());
+    suite_add_tcase(suite, tcase_hex_errors());
+    return suite;
+}
@@ -0,0 +1,201 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File: tests/input.c
+ * Description: Unit test related to timestamped key events.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <check.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <lib8/input.h>
+#include "program.h"
+
+static struct machine_t cpu;
+static struct input_queue_t* queue;
+
+/*
+ * Counts loops until key 5 is seen down.
+ * 0x200: 6105  LD V1, 5
+ * 0x202: 7001  ADD V0, 1
+ * 0x204: E1A1  SKNP V1
+ * 0x206: 1206  JP 0x206
+ * 0x208: 1202  JP 0x202
+ */
+static word program[] = { 0x6105, 0x7001, 0xE1A1, 0x1206, 0x1202 };
+
+/* The SKNP at step 2 + 3k is the first one to see a key pressed at 100. */
+#define PRESSED_AT 100
+#define LOOPS 34
+
+static void
+setup_input(void)
+{
+    init_machine(&cpu);
+    load_program(&cpu, program, 5);
+    queue = input_create(4);
+    ck_assert_ptr_ne(NULL, queue);
+    cpu.input = queue;
+}
+
+static void
+teardown_input(void)
+{
+    input_destroy(queue);
+}
+
+static void
+press(uint64_t at, int key, int down)
+{
+    struct input_event_t event = { at, key, down };
+    ck_assert_int_eq(1, input_push(queue, &event, 1));
+}
+
+/* An event should land on the same instruction however steps are split. */
+START_TEST(test_input_exact)
+{
+    static struct machine_t boot;
+    memcpy(&boot, &cpu, sizeof(struct machine_t));
+
+    press(PRESSED_AT, 5, 1);
+    run_machine(&cpu, 1000);
+    ck_assert_int_eq(LOOPS, cpu.v[0]);
+    ck_assert_int_eq(0x206, cpu.pc);
+    ck_assert(cpu.clock == 1000);
+
+    int splits[] = { 1, 2, 7, 99, 101 };
+    for (int s = 0; s < 5; s++) {
+        memcpy(&cpu, &boot, sizeof(struct machine_t));
+        press(PRESSED_AT, 5, 1);
+        for (int done = 0; done < 1000; done += splits[s])
+            run_machine(&cpu, splits[s]);
+        ck_assert_int_eq(LOOPS, cpu.v[0]);
+    }
+
+    memcpy(&cpu, &boot, sizeof(struct machine_t));
+    press(PRESSED_AT, 5, 1);
+    for (int k = 0; k < 1000; k++)
+        step_machine(&cpu);
+    ck_assert_int_eq(LOOPS, cpu.v[0]);
+}
+END_TEST
+
+/* Events should be applied in order, late ones at the next instruction. */
+START_TEST(test_input_order)
+{
+    run_machine(&cpu, 10);
+    press(INPUT_NOW, 3, 1);
+    press(INPUT_NOW, 5, 1);
+    press(INPUT_NOW, 5, 0);
+    press(50, 7, 1);
+
+    /* The queue holds 4 events. */
+    struct input_event_t extra = { 60, 7, 0 };
+    ck_assert_int_eq(0, input_push(queue, &extra, 1));
+
+    run_machine(&cpu, 1);
+    ck_assert_int_eq(1 << 3, cpu.keypad);
+    run_machine(&cpu, 100);
+    ck_assert_int_eq(1 << 3 | 1 << 7, cpu.keypad);
+    ck_assert_int_ne(0x206, cpu.pc);
+    ck_assert_int_eq(1, input_push(queue, &extra, 1));
+}
+END_TEST
+
+/* Snapshots should keep the queue of the machine they are restored to. */
+START_TEST(test_input_snapshot)
+{
+    static struct machine_t copy;
+    init_machine(&copy);
+    snapshot_machine(&copy, &cpu);
+    ck_assert_ptr_eq(NULL, copy.input);
+
+    press(PRESSED_AT, 5, 1);
+    run_machine(&cpu, 1000);
+    snapshot_machine(&cpu, &copy);
+    ck_assert_ptr_eq(queue, cpu.input);
+    ck_assert(cpu.clock == 0);
+}
+END_TEST
+
+#define TOGGLES 301
+#define SPACING 64
+
+/* Events pushed so far by toggle_keys. */
+static int pushed;
+
+/* Presses and releases key 1 every SPACING steps, pushing as room is made. */
+static void*
+toggle_keys(void* data)
+{
+    for (int k = 0; k < TOGGLES; ) {
+        struct input_event_t event = { SPACING * k, 1, !(k & 1) };
+        if (input_push(queue, &event, 1) == 0) {
+            sched_yield();
+            continue;
+        }
+        __atomic_store_n(&pushed, ++k, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+/* A producer thread should hand over every event, in order. */
+START_TEST(test_input_threads)
+{
+    pthread_t producer;
+    ck_assert_int_eq(0, pthread_create(&producer, NULL, toggle_keys, NULL));
+
+    /* Once event k is queued, a chunk runs from its time to the next. */
+    for (int k = 0; k < TOGGLES; k++) {
+        while (__atomic_load_n(&pushed, __ATOMIC_ACQUIRE) <= k)
+            sched_yield();
+        ck_assert(cpu.clock == (uint64_t) SPACING * k);
+        run_machine(&cpu, SPACING);
+        ck_assert_int_eq(k & 1 ? 0 : 1 << 1, cpu.keypad);
+    }
+    pthread_join(producer, NULL);
+
+    /* Every slot was handed back. */
+    struct input_event_t events[4] = { { 0 } };
+    ck_assert_int_eq(4, input_push(queue, events, 4));
+}
+END_TEST
+
+static TCase*
+tcase_input()
+{
+    TCase* tcase = tcase_create("Key events");
+    tcase_add_checked_fixture(tcase, setup_input, teardown_input);
+    tcase_add_test(tcase, test_input_exact);
+    tcase_add_test(tcase, test_input_order);
+    tcase_add_test(tcase, test_input_snapshot);
+    tcase_add_test(tcase, test_input_threads);
+    return tcase;
+}
+
+Suite*
+create_input_suite()
+{
+    Suite* suite = suite_create("Input");
+    suite_add_tcase(suite, tcase_input());
+    return suite;
+}
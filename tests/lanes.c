@@ -0,0 +1,151 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * File: tests/lanes.c
+ * Description: Unit test related to machines run in lockstep.
+ */
+
+#include <check.h>
+#include <string.h>
+#include <lib8/lanes.h>
+#include "program.h"
+
+#define LANES 8
+
+static struct machine_t boot;
+static struct machine_t single[LANES];
+static struct lanes_t* lanes;
+
+/*
+ * 0x200: 6000  LD V0, 0
+ * 0x202: C1FF  RND V1, 0xFF
+ * 0x204: 7001  ADD V0, 1
+ * 0x206: 8214  ADD V2, V1
+ * 0x208: A050  LD I, 0x050 (font for 0)
+ * 0x20A: D015  DRW V0, V1, 5
+ * 0x20C: E19E  SKP V1
+ * 0x20E: 1204  JP 0x204
+ * 0x210: 00FD  EXIT
+ */
+static word program[] = {
+    0x6000, 0xC1FF, 0x7001, 0x8214, 0xA050, 0xD015, 0xE19E, 0x1204, 0x00FD
+};
+
+static void
+setup_lanes(void)
+{
+    init_machine(&boot);
+    load_program(&boot, program, 9);
+    for (int k = 0; k < LANES; k++) {
+        memcpy(&single[k], &boot, sizeof(struct machine_t));
+        seed_machine(&single[k], 7 + k);
+    }
+    lanes = lanes_create(LANES, &boot, 7);
+    ck_assert_ptr_ne(NULL, lanes);
+}
+
+static void
+teardown_lanes(void)
+{
+    lanes_destroy(lanes);
+}
+
+/* Run lanes and machines one at a time and compare them. */
+static void
+compare_lanes(const word* keys, int frames, int steps)
+{
+    lanes_set_keys(lanes, keys);
+    for (int k = 0; k < LANES; k++) {
+        single[k].keypad = keys[k];
+    }
+    for (int frame = 0; frame < frames; frame++) {
+        lanes_run(lanes, steps);
+        lanes_tick(lanes);
+        for (int k = 0; k < LANES; k++) {
+            run_machine(&single[k], steps);
+            tick_timers(&single[k]);
+        }
+    }
+    for (int k = 0; k < LANES; k++) {
+        const struct machine_t* cpu = lanes_machine(lanes, k);
+        ck_assert_int_eq(single[k].pc, cpu->pc);
+        ck_assert_int_eq(single[k].i, cpu->i);
+        ck_assert_int_eq(single[k].rng, cpu->rng);
+        ck_assert_int_eq(single[k].exit, cpu->exit);
+        ck_assert_int_eq(0, memcmp(single[k].v, cpu->v, 16));
+        ck_assert_int_eq(0, memcmp(single[k].screen, cpu->screen,
+                    sizeof(cpu->screen)));
+    }
+}
+
+/* Lanes holding the same keys should match the interpreter. */
+START_TEST(test_lanes_same_keys)
+{
+    word keys[LANES] = { 0 };
+    compare_lanes(keys, 20, 16);
+}
+END_TEST
+
+/* Lanes that diverge should match the interpreter too. */
+START_TEST(test_lanes_diverged)
+{
+    word keys[LANES];
+    for (int k = 0; k < LANES; k++) {
+        keys[k] = 1 << (2 * k);
+    }
+    compare_lanes(keys, 20, 16);
+}
+END_TEST
+
+/* Lanes that exit should stop while the others go on. */
+START_TEST(test_lanes_exit)
+{
+    word keys[LANES] = { 0xFFFF, 0, 0, 0, 0, 0, 0, 0 };
+    compare_lanes(keys, 50, 16);
+    ck_assert_int_eq(1, lanes_machine(lanes, 0)->exit);
+    ck_assert_int_eq(0, lanes_machine(lanes, 1)->exit);
+}
+END_TEST
+
+/* Lanes should only be created in range. */
+START_TEST(test_lanes_range)
+{
+    ck_assert_ptr_eq(NULL, lanes_create(0, &boot, 0));
+    ck_assert_ptr_eq(NULL, lanes_create(LANES_MAX + 1, &boot, 0));
+}
+END_TEST
+
+static TCase*
+tcase_lanes()
+{
+    TCase* tcase = tcase_create("Lockstep");
+    tcase_add_checked_fixture(tcase, setup_lanes, teardown_lanes);
+    tcase_add_test(tcase, test_lanes_same_keys);
+    tcase_add_test(tcase, test_lanes_diverged);
+    tcase_add_test(tcase, test_lanes_exit);
+    tcase_add_test(tcase, test_lanes_range);
+    return tcase;
+}
+
+Suite*
+create_lanes_suite()
+{
+    Suite* suite = suite_create("Lanes");
+    suite_add_tcase(suite, tcase_lanes());
+    return suite;
+}
@@ -556,6 +556,34 @@ tcase_jp()
     return tcase;
 }
 
+/* Machines seeded the same way should draw the same random numbers. */
+START_TEST(test_rnd)
+{
+    struct machine_t other;
+    init_machine(&other);
+    seed_machine(&cpu, 1234);
+    seed_machine(&other, 1234);
+    put_opcode(0xC00F, 0);
+    other.mem[0] = 0xC0;
+    other.mem[1] = 0x0F;
+    for (int k = 0; k < 16; k++) {
+        cpu.pc = other.pc = 0;
+        step_machine(&cpu);
+        step_machine(&other);
+        ck_assert_int_eq(cpu.v[0], other.v[0]);
+        ck_assert_int_eq(0, cpu.v[0] & 0xF0);
+    }
+}
+END_TEST
+
+static TCase*
+tcase_rnd()
+{
+    TCase* tcase = setup_tcase("RND");
+    tcase_add_test(tcase, test_rnd);
+    return tcase;
+}
+
 static int
 mock_poller(char key)
 {
@@ -579,11 +607,26 @@ START_TEST(test_skp)
 }
 END_TEST
 
+/* Without a poller, keys are read from the keypad mask. */
+START_TEST(test_skp_keypad)
+{
+    cpu.keypad = 1 << 2;
+    put_opcode(0xE09E, 0);
+    for (char key = 0; key < 16; key++) {
+        cpu.pc = 0;
+        cpu.v[0] = key;
+        step_machine(&cpu);
+        ck_assert_int_eq(key == 2 ? 4 : 2, cpu.pc);
+    }
+}
+END_TEST
+
 static TCase*
 tcase_skp()
 {
     TCase* tcase = setup_tcase("SKP");
     tcase_add_test(tcase, test_skp);
+    tcase_add_test(tcase, test_skp_keypad);
     return tcase;
 }
 
@@ -656,11 +699,27 @@ START_TEST(test_ldk)
 }
 END_TEST
 
+START_TEST(test_ldk_keypad)
+{
+    cpu.v[0] = 0xFF;
+    put_opcode(0xF00A, 0);
+    cpu.pc = 0x00;
+    step_machine(&cpu);
+    step_machine(&cpu);
+    ck_assert_int_eq(2, cpu.pc);
+    ck_assert_int_eq(0xFF, cpu.v[0]);
+    cpu.keypad = 1 << 7;
+    step_machine(&cpu);
+    ck_assert_int_eq(7, cpu.v[0]);
+}
+END_TEST
+
 static TCase*
 tcase_ldk()
 {
     TCase* tcase = setup_tcase("LDK");
     tcase_add_test(tcase, test_ldk);
+    tcase_add_test(tcase, test_ldk_keypad);
     return tcase;
 }
 
@@ -808,6 +867,7 @@ create_chip8_opcodes_suite()
     suite_add_tcase(suite, tcase_snexy());
     suite_add_tcase(suite, tcase_ldi());
     suite_add_tcase(suite, tcase_jp());
+    suite_add_tcase(suite, tcase_rnd());
     suite_add_tcase(suite, tcase_skp());
     suite_add_tcase(suite, tcase_sknp());
     suite_add_tcase(suite, tcase_lddt());
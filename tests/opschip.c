@@ -79,7 +79,7 @@ END_TEST
 START_TEST(test_scd_esm_on)
 {
     /* Clear the screen, put an horizontal line on Y = 0. */
-    cpu.esm = 1;
+    set_screen_mode(&cpu, 1);
     memset(cpu.screen, 0, 8192);
     screen_fill_row(&cpu, 0);
 
@@ -143,7 +143,7 @@ END_TEST
 START_TEST(test_scr_esm_on)
 {
     /* Clear screen, put vertical line on X = 0. */
-    cpu.esm = 1;
+    set_screen_mode(&cpu, 1);
     memset(cpu.screen, 0, 8192);
     screen_fill_column(&cpu, 0);
 
@@ -206,7 +206,7 @@ END_TEST
 START_TEST(test_scl_esm_on)
 {
     /* Clear thes creen and put a vertical line on X = 4. */
-    cpu.esm = 1;
+    set_screen_mode(&cpu, 1);
     memset(cpu.screen, 0, 8192);
     screen_fill_column(&cpu, 4);
 
@@ -262,7 +262,7 @@ tcase_exit()
 /* Executing LOW should disable extended screen mode. */
 START_TEST(test_low)
 {
-    cpu.esm = 1;
+    set_screen_mode(&cpu, 1);
     cpu.pc = 0x200;
     put_opcode(0x00FE, 0x200);
     step_machine(&cpu);
@@ -308,7 +308,7 @@ START_TEST(test_draw_esm)
     }
 
     /* Set up machine. */
-    cpu.esm = 1;
+    set_screen_mode(&cpu, 1);
     memset(cpu.screen, 0, 8192);
     cpu.i = 0x800;
     put_opcode(0xD110, 0x200);
@@ -328,23 +328,58 @@ START_TEST(test_draw_esm)
 }
 END_TEST
 
+/* Executing LOW should make DRAW wrap at the low resolution edge again. */
+START_TEST(test_draw_after_low)
+{
+    set_screen_mode(&cpu, 1);
+    memset(cpu.screen, 0, 8192);
+    cpu.mem[0x800] = 0xFF;
+    cpu.i = 0x800;
+    cpu.v[1] = 60;
+    put_opcode(0x00FE, 0x200);
+    put_opcode(0xD121, 0x202);
+    step_machine(&cpu);
+    step_machine(&cpu);
+    ck_assert_int_eq(0, cpu.esm);
+    ck_assert_int_ne(0, screen_get_pixel(&cpu, 0, 63));
+    ck_assert_int_ne(0, screen_get_pixel(&cpu, 0, 0));
+    ck_assert_int_eq(0, screen_get_pixel(&cpu, 0, 64));
+}
+END_TEST
+
+/* Executing CLS with extended mode should clear the whole screen. */
+START_TEST(test_cls_esm)
+{
+    set_screen_mode(&cpu, 1);
+    screen_fill_row(&cpu, 63);
+    put_opcode(0x00E0, 0x200);
+    step_machine(&cpu);
+    for (int col = 0; col < 128; col++) {
+        ck_assert_int_eq(0, screen_get_pixel(&cpu, 63, col));
+    }
+    ck_assert(screen_hash(&cpu) == 0);
+}
+END_TEST
+
 static TCase*
 tcase_draw_esm()
 {
     TCase* tcase = setup_tcase("DRW ESM");
     tcase_add_test(tcase, test_draw_esm);
+    tcase_add_test(tcase, test_draw_after_low);
+    tcase_add_test(tcase, test_cls_esm);
     return tcase;
 }
 
 START_TEST(test_ld_hf)
 {
-    cpu.esm = 1;
+    set_screen_mode(&cpu, 1);
     put_opcode(0xF030, 0x200);
     for (int r = 0; r < 16; r++) {
         cpu.v[0] = r;
         cpu.pc = 0x200;
         step_machine(&cpu);
-        ck_assert_int_eq(0x8200 + r * 10, cpu.i);
+        ck_assert_int_eq(0xA0 + r * 10, cpu.i);
     }
 }
 END_TEST
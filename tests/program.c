@@ -0,0 +1,33 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File: tests/program.c
+ * Description: Helpers shared by the unit tests.
+ */
+
+#include "program.h"
+
+void
+load_program(struct machine_t* cpu, const word* program, int len)
+{
+    for (int k = 0; k < len; k++) {
+        cpu->mem[0x200 + 2 * k] = program[k] >> 8;
+        cpu->mem[0x201 + 2 * k] = program[k] & 0xFF;
+    }
+}
@@ -0,0 +1,30 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TESTS_PROGRAM_H_
+#define TESTS_PROGRAM_H_
+
+#include <lib8/cpu.h>
+
+/**
+ * Load a test program at 0x200, an opcode per word, into the memory of a
+ * machine. The rest of the machine is left as it is.
+ */
+void load_program(struct machine_t* cpu, const word* program, int len);
+
+#endif // TESTS_PROGRAM_H_
@@ -0,0 +1,186 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * File: tests/quirks.c
+ * Description: Unit test related to quirk profiles.
+ */
+
+#include <check.h>
+#include <string.h>
+#include <lib8/cpu.h>
+
+static struct machine_t cpu;
+
+static void
+setup_cpu(void)
+{
+    init_machine(&cpu);
+    cpu.pc = 0x200;
+}
+
+static void
+put_opcode(word opcode)
+{
+    cpu.mem[0x200] = opcode >> 8;
+    cpu.mem[0x201] = opcode & 0xFF;
+}
+
+/* Profiles should be found by name and unknown ones rejected. */
+START_TEST(test_quirks_names)
+{
+    ck_assert_int_eq(QUIRKS_DEFAULT, quirks_by_name("default"));
+    ck_assert_int_eq(QUIRKS_CHIP8, quirks_by_name("chip8"));
+    ck_assert_int_eq(QUIRKS_SCHIP, quirks_by_name("schip"));
+    ck_assert_int_eq(QUIRKS_XOCHIP, quirks_by_name("xochip"));
+    ck_assert_int_eq(-1, quirks_by_name("megachip"));
+    ck_assert_int_eq(QUIRKS_DEFAULT, cpu.quirks);
+    ck_assert_int_ne(0, set_quirks(&cpu, QUIRK_JUMP));
+    ck_assert_int_eq(0, set_quirks(&cpu, QUIRKS_SCHIP));
+    ck_assert_int_eq(QUIRKS_SCHIP, cpu.quirks);
+}
+END_TEST
+
+/* 8XY6 should shift V[Y] into V[X] on the original interpreter. */
+START_TEST(test_quirks_shift)
+{
+    set_quirks(&cpu, QUIRKS_CHIP8);
+    cpu.v[4] = 0x10;
+    cpu.v[5] = 0x45;
+    put_opcode(0x8456);
+    step_machine(&cpu);
+    ck_assert_int_eq(0x22, cpu.v[4]);
+    ck_assert_int_eq(0x45, cpu.v[5]);
+    ck_assert_int_eq(1, cpu.v[15]);
+}
+END_TEST
+
+/* FX65 should leave I past the last register loaded. */
+START_TEST(test_quirks_memory)
+{
+    set_quirks(&cpu, QUIRKS_XOCHIP);
+    cpu.i = 0x300;
+    cpu.mem[0x302] = 0x99;
+    put_opcode(0xF265);
+    step_machine(&cpu);
+    ck_assert_int_eq(0x99, cpu.v[2]);
+    ck_assert_int_eq(0x303, cpu.i);
+}
+END_TEST
+
+/* BXNN should jump relative to V[X] on SUPER-CHIP. */
+START_TEST(test_quirks_jump)
+{
+    set_quirks(&cpu, QUIRKS_SCHIP);
+    cpu.v[0] = 0x10;
+    cpu.v[3] = 0x20;
+    put_opcode(0xB300);
+    step_machine(&cpu);
+    ck_assert_int_eq(0x320, cpu.pc);
+}
+END_TEST
+
+/* Sprites crossing the right edge should be clipped, not wrapped. */
+START_TEST(test_quirks_clip)
+{
+    set_quirks(&cpu, QUIRKS_CHIP8);
+    cpu.v[0] = 60;
+    cpu.v[1] = 0;
+    cpu.i = 0x300;
+    cpu.mem[0x300] = 0xFF;
+    put_opcode(0xD011);
+    step_machine(&cpu);
+    ck_assert_int_eq(1, cpu.screen[63]);
+    ck_assert_int_eq(0, cpu.screen[0]);
+    ck_assert_int_eq(0, cpu.v[15]);
+
+    uint64_t hash = screen_hash(&cpu);
+    screen_rehash(&cpu);
+    ck_assert(hash == screen_hash(&cpu));
+}
+END_TEST
+
+/* Sprites should still wrap when the origin is past the edge. */
+START_TEST(test_quirks_clip_origin)
+{
+    set_quirks(&cpu, QUIRKS_CHIP8);
+    cpu.v[0] = 64 + 2;
+    cpu.v[1] = 32 + 1;
+    cpu.i = 0x300;
+    cpu.mem[0x300] = 0x80;
+    put_opcode(0xD011);
+    step_machine(&cpu);
+    ck_assert_int_eq(1, cpu.screen[64 * 1 + 2]);
+}
+END_TEST
+
+/* Logic opcodes should reset V[F] on the original interpreter. */
+START_TEST(test_quirks_logic)
+{
+    set_quirks(&cpu, QUIRKS_CHIP8);
+    cpu.v[1] = 0x0F;
+    cpu.v[2] = 0xF0;
+    cpu.v[15] = 1;
+    put_opcode(0x8121);
+    step_machine(&cpu);
+    ck_assert_int_eq(0xFF, cpu.v[1]);
+    ck_assert_int_eq(0, cpu.v[15]);
+}
+END_TEST
+
+/* The default profile keeps the behaviour of previous versions. */
+START_TEST(test_quirks_default)
+{
+    cpu.v[4] = 0x10;
+    cpu.v[5] = 0x45;
+    cpu.v[15] = 1;
+    cpu.i = 0x300;
+    put_opcode(0x8456);
+    step_machine(&cpu);
+    ck_assert_int_eq(0x08, cpu.v[4]);
+    ck_assert_int_eq(0, cpu.v[15]);
+
+    cpu.pc = 0x200;
+    put_opcode(0xF265);
+    step_machine(&cpu);
+    ck_assert_int_eq(0x300, cpu.i);
+}
+END_TEST
+
+static TCase*
+tcase_quirks()
+{
+    TCase* tcase = tcase_create("Profiles");
+    tcase_add_checked_fixture(tcase, setup_cpu, NULL);
+    tcase_add_test(tcase, test_quirks_names);
+    tcase_add_test(tcase, test_quirks_shift);
+    tcase_add_test(tcase, test_quirks_memory);
+    tcase_add_test(tcase, test_quirks_jump);
+    tcase_add_test(tcase, test_quirks_clip);
+    tcase_add_test(tcase, test_quirks_clip_origin);
+    tcase_add_test(tcase, test_quirks_logic);
+    tcase_add_test(tcase, test_quirks_default);
+    return tcase;
+}
+
+Suite*
+create_quirks_suite()
+{
+    Suite* suite = suite_create("Quirks");
+    suite_add_tcase(suite, tcase_quirks());
+    return suite;
+}
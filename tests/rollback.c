@@ -0,0 +1,182 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * File: tests/rollback.c
+ * Description: Unit test related to two player rollback.
+ */
+
+#include <check.h>
+#include <string.h>
+#include <lib8/rollback.h>
+#include "program.h"
+
+#define FRAMES 120
+
+static struct machine_t boot, sides[2], single;
+static struct rollback_t* rb[2];
+static word keys[2][FRAMES];
+
+/*
+ * 0x200: E19E  SKP V1
+ * 0x202: 1206  JP 0x206
+ * 0x204: 7201  ADD V2, 1
+ * 0x206: E09E  SKP V0
+ * 0x208: 120C  JP 0x20C
+ * 0x20A: 7301  ADD V3, 1
+ * 0x20C: C4FF  RND V4, 0xFF
+ * 0x20E: 8544  ADD V5, V4
+ * 0x210: 1200  JP 0x200
+ */
+static word program[] = {
+    0xE19E, 0x1206, 0x7201, 0xE09E, 0x120C, 0x7301, 0xC4FF, 0x8544, 0x1200
+};
+
+static void
+setup_rollback(void)
+{
+    init_machine(&boot);
+    load_program(&boot, program, 9);
+    boot.v[1] = 1;
+    seed_machine(&boot, 42);
+    for (int k = 0; k < 2; k++) {
+        memcpy(&sides[k], &boot, sizeof(struct machine_t));
+        rb[k] = rollback_create(&sides[k], 9);
+        ck_assert_ptr_ne(NULL, rb[k]);
+    }
+
+    /* Side 0 holds key 0 now and then, side 1 holds key 1. */
+    for (int f = 0; f < FRAMES; f++) {
+        keys[0][f] = (f / 7) % 2 ? 0x0001 : 0;
+        keys[1][f] = (f / 5) % 3 ? 0x0002 : 0;
+    }
+}
+
+static void
+teardown_rollback(void)
+{
+    rollback_destroy(rb[0]);
+    rollback_destroy(rb[1]);
+}
+
+/* Machine that gets every key in time. */
+static void
+run_single(int frames)
+{
+    memcpy(&single, &boot, sizeof(struct machine_t));
+    for (int f = 0; f < frames; f++) {
+        single.keypad = f < FRAMES ? keys[0][f] | keys[1][f] : 0;
+        run_frames(&single, 1, 9);
+    }
+}
+
+/* Sides getting the keys late should end as the machine getting them. */
+START_TEST(test_rollback_late)
+{
+    int reruns = 0;
+    for (int f = 0; f < FRAMES; f++) {
+        for (int k = 0; k < 2; k++) {
+            int run = rollback_frame(rb[k], keys[k][f]);
+            ck_assert_int_ge(run, 0);
+            reruns += run;
+        }
+
+        /* Keys arrive three frames late. */
+        if (f >= 3) {
+            ck_assert_int_eq(0, rollback_remote(rb[0], f - 3, keys[1][f - 3]));
+            ck_assert_int_eq(0, rollback_remote(rb[1], f - 3, keys[0][f - 3]));
+        }
+    }
+    ck_assert_int_gt(reruns, 0);
+
+    /* Deliver the last keys and release everything on the next frame. */
+    for (int f = FRAMES - 3; f < FRAMES; f++) {
+        rollback_remote(rb[0], f, keys[1][f]);
+        rollback_remote(rb[1], f, keys[0][f]);
+    }
+    rollback_remote(rb[0], FRAMES, 0);
+    rollback_remote(rb[1], FRAMES, 0);
+    rollback_frame(rb[0], 0);
+    rollback_frame(rb[1], 0);
+
+    run_single(FRAMES + 1);
+    ck_assert_int_eq(FRAMES + 1, rollback_current(rb[0]));
+    ck_assert(rollback_state_hash(&single) == rollback_state_hash(&sides[0]));
+    ck_assert(rollback_state_hash(&single) == rollback_state_hash(&sides[1]));
+    ck_assert_int_eq(single.v[2], sides[0].v[2]);
+    ck_assert_int_eq(single.v[3], sides[1].v[3]);
+}
+END_TEST
+
+/* A side should not get more than a window ahead of the remote keys. */
+START_TEST(test_rollback_window)
+{
+    for (int f = 0; f < ROLLBACK_WINDOW; f++)
+        ck_assert_int_eq(0, rollback_frame(rb[0], 0));
+    ck_assert_int_eq(-1, rollback_frame(rb[0], 0));
+    ck_assert_int_eq(-1, rollback_remote(rb[0], 2 * ROLLBACK_WINDOW, 0));
+    ck_assert_int_eq(0, rollback_remote(rb[0], 0, 0));
+    ck_assert_int_eq(0, rollback_frame(rb[0], 0));
+    ck_assert_int_eq(-1, rollback_remote(rb[0], 0, 0));
+}
+END_TEST
+
+/* Hashes should match while in sync and tell a desync. */
+START_TEST(test_rollback_hash)
+{
+    long frame[2] = { -1, -1 };
+    uint64_t hash[2];
+    for (int f = 0; f < ROLLBACK_HASH_PERIOD + 1; f++) {
+        for (int k = 0; k < 2; k++) {
+            rollback_frame(rb[k], 0);
+            rollback_remote(rb[k], f, 0);
+            long at;
+            uint64_t h;
+            if (rollback_new_hash(rb[k], &at, &h)) {
+                frame[k] = at;
+                hash[k] = h;
+            }
+        }
+        if (f == 10)
+            sides[1].v[9] = 1;
+    }
+    ck_assert_int_eq(ROLLBACK_HASH_PERIOD, frame[0]);
+    ck_assert_int_eq(ROLLBACK_HASH_PERIOD, frame[1]);
+    ck_assert_int_eq(0, rollback_check(rb[0], 0, rollback_state_hash(&boot)));
+    ck_assert_int_eq(1, rollback_check(rb[0], frame[1], hash[1]));
+    ck_assert_int_eq(-1, rollback_check(rb[0], 2 * ROLLBACK_HASH_PERIOD, 0));
+}
+END_TEST
+
+static TCase*
+tcase_rollback()
+{
+    TCase* tcase = tcase_create("Two players");
+    tcase_add_checked_fixture(tcase, setup_rollback, teardown_rollback);
+    tcase_add_test(tcase, test_rollback_late);
+    tcase_add_test(tcase, test_rollback_window);
+    tcase_add_test(tcase, test_rollback_hash);
+    return tcase;
+}
+
+Suite*
+create_rollback_suite()
+{
+    Suite* suite = suite_create("Rollback");
+    suite_add_tcase(suite, tcase_rollback());
+    return suite;
+}
@@ -0,0 +1,145 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * File: tests/scale.c
+ * Description: Unit test related to the pixel art upscalers.
+ */
+
+#include <check.h>
+#include <string.h>
+#include <lib8/scale.h>
+
+#define PITCH SCALE_MAX_WIDTH
+
+static char screen[8192];
+static uint32_t out[SCALE_MAX_WIDTH * SCALE_MAX_HEIGHT];
+
+static void
+setup_scale(void)
+{
+    memset(screen, 0, sizeof(screen));
+    memset(out, 0x55, sizeof(out));
+}
+
+/* Is an output pixel lit? */
+static int
+lit(int x, int y)
+{
+    ck_assert(out[PITCH * y + x] == 0 || out[PITCH * y + x] == 0xFFFFFFFF);
+    return out[PITCH * y + x] != 0;
+}
+
+/* Filters should be found by name and know their size. */
+START_TEST(test_scale_names)
+{
+    ck_assert_int_eq(SCALE_NONE, scale_by_name("none"));
+    ck_assert_int_eq(SCALE_3X, scale_by_name("scale3x"));
+    ck_assert_int_eq(-1, scale_by_name("hq4x"));
+    ck_assert_int_eq(1, scale_factor(SCALE_NONE));
+    ck_assert_int_eq(2, scale_factor(SCALE_2X));
+    ck_assert_int_eq(3, scale_factor(SCALE_3X));
+    ck_assert_int_eq(2, scale_factor(SCALE_EAGLE));
+}
+END_TEST
+
+/* Without a filter every pixel should be copied. */
+START_TEST(test_scale_none)
+{
+    screen[127] = 1;
+    screen[128 * 63 + 64] = 1;
+    scale_screen(SCALE_NONE, screen, 1, out, PITCH);
+    ck_assert(lit(127, 0));
+    ck_assert(!lit(0, 0));
+    ck_assert(lit(64, 63));
+    ck_assert(!lit(63, 63));
+}
+END_TEST
+
+/* Lone pixels should stay squares, edges should not wrap around. */
+START_TEST(test_scale_lone)
+{
+    screen[64 * 5 + 63] = 1;
+    for (int filter = SCALE_2X; filter <= SCALE_EAGLE; filter++) {
+        int f = scale_factor(filter);
+        scale_screen(filter, screen, 0, out, PITCH);
+        for (int y = 0; y < 32 * f; y++) {
+            for (int x = 0; x < 64 * f; x++) {
+                int inside = x >= 63 * f && y >= 5 * f && y < 6 * f;
+                ck_assert_int_eq(inside, lit(x, y));
+            }
+        }
+    }
+}
+END_TEST
+
+/* Scale2x and Scale3x should fill the steps of a diagonal line. */
+START_TEST(test_scale_diagonal)
+{
+    for (int k = 0; k < 8; k++)
+        screen[64 * (k + 4) + k + 4] = 1;
+
+    /* (6, 5) is next to (5, 5) and above (6, 6). */
+    scale_screen(SCALE_2X, screen, 0, out, PITCH);
+    ck_assert(lit(12, 11));
+    ck_assert(!lit(13, 10));
+    ck_assert(!lit(12, 10));
+    ck_assert(lit(10, 10) && lit(11, 11));
+
+    scale_screen(SCALE_3X, screen, 0, out, PITCH);
+    ck_assert(lit(18, 17));
+    ck_assert(!lit(20, 15));
+    ck_assert(lit(16, 16));
+}
+END_TEST
+
+/* Eagle should fill corners surrounded by lit pixels. */
+START_TEST(test_scale_eagle)
+{
+    screen[128 * 10 + 10] = 1;
+    screen[128 * 10 + 11] = 1;
+    screen[128 * 11 + 10] = 1;
+    scale_screen(SCALE_EAGLE, screen, 1, out, PITCH);
+
+    /* The top left corner of (11, 11) sees (10, 10), (11, 10), (10, 11). */
+    ck_assert(lit(22, 22));
+    ck_assert(!lit(23, 22));
+    ck_assert(!lit(23, 23));
+    ck_assert(lit(20, 20) && lit(21, 21));
+}
+END_TEST
+
+static TCase*
+tcase_scale()
+{
+    TCase* tcase = tcase_create("Upscalers");
+    tcase_add_checked_fixture(tcase, setup_scale, NULL);
+    tcase_add_test(tcase, test_scale_names);
+    tcase_add_test(tcase, test_scale_none);
+    tcase_add_test(tcase, test_scale_lone);
+    tcase_add_test(tcase, test_scale_diagonal);
+    tcase_add_test(tcase, test_scale_eagle);
+    return tcase;
+}
+
+Suite*
+create_scale_suite()
+{
+    Suite* suite = suite_create("Scale");
+    suite_add_tcase(suite, tcase_scale());
+    return suite;
+}
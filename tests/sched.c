@@ -0,0 +1,220 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * File: tests/sched.c
+ * Description: Unit test related to the session scheduler.
+ */
+
+#include <check.h>
+#include <string.h>
+#include <lib8/input.h>
+#include <lib8/sched.h>
+#include "program.h"
+
+#define SESSIONS 16
+
+/*
+ * 0x200: 6005  LD V0, 5
+ * 0x202: F015  LD DT, V0
+ * 0x204: F107  LD V1, DT
+ * 0x206: 3100  SE V1, 0
+ * 0x208: 1204  JP 0x204
+ * 0x20A: F20A  LD V2, K
+ * 0x20C: 7301  ADD V3, 1
+ * 0x20E: 120C  JP 0x20C
+ */
+static word program[] = {
+    0x6005, 0xF015, 0xF107, 0x3100, 0x1204, 0xF20A, 0x7301, 0x120C
+};
+
+static struct machine_t boot;
+static struct machine_t machines[SESSIONS], single[SESSIONS];
+static struct sched_t* sched;
+
+/* Keys for every session: frame number the key goes down. */
+struct script_t
+{
+    long frame;
+    long press;
+    int outputs;
+};
+
+static struct script_t scripts[SESSIONS];
+
+static word
+keys_of(long frame, long press)
+{
+    return frame >= press ? 0x0010 : 0;
+}
+
+static word
+script_input(void* data)
+{
+    struct script_t* script = data;
+    return keys_of(script->frame++, script->press);
+}
+
+static void
+script_output(void* data, const struct machine_t* cpu)
+{
+    struct script_t* script = data;
+    script->outputs++;
+}
+
+static void
+setup_sched(void)
+{
+    init_machine(&boot);
+    load_program(&boot, program, 8);
+    memset(scripts, 0, sizeof(scripts));
+    sched = sched_create(3);
+    ck_assert_ptr_ne(NULL, sched);
+}
+
+static void
+teardown_sched(void)
+{
+    sched_destroy(sched);
+}
+
+/* Sessions should park on DT loops and key waits and wake up. */
+START_TEST(test_sched_park)
+{
+    memcpy(&machines[0], &boot, sizeof(struct machine_t));
+    scripts[0].press = 8;
+    struct session_t* session = sched_add(sched, &machines[0], 4,
+            script_input, script_output, &scripts[0]);
+    ck_assert_ptr_ne(NULL, session);
+
+    ck_assert_int_eq(1, sched_run_frame(sched));
+    ck_assert_int_eq(SESSION_WAIT_DT, session_state(session));
+    for (int frame = 1; frame < 5; frame++) {
+        ck_assert_int_eq(0, sched_run_frame(sched));
+    }
+    ck_assert_int_eq(0, machines[0].dt);
+    ck_assert_int_eq(SESSION_RUNNING, session_state(session));
+
+    ck_assert_int_eq(1, sched_run_frame(sched));
+    ck_assert_int_eq(SESSION_WAIT_KEY, session_state(session));
+    ck_assert_int_eq(0, sched_run_frame(sched));
+    ck_assert_int_eq(0, sched_run_frame(sched));
+    ck_assert_int_eq(1, sched_run_frame(sched));
+    ck_assert_int_eq(SESSION_RUNNING, session_state(session));
+    ck_assert_int_eq(4, machines[0].v[2]);
+    ck_assert_int_eq(9, scripts[0].outputs);
+}
+END_TEST
+
+/* Parked or not, sessions should match machines run one at a time. */
+START_TEST(test_sched_exact)
+{
+    for (int k = 0; k < SESSIONS; k++) {
+        memcpy(&machines[k], &boot, sizeof(struct machine_t));
+        memcpy(&single[k], &boot, sizeof(struct machine_t));
+        scripts[k].press = k;
+        sched_add(sched, &machines[k], 3 + k, script_input, NULL, &scripts[k]);
+    }
+    for (int frame = 0; frame < 40; frame++) {
+        sched_run_frame(sched);
+        for (int k = 0; k < SESSIONS; k++) {
+            single[k].keypad = keys_of(frame, k);
+            run_machine(&single[k], 3 + k);
+            tick_timers(&single[k]);
+            ck_assert_int_eq(single[k].pc, machines[k].pc);
+            ck_assert_int_eq(single[k].dt, machines[k].dt);
+            ck_assert_uint_eq(single[k].clock, machines[k].clock);
+            ck_assert_int_eq(0, memcmp(single[k].v, machines[k].v, 16));
+        }
+    }
+}
+END_TEST
+
+/* Parked sessions should keep the clock and apply queued key events. */
+START_TEST(test_sched_queue)
+{
+    struct input_event_t events[] = {
+        { 50, 4, 1 }, { 70, 4, 0 }
+    };
+    struct input_queue_t* queues[2];
+    for (int k = 0; k < 2; k++) {
+        queues[k] = input_create(4);
+        ck_assert_int_eq(2, input_push(queues[k], events, 2));
+    }
+    memcpy(&machines[0], &boot, sizeof(struct machine_t));
+    memcpy(&single[0], &boot, sizeof(struct machine_t));
+    machines[0].input = queues[0];
+    single[0].input = queues[1];
+    struct session_t* session = sched_add(sched, &machines[0], 4, NULL,
+            NULL, NULL);
+
+    for (int frame = 0; frame < 30; frame++) {
+        sched_run_frame(sched);
+        run_machine(&single[0], 4);
+        tick_timers(&single[0]);
+        if (frame == 8)
+            ck_assert_int_eq(SESSION_WAIT_KEY, session_state(session));
+        ck_assert_uint_eq(single[0].clock, machines[0].clock);
+        ck_assert_int_eq(single[0].pc, machines[0].pc);
+        ck_assert_int_eq(single[0].keypad, machines[0].keypad);
+        ck_assert_int_eq(0, memcmp(single[0].v, machines[0].v, 16));
+    }
+    ck_assert_int_eq(SESSION_RUNNING, session_state(session));
+    ck_assert_int_eq(4, machines[0].v[2]);
+
+    sched_remove(sched, session);
+    input_destroy(queues[0]);
+    input_destroy(queues[1]);
+}
+END_TEST
+
+/* Sessions that exit should not run anymore. */
+START_TEST(test_sched_exit)
+{
+    memcpy(&machines[0], &boot, sizeof(struct machine_t));
+    machines[0].mem[0x200] = 0x00;
+    machines[0].mem[0x201] = 0xFD;
+    struct session_t* session = sched_add(sched, &machines[0], 4, NULL,
+            script_output, &scripts[0]);
+    ck_assert_int_eq(1, sched_run_frame(sched));
+    ck_assert_int_eq(SESSION_EXITED, session_state(session));
+    ck_assert_int_eq(0, sched_run_frame(sched));
+    ck_assert_int_eq(1, scripts[0].outputs);
+    sched_remove(sched, session);
+    ck_assert_int_eq(0, sched_run_frame(sched));
+}
+END_TEST
+
+static TCase*
+tcase_sched()
+{
+    TCase* tcase = tcase_create("Sessions");
+    tcase_add_checked_fixture(tcase, setup_sched, teardown_sched);
+    tcase_add_test(tcase, test_sched_park);
+    tcase_add_test(tcase, test_sched_exact);
+    tcase_add_test(tcase, test_sched_queue);
+    tcase_add_test(tcase, test_sched_exit);
+    return tcase;
+}
+
+Suite*
+create_sched_suite()
+{
+    Suite* suite = suite_create("Scheduler");
+    suite_add_tcase(suite, tcase_sched());
+    return suite;
+}
@@ -162,6 +162,64 @@ START_TEST(test_screen_clear_pixel)
 }
 END_TEST
 
+/* Check the incremental hash against one computed from scratch. */
+static void
+assert_hash(void)
+{
+    static struct machine_t copy;
+    memcpy(&copy, &cpu, sizeof(struct machine_t));
+    screen_rehash(&copy);
+    ck_assert_uint_eq(screen_hash(&copy), screen_hash(&cpu));
+}
+
+static void
+run_opcode(word opcode)
+{
+    cpu.mem[0x200] = opcode >> 8;
+    cpu.mem[0x201] = opcode & 0xFF;
+    cpu.pc = 0x200;
+    step_machine(&cpu);
+    assert_hash();
+}
+
+START_TEST(test_screen_hash)
+{
+    ck_assert_uint_eq(0, screen_hash(&cpu));
+    cpu.v[0] = 60;
+    cpu.v[1] = 30;
+    cpu.i = 0x50 + 8 * 5;
+    run_opcode(0xD015);
+    uint64_t drawn = screen_hash(&cpu);
+    ck_assert_uint_ne(0, drawn);
+    run_opcode(0xD015);
+    ck_assert_uint_eq(0, screen_hash(&cpu));
+    run_opcode(0xD015);
+    ck_assert_uint_eq(drawn, screen_hash(&cpu));
+
+    run_opcode(0x00C3);
+    run_opcode(0x00FB);
+    run_opcode(0x00FC);
+    run_opcode(0x00FF);
+    run_opcode(0xD010);
+    run_opcode(0x00C2);
+    run_opcode(0x00FE);
+    screen_fill_row(&cpu, 3);
+    screen_clear_column(&cpu, 5);
+    screen_set_pixel(&cpu, 9, 9);
+    screen_clear_pixel(&cpu, 3, 7);
+    assert_hash();
+    run_opcode(0x00E0);
+}
+END_TEST
+
+static TCase*
+tcase_screen_hash()
+{
+    TCase* tcase = setup_tcase("screen_hash()");
+    tcase_add_test(tcase, test_screen_hash);
+    return tcase;
+}
+
 static TCase*
 tcase_screen_fill_column()
 {
@@ -229,5 +287,6 @@ create_screen_suite()
     suite_add_tcase(suite, tcase_screen_get_pixel());
     suite_add_tcase(suite, tcase_screen_set_pixel());
     suite_add_tcase(suite, tcase_screen_clear_pixel());
+    suite_add_tcase(suite, tcase_screen_hash());
     return suite;
 }
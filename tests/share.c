@@ -0,0 +1,127 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * File: tests/share.c
+ * Description: Unit test related to shared frames.
+ */
+
+#include <check.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <lib8/share.h>
+
+static struct machine_t cpu;
+static struct share_segment_t* share;
+static char name[64];
+
+static void
+setup_share(void)
+{
+    init_machine(&cpu);
+    snprintf(name, sizeof(name), "/chip8-test-%ld", (long) getpid());
+    share = share_create(name);
+    ck_assert_ptr_ne(NULL, share);
+}
+
+static void
+teardown_share(void)
+{
+    share_destroy(share, name);
+}
+
+/* Consumers should read the last frame published. */
+START_TEST(test_share_frame)
+{
+    struct share_segment_t* seen = share_attach(name);
+    ck_assert_ptr_ne(NULL, seen);
+
+    cpu.screen[0] = 1;
+    cpu.keypad = 0x0101;
+    share_publish(share, &cpu);
+    cpu.screen[1] = 1;
+    share_publish(share, &cpu);
+
+    int slot;
+    uint32_t seq = share_read_begin(seen, &slot);
+    const struct share_frame_t* frame = &seen->frames[slot];
+    ck_assert_int_eq(2, frame->frame);
+    ck_assert_int_eq(0x0101, frame->keypad);
+    ck_assert_int_eq(0, memcmp(cpu.screen, frame->screen, sizeof(cpu.screen)));
+    ck_assert(share_read_end(seen, slot, seq));
+    share_detach(seen);
+}
+END_TEST
+
+/* A read should fail if the slot is written while being read. */
+START_TEST(test_share_torn)
+{
+    share_publish(share, &cpu);
+    int slot;
+    uint32_t seq = share_read_begin(share, &slot);
+    share_publish(share, &cpu);
+    ck_assert(share_read_end(share, slot, seq));
+    share_publish(share, &cpu);
+    ck_assert(!share_read_end(share, slot, seq));
+}
+END_TEST
+
+/* Keys pressed by consumers should be published and seen. */
+START_TEST(test_share_keys)
+{
+    struct share_segment_t* seen = share_attach(name);
+    ck_assert_ptr_ne(NULL, seen);
+    share_set_keys(seen, 0x0030, 1);
+    share_set_keys(seen, 0x0010, 0);
+    ck_assert_int_eq(0x0020, share_keys(share));
+
+    cpu.keypad = 0x0001;
+    share_publish(share, &cpu);
+    int slot;
+    share_read_begin(seen, &slot);
+    ck_assert_int_eq(0x0021, seen->frames[slot].keypad);
+    share_detach(seen);
+}
+END_TEST
+
+/* Segments that do not exist cannot be attached. */
+START_TEST(test_share_missing)
+{
+    ck_assert_ptr_eq(NULL, share_attach("/chip8-test-missing"));
+}
+END_TEST
+
+static TCase*
+tcase_share()
+{
+    TCase* tcase = tcase_create("Shared frames");
+    tcase_add_checked_fixture(tcase, setup_share, teardown_share);
+    tcase_add_test(tcase, test_share_frame);
+    tcase_add_test(tcase, test_share_torn);
+    tcase_add_test(tcase, test_share_keys);
+    tcase_add_test(tcase, test_share_missing);
+    return tcase;
+}
+
+Suite*
+create_share_suite()
+{
+    Suite* suite = suite_create("Share");
+    suite_add_tcase(suite, tcase_share());
+    return suite;
+}
@@ -0,0 +1,124 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * File: tests/snapshot.c
+ * Description: Unit test related to snapshots and running ahead.
+ */
+
+#include <check.h>
+#include <string.h>
+#include <lib8/cpu.h>
+#include "program.h"
+
+static struct machine_t cpu, snap, later;
+
+/*
+ * 0x200: 6005  LD V0, 5
+ * 0x202: F018  LD ST, V0
+ * 0x204: 7101  ADD V1, 1
+ * 0x206: 1204  JP 0x204
+ */
+static word program[] = { 0x6005, 0xF018, 0x7101, 0x1204 };
+
+static int speaker_calls;
+
+static int
+no_keys(char key)
+{
+    return 0;
+}
+
+static void
+count_speaker(int enabled)
+{
+    speaker_calls++;
+}
+
+static void
+setup_snapshot(void)
+{
+    init_machine(&cpu);
+    load_program(&cpu, program, 4);
+    cpu.speaker = count_speaker;
+    speaker_calls = 0;
+    memset(&snap, 0, sizeof(snap));
+}
+
+/* Frames should be steps followed by a tick of the timers. */
+START_TEST(test_run_frames)
+{
+    run_frames(&cpu, 3, 4);
+    ck_assert_int_eq(2, cpu.st);
+    ck_assert_int_eq(5, cpu.v[1]);
+    ck_assert_int_eq(3, speaker_calls);
+}
+END_TEST
+
+/* A snapshot should keep its own bindings. */
+START_TEST(test_snapshot_bindings)
+{
+    snap.keydown = no_keys;
+    snapshot_machine(&snap, &cpu);
+    ck_assert_ptr_eq(no_keys, snap.keydown);
+    ck_assert_ptr_eq(NULL, snap.speaker);
+    ck_assert_int_eq(0x200, snap.pc);
+    ck_assert_int_eq(0, memcmp(cpu.mem, snap.mem, MEMSIZ + MEMGUARD));
+}
+END_TEST
+
+/* Running ahead on a snapshot should predict the machine silently. */
+START_TEST(test_snapshot_ahead)
+{
+    run_frames(&cpu, 1, 4);
+    snapshot_machine(&snap, &cpu);
+    run_frames(&snap, 2, 4);
+    ck_assert_int_eq(1, speaker_calls);
+    ck_assert_int_eq(0x204, cpu.pc);
+    ck_assert_int_eq(4, cpu.st);
+
+    memcpy(&later, &cpu, sizeof(later));
+    run_frames(&later, 2, 4);
+    ck_assert_int_eq(later.pc, snap.pc);
+    ck_assert_int_eq(later.st, snap.st);
+    ck_assert_int_eq(0, memcmp(later.v, snap.v, 16));
+
+    /* Restoring brings the machine back. */
+    snapshot_machine(&later, &cpu);
+    ck_assert_int_eq(cpu.v[1], later.v[1]);
+    ck_assert_ptr_eq(count_speaker, later.speaker);
+}
+END_TEST
+
+static TCase*
+tcase_snapshot()
+{
+    TCase* tcase = tcase_create("Snapshots");
+    tcase_add_checked_fixture(tcase, setup_snapshot, NULL);
+    tcase_add_test(tcase, test_run_frames);
+    tcase_add_test(tcase, test_snapshot_bindings);
+    tcase_add_test(tcase, test_snapshot_ahead);
+    return tcase;
+}
+
+Suite*
+create_snapshot_suite()
+{
+    Suite* suite = suite_create("Snapshot");
+    suite_add_tcase(suite, tcase_snapshot());
+    return suite;
+}
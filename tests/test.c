@@ -27,11 +27,95 @@ create_superchip_opcodes_suite();
 extern Suite*
 create_screen_suite();
 
+extern Suite*
+create_hex_suite();
+
+extern Suite*
+create_analyze_suite();
+
+extern Suite*
+create_aot_suite();
+
+extern Suite*
+create_fusion_suite();
+
+extern Suite*
+create_video_suite();
+
+extern Suite*
+create_batch_suite();
+
+extern Suite*
+create_lanes_suite();
+
+extern Suite*
+create_quirks_suite();
+
+extern Suite*
+create_guard_suite();
+
+extern Suite*
+create_sched_suite();
+
+extern Suite*
+create_share_suite();
+
+extern Suite*
+create_compact_suite();
+
+extern Suite*
+create_snapshot_suite();
+
+extern Suite*
+create_rollback_suite();
+
+extern Suite*
+create_triple_suite();
+
+extern Suite*
+create_scale_suite();
+
+extern Suite*
+create_trace_suite();
+
+extern Suite*
+create_embed_suite();
+
+extern Suite*
+create_explore_suite();
+
+extern Suite*
+create_timing_suite();
+
+extern Suite*
+create_input_suite();
+
 int main(int argc, char** argv)
 {
     SRunner* runner = srunner_create(create_chip8_opcodes_suite());
     srunner_add_suite(runner, create_superchip_opcodes_suite());
     srunner_add_suite(runner, create_screen_suite());
+    srunner_add_suite(runner, create_hex_suite());
+    srunner_add_suite(runner, create_analyze_suite());
+    srunner_add_suite(runner, create_aot_suite());
+    srunner_add_suite(runner, create_fusion_suite());
+    srunner_add_suite(runner, create_video_suite());
+    srunner_add_suite(runner, create_batch_suite());
+    srunner_add_suite(runner, create_lanes_suite());
+    srunner_add_suite(runner, create_quirks_suite());
+    srunner_add_suite(runner, create_guard_suite());
+    srunner_add_suite(runner, create_sched_suite());
+    srunner_add_suite(runner, create_share_suite());
+    srunner_add_suite(runner, create_compact_suite());
+    srunner_add_suite(runner, create_snapshot_suite());
+    srunner_add_suite(runner, create_rollback_suite());
+    srunner_add_suite(runner, create_triple_suite());
+    srunner_add_suite(runner, create_scale_suite());
+    srunner_add_suite(runner, create_trace_suite());
+    srunner_add_suite(runner, create_embed_suite());
+    srunner_add_suite(runner, create_explore_suite());
+    srunner_add_suite(runner, create_timing_suite());
+    srunner_add_suite(runner, create_input_suite());
     srunner_run_all(runner, CK_VERBOSE);
     int failed = srunner_ntests_failed(runner);
     srunner_free(runner);
@@ -0,0 +1,158 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File: tests/timing.c
+ * Description: Unit test related to the COSMAC VIP timing model.
+ */
+
+#include <check.h>
+#include <lib8/cpu.h>
+#include "program.h"
+
+static struct machine_t cpu;
+
+/* Cycles a frame has for the interpreter. */
+#define BUDGET (VIP_FRAME_CYCLES - VIP_DISPLAY_CYCLES)
+
+static void
+setup_timing(void)
+{
+    init_machine(&cpu);
+}
+
+/* Costs should follow the work the VIP does for every opcode. */
+START_TEST(test_timing_costs)
+{
+    ck_assert_int_lt(vip_cycles(&cpu, 0x6012), vip_cycles(&cpu, 0x8014));
+    ck_assert_int_lt(vip_cycles(&cpu, 0x8014), vip_cycles(&cpu, 0xD005));
+    ck_assert_int_lt(vip_cycles(&cpu, 0xD005), vip_cycles(&cpu, 0x00E0));
+
+    /* Sprites off a byte boundary are shifted bit by bit. */
+    int aligned = vip_cycles(&cpu, 0xD005);
+    cpu.v[0] = 3;
+    ck_assert_int_lt(aligned, vip_cycles(&cpu, 0xD005));
+
+    /* BCD of larger values takes more subtractions. */
+    int small = vip_cycles(&cpu, 0xF033);
+    cpu.v[0] = 255;
+    ck_assert_int_lt(small, vip_cycles(&cpu, 0xF033));
+
+    /* Register dumps cost per register. */
+    ck_assert_int_lt(vip_cycles(&cpu, 0xF155), vip_cycles(&cpu, 0xFF55));
+}
+END_TEST
+
+/* A frame should run what fits in its budget and owe the rest. */
+START_TEST(test_timing_budget)
+{
+    static const word loop[] = {
+        0x7001,     // V0 += 1
+        0x1200      // jump to 0x200
+    };
+    load_program(&cpu, loop, 2);
+
+    int pair = vip_cycles(&cpu, 0x7001) + vip_cycles(&cpu, 0x1200);
+    int count = run_vip_frame(&cpu, 0);
+    int spent = (count / 2) * pair + (count & 1) * vip_cycles(&cpu, 0x7001);
+    ck_assert_int_ge(spent, BUDGET);
+    ck_assert_int_lt(spent - vip_cycles(&cpu, 0x1200), BUDGET);
+    ck_assert_int_eq(spent - BUDGET, cpu.cycles);
+    ck_assert_int_eq((count + 1) / 2, cpu.v[0]);
+
+    /* Over many frames, the instructions run match the cycles. */
+    for (int frame = 1; frame < 60; frame++)
+        count += run_vip_frame(&cpu, 0);
+    ck_assert_int_ge(count, 60 * BUDGET * 2 / pair - 1);
+    ck_assert_int_le(count, 60 * BUDGET * 2 / pair + 1);
+}
+END_TEST
+
+/* With vblank, a frame should end right after a sprite is drawn. */
+START_TEST(test_timing_vblank)
+{
+    static const word draw[] = {
+        0x6000,     // V0 = 0
+        0xD005,     // draw 5 rows at (V0, V0)
+        0x1202      // jump to the draw
+    };
+    load_program(&cpu, draw, 3);
+
+    ck_assert_int_eq(2, run_vip_frame(&cpu, 1));
+    ck_assert_int_eq(0, cpu.cycles);
+    ck_assert_int_eq(2, run_vip_frame(&cpu, 1));
+    ck_assert_int_gt(run_vip_frame(&cpu, 0), 2);
+}
+END_TEST
+
+/* A machine waiting for a key should idle until the frame is over. */
+START_TEST(test_timing_wait_key)
+{
+    static const word wait[] = {
+        0xF50A,     // V5 = next key
+        0x1202      // loop
+    };
+    load_program(&cpu, wait, 2);
+
+    /* FX0A polls the keypad until the budget runs out, and owes the rest. */
+    int left = BUDGET - vip_cycles(&cpu, 0xF50A);
+    int polls = (left + VIP_FETCH_CYCLES - 1) / VIP_FETCH_CYCLES;
+    ck_assert_int_eq(1, run_vip_frame(&cpu, 0));
+    ck_assert_int_eq(polls * VIP_FETCH_CYCLES - left, cpu.cycles);
+
+    left = BUDGET - cpu.cycles;
+    polls = (left + VIP_FETCH_CYCLES - 1) / VIP_FETCH_CYCLES;
+    ck_assert_int_eq(0, run_vip_frame(&cpu, 0));
+    ck_assert_int_eq(polls * VIP_FETCH_CYCLES - left, cpu.cycles);
+
+    cpu.keypad = 1 << 7;
+    ck_assert_int_gt(run_vip_frame(&cpu, 0), 1);
+    ck_assert_int_eq(7, cpu.v[5]);
+}
+END_TEST
+
+/* Timing models should be found by name. */
+START_TEST(test_timing_by_name)
+{
+    ck_assert_int_eq(TIMING_FIXED, timing_by_name("fixed"));
+    ck_assert_int_eq(TIMING_VIP, timing_by_name("vip"));
+    ck_assert_int_eq(TIMING_VIP_VBLANK, timing_by_name("vip-vblank"));
+    ck_assert_int_eq(-1, timing_by_name("fast"));
+}
+END_TEST
+
+static TCase*
+tcase_timing()
+{
+    TCase* tcase = tcase_create("VIP timing");
+    tcase_add_checked_fixture(tcase, setup_timing, NULL);
+    tcase_add_test(tcase, test_timing_costs);
+    tcase_add_test(tcase, test_timing_budget);
+    tcase_add_test(tcase, test_timing_vblank);
+    tcase_add_test(tcase, test_timing_wait_key);
+    tcase_add_test(tcase, test_timing_by_name);
+    return tcase;
+}
+
+Suite*
+create_timing_suite()
+{
+    Suite* suite = suite_create("Timing");
+    suite_add_tcase(suite, tcase_timing());
+    return suite;
+}
@@ -0,0 +1,118 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * File: tests/trace.c
+ * Description: Unit test related to the trace-event timelines.
+ */
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lib8/trace.h>
+
+#define TRACE_FILE "trace.tmp.json"
+
+/* Read the whole trace written, as a string. */
+static char*
+read_trace(void)
+{
+    FILE* in = fopen(TRACE_FILE, "rb");
+    ck_assert_ptr_ne(NULL, in);
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    rewind(in);
+    char* text = malloc(size + 1);
+    ck_assert_int_eq(size, fread(text, 1, size, in));
+    text[size] = 0;
+    fclose(in);
+    remove(TRACE_FILE);
+    return text;
+}
+
+static int
+count(const char* text, const char* needle)
+{
+    int n = 0;
+    for (const char* at = text; (at = strstr(at, needle)) != NULL; at++)
+        n++;
+    return n;
+}
+
+/* Events should be named, placed on their thread and made relative. */
+START_TEST(test_trace_events)
+{
+    struct trace_t* traces[2];
+    traces[0] = trace_create(1, "emulation", 16);
+    traces[1] = trace_create(2, "display", 16);
+    trace_event(traces[0], "run_machine", 1000, 1250);
+    trace_event(traces[1], "present", 1100, 1400);
+    ck_assert_int_eq(0, trace_save(TRACE_FILE, traces, 2));
+    trace_destroy(traces[0]);
+    trace_destroy(traces[1]);
+
+    char* text = read_trace();
+    ck_assert_ptr_ne(NULL, strstr(text, "{\"traceEvents\":["));
+    ck_assert_ptr_ne(NULL, strstr(text, "\"args\":{\"name\":\"emulation\"}"));
+    ck_assert_ptr_ne(NULL, strstr(text, "\"args\":{\"name\":\"display\"}"));
+    ck_assert_ptr_ne(NULL, strstr(text, "{\"name\":\"run_machine\",\"ph\":\"X\","
+                "\"pid\":1,\"tid\":1,\"ts\":0,\"dur\":250}"));
+    ck_assert_ptr_ne(NULL, strstr(text, "{\"name\":\"present\",\"ph\":\"X\","
+                "\"pid\":1,\"tid\":2,\"ts\":100,\"dur\":300}"));
+    ck_assert_ptr_ne(NULL, strstr(text, "\"dropped\":0"));
+    free(text);
+}
+END_TEST
+
+/* A full ring should keep the latest events and count the others. */
+START_TEST(test_trace_wrap)
+{
+    struct trace_t* trace = trace_create(1, "emulation", 1000);
+    for (int k = 0; k < 10000; k++)
+        trace_event(trace, "delay", 10 * k, 10 * k + 5);
+    ck_assert_int_eq(9000, trace_dropped(trace));
+    ck_assert_int_eq(0, trace_save(TRACE_FILE, &trace, 1));
+    trace_destroy(trace);
+
+    char* text = read_trace();
+    ck_assert_int_eq(1000, count(text, "\"ph\":\"X\""));
+    ck_assert_ptr_ne(NULL, strstr(text, "\"ts\":0,\"dur\":5}"));
+    ck_assert_ptr_ne(NULL, strstr(text, "\"ts\":9990,\"dur\":5}"));
+    ck_assert_ptr_ne(NULL, strstr(text, "\"dropped\":9000"));
+    free(text);
+
+    ck_assert_ptr_eq(NULL, trace_create(1, "emulation", 0));
+}
+END_TEST
+
+static TCase*
+tcase_trace()
+{
+    TCase* tcase = tcase_create("Timelines");
+    tcase_add_test(tcase, test_trace_events);
+    tcase_add_test(tcase, test_trace_wrap);
+    return tcase;
+}
+
+Suite*
+create_trace_suite()
+{
+    Suite* suite = suite_create("Trace");
+    suite_add_tcase(suite, tcase_trace());
+    return suite;
+}
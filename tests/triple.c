@@ -0,0 +1,113 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * File: tests/triple.c
+ * Description: Unit test related to the triple buffer of frames.
+ */
+
+#include <check.h>
+#include <pthread.h>
+#include <string.h>
+#include <lib8/triple.h>
+
+#define PUBLISHED 20000
+
+static struct machine_t writer;
+static struct triple_t* triple;
+
+static void
+setup_triple(void)
+{
+    init_machine(&writer);
+    triple = triple_create();
+    ck_assert_ptr_ne(NULL, triple);
+}
+
+static void
+teardown_triple(void)
+{
+    triple_destroy(triple);
+}
+
+/* Publish frames whose pixels are all the frame number. */
+static void*
+publish_frames(void* data)
+{
+    for (int n = 0; n < PUBLISHED; n++) {
+        memset(writer.screen, n & 0x7F, sizeof(writer.screen));
+        triple_publish(triple, &writer);
+    }
+    return NULL;
+}
+
+/* Only the latest frame should be taken, and only once. */
+START_TEST(test_triple_latest)
+{
+    ck_assert_ptr_eq(NULL, triple_latest(triple));
+    writer.screen[0] = 1;
+    triple_publish(triple, &writer);
+    writer.screen[0] = 2;
+    writer.esm = 1;
+    triple_publish(triple, &writer);
+
+    const struct frame_t* frame = triple_latest(triple);
+    ck_assert_ptr_ne(NULL, frame);
+    ck_assert_int_eq(2, frame->screen[0]);
+    ck_assert_int_eq(1, frame->esm);
+    ck_assert_int_eq(1, frame->number);
+    ck_assert_ptr_eq(NULL, triple_latest(triple));
+}
+END_TEST
+
+/* Frames taken while another thread publishes should never be torn. */
+START_TEST(test_triple_threads)
+{
+    pthread_t thread;
+    ck_assert_int_eq(0, pthread_create(&thread, NULL, publish_frames, NULL));
+    long last = -1;
+    while (last < PUBLISHED - 1) {
+        const struct frame_t* frame = triple_latest(triple);
+        if (frame == NULL)
+            continue;
+        ck_assert_int_gt(frame->number, last);
+        char pixel = frame->number & 0x7F;
+        for (int k = 0; k < (int) sizeof(frame->screen); k++)
+            ck_assert_int_eq(pixel, frame->screen[k]);
+        last = frame->number;
+    }
+    pthread_join(thread, NULL);
+}
+END_TEST
+
+static TCase*
+tcase_triple()
+{
+    TCase* tcase = tcase_create("Triple buffer");
+    tcase_add_checked_fixture(tcase, setup_triple, teardown_triple);
+    tcase_add_test(tcase, test_triple_latest);
+    tcase_add_test(tcase, test_triple_threads);
+    return tcase;
+}
+
+Suite*
+create_triple_suite()
+{
+    Suite* suite = suite_create("Triple");
+    suite_add_tcase(suite, tcase_triple());
+    return suite;
+}
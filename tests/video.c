@@ -0,0 +1,100 @@
+/*
+ * chip8 is a CHIP-8 emulator done in C
+ * Copyright (C) 2015-2016 Dani Rodríguez <danirod@outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File: tests/video.c
+ * Description: Unit test related to the video dump.
+ */
+
+#include <check.h>
+#include <stdio.h>
+#include <string.h>
+#include <lib8/video.h>
+
+static struct machine_t cpu;
+
+static const char y4m_header[] = "YUV4MPEG2 W128 H64 F60:1 Ip A1:1 Cmono\n";
+
+/* Dump more frames than the pool holds and read the file back. */
+static long
+dump_frames(const char* file, int frames)
+{
+    init_machine(&cpu);
+    struct video_t* video = video_open(file, -1);
+    ck_assert_ptr_ne(NULL, video);
+    for (int k = 0; k < frames; k++) {
+        cpu.screen[k] = 1;
+        ck_assert_int_eq(0, video_frame(video, &cpu));
+    }
+    ck_assert_int_eq(0, video_close(video));
+
+    FILE* in = fopen(file, "rb");
+    ck_assert_ptr_ne(NULL, in);
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fclose(in);
+    return size;
+}
+
+START_TEST(test_video_y4m)
+{
+    int frames = 3 * VIDEO_POOL;
+    long size = dump_frames("video.tmp.y4m", frames);
+    ck_assert_int_eq(strlen(y4m_header) + frames * (6 + 128 * 64), size);
+
+    /* Low resolution pixels are scaled up 2x. */
+    char header[64];
+    byte frame[128 * 64];
+    FILE* in = fopen("video.tmp.y4m", "rb");
+    ck_assert_int_eq(1, fread(header, strlen(y4m_header), 1, in));
+    ck_assert_int_eq(0, memcmp(y4m_header, header, strlen(y4m_header)));
+    ck_assert_int_eq(1, fread(header, 6, 1, in));
+    ck_assert_int_eq(1, fread(frame, sizeof(frame), 1, in));
+    fclose(in);
+    remove("video.tmp.y4m");
+    ck_assert_int_eq(255, frame[0]);
+    ck_assert_int_eq(255, frame[1]);
+    ck_assert_int_eq(255, frame[128]);
+    ck_assert_int_eq(0, frame[2]);
+}
+END_TEST
+
+START_TEST(test_video_rgba)
+{
+    long size = dump_frames("video.tmp.rgba", 10);
+    remove("video.tmp.rgba");
+    ck_assert_int_eq(10 * 128 * 64 * 4, size);
+}
+END_TEST
+
+static TCase*
+tcase_video()
+{
+    TCase* tcase = tcase_create("Dump");
+    tcase_add_test(tcase, test_video_y4m);
+    tcase_add_test(tcase, test_video_rgba);
+    return tcase;
+}
+
+Suite*
+create_video_suite()
+{
+    Suite* suite = suite_create("Video");
+    suite_add_tcase(suite, tcase_video());
+    return suite;
+}